@@ -7,6 +7,8 @@ LIBS = $(shell pkg-config --libs opencv4)
 LIBS += $(shell pkg-config --libs libjpeg)
 LIBS += $(shell pkg-config --libs libpng)
 LIBS += $(shell pkg-config --libs libtiff-4)
+# std::thread (utility/Parallel.h)
+LIBS += -lpthread
 
 # compiler
 CC = g++
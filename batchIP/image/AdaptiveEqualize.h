@@ -0,0 +1,198 @@
+#pragma once
+
+#include "ColorConversion.h"
+#include "Image.h"
+#include "ImageAlgorithmSIMD.h"
+#include "LookupTable.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+namespace detail {
+
+   // Splits size pixels into tiles (near) equal spans, and for each pixel
+   // finds the first of the two tiles whose centers surround it and the
+   // weight of the second (pixels beyond the outer centers take the outer
+   // tile's with no weight on the other).
+   inline void tileInterpolation(unsigned size,unsigned tiles,std::vector<unsigned>& begins,
+                                 std::vector<unsigned>& first,std::vector<float>& weight) {
+      begins.resize(tiles + 1u);
+      for(unsigned t = 0;t <= tiles;++t) begins[t] = static_cast<unsigned>(static_cast<uint64_t>(t)*size/tiles);
+      std::vector<double> centers(tiles);
+      for(unsigned t = 0;t < tiles;++t) centers[t] = (begins[t] + begins[t+1])/2.0;
+
+      first.resize(size);
+      weight.resize(size);
+      unsigned t = 0;
+      for(unsigned p = 0;p < size;++p) {
+         const double x = p + 0.5;
+         while(t + 1u < tiles && centers[t+1] <= x) ++t;
+         first[p] = t;
+         weight[p] = t + 1u < tiles && x > centers[t] ? static_cast<float>((x - centers[t])/(centers[t+1] - centers[t])) : 0.0f;
+      }
+   }
+
+   // Clips the bins counts of histogram (of total pixels) at limit, spreading
+   // the excess uniformly over all bins, and writes the histogram's cumulative
+   // distribution scaled to [0,maxValue] to lut.
+   inline void clippedEqualization(uint32_t* histogram,unsigned bins,uint32_t total,uint32_t limit,float maxValue,float* lut) {
+      uint64_t excess = 0;
+      for(unsigned b = 0;b < bins;++b) {
+         if(histogram[b] > limit) {
+            excess += histogram[b] - limit;
+            histogram[b] = limit;
+         }
+      }
+      const uint32_t batch = static_cast<uint32_t>(excess/bins);
+      const uint32_t residual = static_cast<uint32_t>(excess % bins);
+      for(unsigned b = 0;b < bins;++b) histogram[b] += batch;
+      if(residual > 0) {
+         const unsigned step = std::max(1u,bins/residual);
+         for(unsigned b = 0,left = residual;b < bins && left > 0;b += step,--left) ++histogram[b];
+      }
+
+      const float scale = total > 0 ? maxValue/total : 0.0f;
+      uint64_t cumulative = 0;
+      for(unsigned b = 0;b < bins;++b) {
+         cumulative += histogram[b];
+         lut[b] = static_cast<float>(cumulative)*scale;
+      }
+   }
+
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Contrast limited adaptive histogram equalization (CLAHE): src is split into
+// a tiles x tiles grid, each tile's histogram is clipped at clipLimit times
+// its mean bin count (the excess being spread over all bins, and 0 for no
+// clipping, i.e. plain adaptive equalization) and equalized to a table, and
+// each pixel is mapped through the tables of the 4 surrounding tile centers,
+// bilinearly interpolated. The same as OpenCV's CLAHE but for the borders,
+// where tiles are not padded (the grid is split as evenly as possible).
+//
+// Tiles are counted and equalized concurrently, then bands of rows are
+// mapped concurrently, interpolating each row with 4 gathers from the tables
+// (see simd::multiplyAccumulateGather).
+template<typename SrcImageT,typename TgtImageT>
+void adaptiveEqualize(const SrcImageT& src, TgtImageT& tgt,unsigned tiles,double clipLimit,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<(types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                  types::is_monochrome<typename SrcImageT::pixel_type>::value) &&
+                                 is_lookup_channel<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+   typedef typename std::remove_const<TgtPixelT>::type::value_type          TgtValueT;
+
+   utility::reportIfEqual("tiles",tiles,0u);
+   utility::reportIfNotLessThan("clipLimit",-1e-9,clipLimit);
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   if(0 == rows || 0 == cols) return;
+   const unsigned bins = static_cast<unsigned>(PixelT::traits::max()) + 1u;
+   const unsigned tileRows = std::min(tiles,rows);
+   const unsigned tileCols = std::min(tiles,cols);
+   utility::reportIfNotLessThan("tiles*tiles*bins",static_cast<uint64_t>(tileRows)*tileCols*bins,(uint64_t)INT_MAX);
+   const float maxValue = static_cast<float>(TgtPixelT::traits::max());
+
+   std::vector<unsigned> rowBegins,colBegins,firstRows,firstCols;
+   std::vector<float>    rowWeights,colWeights;
+   detail::tileInterpolation(rows,tileRows,rowBegins,firstRows,rowWeights);
+   detail::tileInterpolation(cols,tileCols,colBegins,firstCols,colWeights);
+
+   // Each tile's clipped equalization (the tables are consecutive)
+   std::vector<float> luts(static_cast<std::size_t>(tileRows)*tileCols*bins);
+   utility::parallelFor(0,tileRows*tileCols,[&](unsigned tileBegin,unsigned tileEnd,unsigned) {
+      std::vector<uint32_t> histogram(bins);
+      for(unsigned t = tileBegin;t < tileEnd;++t) {
+         const unsigned ty = t/tileCols;
+         const unsigned tx = t%tileCols;
+         std::fill(histogram.begin(),histogram.end(),0u);
+         for(unsigned r = rowBegins[ty];r < rowBegins[ty+1];++r) {
+            const auto row = types::rowPixels(src,r);
+            for(unsigned c = colBegins[tx];c < colBegins[tx+1];++c) ++histogram[row[c].tuple.value0];
+         }
+         const uint32_t total = (rowBegins[ty+1] - rowBegins[ty])*(colBegins[tx+1] - colBegins[tx]);
+         const uint32_t limit = clipLimit > 0.0 ? std::max(1u,static_cast<uint32_t>(clipLimit*total/bins)) : total;
+         detail::clippedEqualization(&histogram[0],bins,total,limit,maxValue,&luts[static_cast<std::size_t>(t)*bins]);
+      }
+   },1u);
+
+   // Interpolate the 4 surrounding tables for each pixel
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      std::vector<int>   values(cols),indices(cols);
+      std::vector<float> weights(cols),mapped(cols);
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto srow = types::rowPixels(src,r);
+         const auto trow = types::rowPixels(tgt,r);
+         for(unsigned c = 0;c < cols;++c) values[c] = static_cast<int>(srow[c].tuple.value0);
+         std::fill(mapped.begin(),mapped.end(),0.0f);
+         for(unsigned dy = 0;dy < 2u;++dy) {
+            const unsigned ty = std::min(firstRows[r] + dy,tileRows - 1u);
+            const float wy = dy ? rowWeights[r] : 1.0f - rowWeights[r];
+            for(unsigned dx = 0;dx < 2u;++dx) {
+               for(unsigned c = 0;c < cols;++c) {
+                  const unsigned tx = std::min(firstCols[c] + dx,tileCols - 1u);
+                  indices[c] = static_cast<int>((ty*tileCols + tx)*bins) + values[c];
+                  weights[c] = wy*(dx ? colWeights[c] : 1.0f - colWeights[c]);
+               }
+               simd::multiplyAccumulateGather(&mapped[0],&luts[0],&indices[0],&weights[0],cols);
+            }
+         }
+         for(unsigned c = 0;c < cols;++c) {
+            trow[c].tuple.value0 = static_cast<TgtValueT>(std::min(maxValue,std::floor(mapped[c] + 0.5f)));
+         }
+      }
+   },std::max(1u,(1u << 14)/cols));
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Contrast limited adaptive histogram equalization of the intensity of a
+// color image (hue and saturation are preserved): intensity is streamed into
+// a single channel (quantized to the source channel's levels), equalized as
+// gray is, and streamed back through HSI.
+template<typename SrcImageT,typename TgtImageT>
+void adaptiveEqualize(const SrcImageT& src, TgtImageT& tgt,unsigned tiles,double clipLimit,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value &&
+                                 is_lookup_channel<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef types::MonochromePixel<typename SrcPixelT::value_type>           MonoPixelT;
+
+   types::Image<MonoPixelT> intensities(src.rows(),src.cols());
+   selectHSIChannel(src,intensities,(unsigned)types::HSIPixel<float>::INTENSITY_CHANNEL);
+   types::Image<MonoPixelT> equalized(src.rows(),src.cols());
+   adaptiveEqualize(intensities,equalized,tiles,clipLimit);
+
+   const float max = static_cast<float>(SrcPixelT::traits::max());
+   transformHSI(src,tgt,[&](unsigned row,unsigned begin,float*,float*,float* intensity,unsigned count) {
+      const MonoPixelT* levels = &equalized.pixel(row,begin);
+      for(unsigned k = 0;k < count;++k) intensity[k] = levels[k].tuple.value0/max;
+   });
+}
+
+} // namespace algorithm
+} // namespace batchIP
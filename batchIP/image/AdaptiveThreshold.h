@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Image.h"
+#include "IntegralImage.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace batchIP {
+namespace algorithm {
+
+enum AdaptiveThreshold {
+   ADAPTIVE_NIBLACK = 0, // mean + k*deviation
+   ADAPTIVE_SAUVOLA,     // mean*(1 + k*(deviation/R - 1)), R half the dynamic range
+   ADAPTIVE_BRADLEY,     // mean*(1 - k)
+   NUM_ADAPTIVE_THRESHOLDS
+};
+
+
+/*-----------------------------------------------------------------------**/
+// Binarizes each pixel of src against a threshold computed from the mean (and
+// standard deviation) of its windowSize x windowSize window (clipped at the
+// borders), as with binarize: values below the threshold become the minimum
+// and all others the maximum.
+//
+// Window sums (and sums of squares) come from a 64-bit IntegralImage, so the
+// cost per pixel is the same for any windowSize, and bands of rows are
+// thresholded concurrently.
+template<typename SrcImageT,typename TgtImageT>
+void adaptiveBinarize(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double k,AdaptiveThreshold method,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                 types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+   typedef types::IntegralImage<PixelT>                                     IntegralT;
+
+   utility::reportIfNotLessThan("windowSize",0u,windowSize);
+   utility::reportIfNotEqual("windowSize (which should be odd)",windowSize-1,((windowSize >> 1u) << 1u));
+   utility::reportIfNotLessThan("method",(unsigned)method,(unsigned)NUM_ADAPTIVE_THRESHOLDS);
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   if(0 == rows || 0 == cols) return;
+   const unsigned half = windowSize >> 1u;
+   const bool needsDeviation = ADAPTIVE_BRADLEY != method;
+   const IntegralT integral(src,PixelT::GRAY_CHANNEL,needsDeviation);
+   const double halfRange = (static_cast<double>(PixelT::traits::max()) - PixelT::traits::min())/2.0;
+
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const unsigned r0 = r > half ? r - half : 0u;
+         const unsigned windowRows = std::min(rows,r + half + 1u) - r0;
+         const auto srow = types::rowPixels(src,r);
+         const auto trow = types::rowPixels(tgt,r);
+         for(unsigned c = 0;c < cols;++c) {
+            const unsigned c0 = c > half ? c - half : 0u;
+            const unsigned windowCols = std::min(cols,c + half + 1u) - c0;
+            const double n = static_cast<double>(windowRows)*windowCols;
+            const double mean = static_cast<double>(integral.sum(r0,c0,windowRows,windowCols))/n;
+            double deviation = 0.0;
+            if(needsDeviation) {
+               const double variance = static_cast<double>(integral.sumOfSquares(r0,c0,windowRows,windowCols))/n - mean*mean;
+               deviation = variance > 0.0 ? std::sqrt(variance) : 0.0;
+            }
+            double threshold;
+            switch(method) {
+               case ADAPTIVE_NIBLACK: threshold = mean + k*deviation; break;
+               case ADAPTIVE_SAUVOLA: threshold = mean*(1.0 + k*(deviation/halfRange - 1.0)); break;
+               default:               threshold = mean*(1.0 - k); break;
+            }
+            trow[c].tuple.value0 = srow[c].tuple.value0 < threshold ? TgtPixelT::traits::min() : TgtPixelT::traits::max();
+         }
+      }
+   },std::max(1u,(1u << 14)/cols));
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void niblackBinarize(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double k) {
+   adaptiveBinarize(src,tgt,windowSize,k,ADAPTIVE_NIBLACK);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void sauvolaBinarize(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double k) {
+   adaptiveBinarize(src,tgt,windowSize,k,ADAPTIVE_SAUVOLA);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void bradleyBinarize(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double k) {
+   adaptiveBinarize(src,tgt,windowSize,k,ADAPTIVE_BRADLEY);
+}
+
+} // namespace algorithm
+} // namespace batchIP
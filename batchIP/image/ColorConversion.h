@@ -0,0 +1,248 @@
+#pragma once
+
+#include "Image.h"
+#include "ImageAlgorithmSIMD.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace batchIP {
+namespace algorithm {
+
+///////////////////////////////////////////////////////////////////////////////
+// Batch conversions of whole Images (or views) between RGBA and HSI.
+//
+// Notes:
+// 1) These compute the same conversion as the per pixel rgba2hsi and
+//    hsi2rgba (see PixelConversion.h), but in float, a block of pixels at a
+//    time with simd::rgb2hsi and simd::hsi2rgb, which use polynomial
+//    approximations of acos and cos. Compared to the exact (double) pixel
+//    conversions, hue, saturation and intensity are within 2e-6, and
+//    channels converted back to RGBA are within one level.
+// 2) Defining BATCHIP_EXACT_HSI switches back to the exact pixel conversions.
+// 3) Bands of rows are converted concurrently (see utility::parallelFor).
+// 4) Algorithms that only modify HSI channels should stream with transformHSI
+//    rather than convert whole images, which holds just a block of HSI planes
+//    (rather than 16 or 32 bytes per pixel) and reads and writes each pixel
+//    once.
+//
+
+namespace detail {
+   // Pixels converted per call into the simd primitives (planes stay in L1)
+   enum { HSI_BLOCK = 256 };
+   // Fewest pixels worth handing to a thread
+   enum { MIN_HSI_PIXELS_PER_BAND = 1u << 14 };
+
+   // Calls convertRow(row,srcRow,srcStep,tgtRow,tgtStep,cols) for each row
+   template<typename SrcImageT,typename TgtImageT,typename ConvertRowT>
+   void convertRows(const SrcImageT& src,TgtImageT& tgt,ConvertRowT convertRow) {
+      utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+      utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+      const unsigned rows = src.rows();
+      const unsigned cols = src.cols();
+      if(0 == rows || 0 == cols) return;
+      const unsigned minRows = std::max(1u,static_cast<unsigned>(MIN_HSI_PIXELS_PER_BAND)/cols);
+      utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+         for(unsigned r = rowBegin;r < rowEnd;++r) {
+            const auto srow = types::rowPixels(src,r);
+            const auto trow = types::rowPixels(tgt,r);
+            convertRow(r,srow.first,srow.step,trow.first,trow.step,cols);
+         }
+      },minRows);
+   }
+
+   // count RGBA pixels (step apart) into hue, saturation and intensity planes
+   template<typename SrcPixelT>
+   void rgbaToHSIPlanes(const SrcPixelT* spos,std::ptrdiff_t sstep,unsigned count,
+                        float* hue,float* saturation,float* intensity) {
+#ifdef BATCHIP_EXACT_HSI
+      for(unsigned k = 0;k < count;++k) {
+         types::HSIPixel<double> hsi;
+         types::rgba2hsi(spos[k*sstep],hsi);
+         hue[k]        = static_cast<float>(hsi.namedColor.hue);
+         saturation[k] = static_cast<float>(hsi.namedColor.saturation);
+         intensity[k]  = static_cast<float>(hsi.namedColor.intensity);
+      }
+#else
+      const float invMax3 = static_cast<float>(1.0/(3.0*SrcPixelT::traits::max()));
+      float red[HSI_BLOCK],green[HSI_BLOCK],blue[HSI_BLOCK];
+      for(unsigned k = 0;k < count;++k) {
+         const SrcPixelT& pixel = spos[k*sstep];
+         red[k]   = static_cast<float>(pixel.namedColor.red);
+         green[k] = static_cast<float>(pixel.namedColor.green);
+         blue[k]  = static_cast<float>(pixel.namedColor.blue);
+      }
+      simd::rgb2hsi(red,green,blue,hue,saturation,intensity,count,invMax3);
+#endif
+   }
+
+   // count hue, saturation and intensity values into RGBA pixels (step apart),
+   // leaving alpha unchanged
+   template<typename TgtPixelT>
+   void hsiPlanesToRGBA(const float* hue,const float* saturation,const float* intensity,unsigned count,
+                        TgtPixelT* tpos,std::ptrdiff_t tstep) {
+#ifdef BATCHIP_EXACT_HSI
+      for(unsigned k = 0;k < count;++k) {
+         types::HSIPixel<double> hsi;
+         hsi.namedColor.hue        = hue[k];
+         hsi.namedColor.saturation = saturation[k];
+         hsi.namedColor.intensity  = intensity[k];
+         types::hsi2rgba(hsi,tpos[k*tstep]);
+      }
+#else
+      typedef typename TgtPixelT::value_type TgtValueT;
+      // Same (slightly under) rescale as types::assignRGB
+      const float scale = static_cast<float>(TgtPixelT::traits::max() + 0.999);
+      float red[HSI_BLOCK],green[HSI_BLOCK],blue[HSI_BLOCK];
+      simd::hsi2rgb(hue,saturation,intensity,red,green,blue,count);
+      for(unsigned k = 0;k < count;++k) {
+         TgtPixelT& pixel = tpos[k*tstep];
+         pixel.namedColor.red   = static_cast<TgtValueT>(red[k]*scale);
+         pixel.namedColor.green = static_cast<TgtValueT>(green[k]*scale);
+         pixel.namedColor.blue  = static_cast<TgtValueT>(blue[k]*scale);
+      }
+#endif
+   }
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Converts an RGBA image of integral channels into an HSI image of floating
+// point channels (alpha is dropped).
+template<typename SrcImageT,typename TgtImageT>
+void convertRGBAToHSI(const SrcImageT& src,TgtImageT& tgt,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value &&
+                                 types::is_hsi<typename TgtImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+
+   detail::convertRows(src,tgt,[](unsigned,const SrcPixelT* spos,std::ptrdiff_t sstep,TgtPixelT* tpos,std::ptrdiff_t tstep,unsigned count) {
+#ifdef BATCHIP_EXACT_HSI
+      for(unsigned c = 0;c < count;++c) types::rgba2hsi(spos[c*sstep],tpos[c*tstep]);
+#else
+      typedef typename TgtPixelT::value_type TgtValueT;
+      float hue[detail::HSI_BLOCK],saturation[detail::HSI_BLOCK],intensity[detail::HSI_BLOCK];
+      for(unsigned begin = 0;begin < count;begin += detail::HSI_BLOCK) {
+         const unsigned block = std::min(static_cast<unsigned>(detail::HSI_BLOCK),count - begin);
+         detail::rgbaToHSIPlanes(spos + begin*sstep,sstep,block,hue,saturation,intensity);
+         for(unsigned k = 0;k < block;++k) {
+            TgtPixelT& pixel = tpos[(begin+k)*tstep];
+            pixel.namedColor.hue        = static_cast<TgtValueT>(hue[k]);
+            pixel.namedColor.saturation = static_cast<TgtValueT>(saturation[k]);
+            pixel.namedColor.intensity  = static_cast<TgtValueT>(intensity[k]);
+         }
+      }
+#endif
+   });
+}
+
+/*-----------------------------------------------------------------------**/
+// Converts an HSI image of floating point channels into an RGBA image of
+// integral channels (alpha is left unchanged).
+template<typename SrcImageT,typename TgtImageT>
+void convertHSIToRGBA(const SrcImageT& src,TgtImageT& tgt,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_hsi<typename SrcImageT::pixel_type>::value &&
+                                 types::is_rgba<typename TgtImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+
+   detail::convertRows(src,tgt,[](unsigned,const SrcPixelT* spos,std::ptrdiff_t sstep,TgtPixelT* tpos,std::ptrdiff_t tstep,unsigned count) {
+#ifdef BATCHIP_EXACT_HSI
+      for(unsigned c = 0;c < count;++c) types::hsi2rgba(spos[c*sstep],tpos[c*tstep]);
+#else
+      float hue[detail::HSI_BLOCK],saturation[detail::HSI_BLOCK],intensity[detail::HSI_BLOCK];
+      for(unsigned begin = 0;begin < count;begin += detail::HSI_BLOCK) {
+         const unsigned block = std::min(static_cast<unsigned>(detail::HSI_BLOCK),count - begin);
+         for(unsigned k = 0;k < block;++k) {
+            const SrcPixelT& pixel = spos[(begin+k)*sstep];
+            hue[k]        = static_cast<float>(pixel.namedColor.hue);
+            saturation[k] = static_cast<float>(pixel.namedColor.saturation);
+            intensity[k]  = static_cast<float>(pixel.namedColor.intensity);
+         }
+         detail::hsiPlanesToRGBA(hue,saturation,intensity,block,tpos + begin*tstep,tstep);
+      }
+#endif
+   });
+}
+
+/*-----------------------------------------------------------------------**/
+// Streams an RGBA image through HSI a block of pixels at a time, so that no
+// HSI image is ever built: each block of a row is converted into float hue,
+// saturation and intensity planes, which
+//    transform(row,col,hue,saturation,intensity,count)
+// modifies in place (col being the block's first column), and which are then
+// converted back into tgt. Note, transform is called concurrently for
+// different rows.
+template<typename SrcImageT,typename TgtImageT,typename TransformT>
+void transformHSI(const SrcImageT& src,TgtImageT& tgt,TransformT transform,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value &&
+                                 types::is_rgba<typename TgtImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+
+   detail::convertRows(src,tgt,[&](unsigned row,const SrcPixelT* spos,std::ptrdiff_t sstep,TgtPixelT* tpos,std::ptrdiff_t tstep,unsigned count) {
+      float hue[detail::HSI_BLOCK],saturation[detail::HSI_BLOCK],intensity[detail::HSI_BLOCK];
+      for(unsigned begin = 0;begin < count;begin += detail::HSI_BLOCK) {
+         const unsigned block = std::min(static_cast<unsigned>(detail::HSI_BLOCK),count - begin);
+         detail::rgbaToHSIPlanes(spos + begin*sstep,sstep,block,hue,saturation,intensity);
+         transform(row,begin,hue,saturation,intensity,block);
+         detail::hsiPlanesToRGBA(hue,saturation,intensity,block,tpos + begin*tstep,tstep);
+      }
+   });
+}
+
+/*-----------------------------------------------------------------------**/
+// Streams one HSI channel of an RGBA image into a single channel image (e.g.
+// the first pass of an algorithm that needs global statistics, whose second
+// pass is transformHSI).
+template<typename SrcImageT,typename TgtImageT>
+void selectHSIChannel(const SrcImageT& src,TgtImageT& tgt,unsigned channel,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+
+   utility::reportIfNotLessThan("channel",channel,(unsigned)types::HSIPixel<float>::MAX_CHANNELS);
+
+   detail::convertRows(src,tgt,[&](unsigned,const SrcPixelT* spos,std::ptrdiff_t sstep,TgtPixelT* tpos,std::ptrdiff_t tstep,unsigned count) {
+      float planes[3][detail::HSI_BLOCK];
+      for(unsigned begin = 0;begin < count;begin += detail::HSI_BLOCK) {
+         const unsigned block = std::min(static_cast<unsigned>(detail::HSI_BLOCK),count - begin);
+         detail::rgbaToHSIPlanes(spos + begin*sstep,sstep,block,planes[0],planes[1],planes[2]);
+         for(unsigned k = 0;k < block;++k) {
+            // Note: rescaled into the target channel as with the pixel conversions
+            types::HSIPixel<float> hsi;
+            hsi.indexedColor[channel] = planes[channel][k];
+            types::channel2mono(hsi,tpos[(begin+k)*tstep],channel);
+         }
+      }
+   });
+}
+
+} // namespace algorithm
+} // namespace batchIP
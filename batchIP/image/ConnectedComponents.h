@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+struct ComponentStats {
+   uint64_t area;        // pixels
+   unsigned rowBegin;    // bounding box (rows [rowBegin,rowEnd) and cols [colBegin,colEnd))
+   unsigned colBegin;
+   unsigned rowEnd;
+   unsigned colEnd;
+   double   rowCentroid;
+   double   colCentroid;
+};
+
+namespace detail {
+
+   // Union-find over pixel indices, where each root is the smallest index of
+   // its set (so that it is the first pixel of its component in raster order).
+   inline uint32_t findRoot(std::vector<uint32_t>& parent,uint32_t i) {
+      while(parent[i] != i) {
+         parent[i] = parent[parent[i]]; // path halving
+         i = parent[i];
+      }
+      return i;
+   }
+
+   inline void unite(std::vector<uint32_t>& parent,uint32_t a,uint32_t b) {
+      a = findRoot(parent,a);
+      b = findRoot(parent,b);
+      if(a < b) parent[b] = a;
+      else if(b < a) parent[a] = b;
+   }
+
+   // Unites the foreground pixel (r,c) of a rows x cols plane with its
+   // foreground neighbours to its left (if left) and in the row above (if up).
+   inline void uniteNeighbours(std::vector<uint32_t>& parent,const std::vector<uint8_t>& foreground,
+                               unsigned r,unsigned c,unsigned cols,bool eightConnected,bool left,bool up) {
+      const uint32_t i = r*cols + c;
+      if(left && c > 0 && foreground[i-1]) unite(parent,i,i-1);
+      if(up && r > 0) {
+         const uint32_t above = i - cols;
+         if(foreground[above]) unite(parent,i,above);
+         if(eightConnected && c > 0 && foreground[above-1]) unite(parent,i,above-1);
+         if(eightConnected && c + 1 < cols && foreground[above+1]) unite(parent,i,above+1);
+      }
+   }
+
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Labels the 4 or 8 connected components of the foreground (i.e. non-zero)
+// pixels of src, and returns their statistics: labels are resized to src,
+// where background pixels are 0 and components are labelled 1,2,...  in the
+// raster order of their first pixels (stats[label-1] are those of label).
+//
+// Bands of rows are labelled concurrently (with a union-find of pixel
+// indices), then the bands are merged along their boundary rows, and lastly
+// the final labels and statistics are gathered concurrently by band.
+template<typename SrcImageT,typename LabelImageT>
+std::vector<ComponentStats> connectedComponents(const SrcImageT& src,LabelImageT& labels,unsigned connectivity) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename PixelT::value_type                                      ValueT;
+   typedef typename LabelImageT::pixel_type::value_type                     LabelT;
+
+   static_assert(std::is_integral<LabelT>::value && sizeof(LabelT) >= sizeof(uint32_t),"labels must be (at least) 32-bit integers");
+
+   utility::reportIfNotEqual("connectivity (which should be 4 or 8)",connectivity == 4u || connectivity == 8u,true);
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   utility::reportIfNotLessThan("src.rows()*src.cols()",static_cast<uint64_t>(rows)*cols,(uint64_t)UINT32_MAX);
+   labels.resize(rows,cols);
+   if(0 == rows || 0 == cols) return std::vector<ComponentStats>();
+   const bool eightConnected = 8u == connectivity;
+   const unsigned minRows = std::max(1u,(1u << 14)/cols);
+
+   std::vector<uint8_t>  foreground(static_cast<std::size_t>(rows)*cols);
+   std::vector<uint32_t> parent(static_cast<std::size_t>(rows)*cols);
+   std::vector<unsigned> bandBegins(utility::parallelBlocks(0,rows,minRows));
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned block) {
+      bandBegins[block] = rowBegin;
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto row = types::rowPixels(src,r);
+         for(unsigned c = 0;c < cols;++c) {
+            const uint32_t i = r*cols + c;
+            parent[i] = i;
+            foreground[i] = static_cast<ValueT>(0) != row[c].tuple.value0;
+            // Note: the band's first row is united with the band above when merging
+            if(foreground[i]) detail::uniteNeighbours(parent,foreground,r,c,cols,eightConnected,true,r > rowBegin);
+         }
+      }
+   },minRows);
+
+   // Merge the bands along their first rows
+   for(unsigned b = 1;b < bandBegins.size();++b) {
+      const unsigned r = bandBegins[b];
+      for(unsigned c = 0;c < cols;++c) {
+         if(foreground[r*cols + c]) detail::uniteNeighbours(parent,foreground,r,c,cols,eightConnected,false,true);
+      }
+   }
+
+   // The root of each pixel (written to labels, as parent is read concurrently)
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         typename LabelImageT::pixel_type* row = &labels.pixel(r,0);
+         for(unsigned c = 0;c < cols;++c) {
+            uint32_t i = r*cols + c;
+            while(parent[i] != i) i = parent[i];
+            row[c].tuple.value0 = static_cast<LabelT>(i);
+         }
+      }
+   },minRows);
+
+   // Number the roots (i.e. components) in raster order, a band at a time
+   std::vector<uint32_t> bandCounts(bandBegins.size() + 1u,0u);
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned block) {
+      uint32_t count = 0;
+      for(uint32_t i = rowBegin*cols;i < rowEnd*cols;++i) count += foreground[i] && parent[i] == i;
+      bandCounts[block + 1u] = count;
+   },minRows);
+   for(unsigned b = 1;b < bandCounts.size();++b) bandCounts[b] += bandCounts[b-1];
+   const uint32_t components = bandCounts.back();
+   utility::reportIfNotLessThan("components",(uint64_t)components,(uint64_t)std::numeric_limits<LabelT>::max() + 1u);
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned block) {
+      uint32_t label = bandCounts[block];
+      for(uint32_t i = rowBegin*cols;i < rowEnd*cols;++i) {
+         if(foreground[i] && parent[i] == i) parent[i] = ++label; // Note: roots are no longer needed
+      }
+   },minRows);
+
+   // Final labels and per-band statistics: a band numbers the components
+   // that start in it, whose statistics it keeps by label, while components
+   // continued from the bands above (which cross its first row, so are at
+   // most cols) are kept by label in a map, so that statistics take
+   // O(components + bands*cols) memory.
+   struct Accumulator {
+      uint64_t area, rowSum, colSum;
+      unsigned rowBegin, colBegin, rowEnd, colEnd;
+      void add(unsigned r,unsigned c) {
+         ++area;
+         rowSum += r;
+         colSum += c;
+         rowBegin = std::min(rowBegin,r);
+         colBegin = std::min(colBegin,c);
+         rowEnd = std::max(rowEnd,r + 1u);
+         colEnd = std::max(colEnd,c + 1u);
+      }
+      void merge(const Accumulator& that) {
+         area += that.area;
+         rowSum += that.rowSum;
+         colSum += that.colSum;
+         rowBegin = std::min(rowBegin,that.rowBegin);
+         colBegin = std::min(colBegin,that.colBegin);
+         rowEnd = std::max(rowEnd,that.rowEnd);
+         colEnd = std::max(colEnd,that.colEnd);
+      }
+   };
+   const Accumulator empty = { 0u, 0u, 0u, rows, cols, 0u, 0u };
+   std::vector<Accumulator> totals(components,empty);
+   std::vector<std::unordered_map<uint32_t,Accumulator> > continued(bandBegins.size());
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned block) {
+      // Note: each band writes only the totals of the labels it numbered
+      const uint32_t firstLabel = bandCounts[block] + 1u;
+      const uint32_t numbered = bandCounts[block + 1u] - bandCounts[block];
+      Accumulator* own = &totals[bandCounts[block]];
+      std::unordered_map<uint32_t,Accumulator>& carried = continued[block];
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         typename LabelImageT::pixel_type* row = &labels.pixel(r,0);
+         for(unsigned c = 0;c < cols;++c) {
+            if(!foreground[r*cols + c]) {
+               row[c].tuple.value0 = static_cast<LabelT>(0);
+               continue;
+            }
+            const uint32_t label = parent[static_cast<uint32_t>(row[c].tuple.value0)];
+            row[c].tuple.value0 = static_cast<LabelT>(label);
+            if(label - firstLabel < numbered) own[label - firstLabel].add(r,c);
+            else carried.insert(std::make_pair(label,empty)).first->second.add(r,c);
+         }
+      }
+   },minRows);
+   for(const std::unordered_map<uint32_t,Accumulator>& carried : continued) {
+      for(const std::pair<const uint32_t,Accumulator>& entry : carried) totals[entry.first - 1u].merge(entry.second);
+   }
+
+   std::vector<ComponentStats> stats(components);
+   for(uint32_t l = 0;l < components;++l) {
+      const Accumulator& total = totals[l];
+      stats[l].area = total.area;
+      stats[l].rowBegin = total.rowBegin;
+      stats[l].colBegin = total.colBegin;
+      stats[l].rowEnd = total.rowEnd;
+      stats[l].colEnd = total.colEnd;
+      stats[l].rowCentroid = static_cast<double>(total.rowSum)/total.area;
+      stats[l].colCentroid = static_cast<double>(total.colSum)/total.area;
+   }
+   return stats;
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Labels the connected components of src (e.g. the output of binarize) into
+// tgt, whose values cycle through 1..max (0 is background), and prints the
+// statistics of each component.
+template<typename SrcImageT,typename TgtImageT>
+void labelComponents(const SrcImageT& src,TgtImageT& tgt,unsigned connectivity) {
+   typedef typename TgtImageT::pixel_type::value_type ValueT;
+   typedef types::Image<types::MonochromePixel<uint32_t> > LabelImageT;
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   LabelImageT labels;
+   const std::vector<ComponentStats> stats = connectedComponents(src,labels,connectivity);
+   for(unsigned l = 0;l < stats.size();++l) {
+      const ComponentStats& stat = stats[l];
+      std::cout << "COMPONENT: " << (l + 1u) << " area " << stat.area
+                << " rows " << stat.rowBegin << " " << stat.rowEnd << " cols " << stat.colBegin << " " << stat.colEnd
+                << " centroid " << stat.rowCentroid << " " << stat.colCentroid << std::endl;
+   }
+
+   const uint64_t cycle = static_cast<uint64_t>(TgtImageT::pixel_type::traits::max());
+   for(unsigned r = 0;r < labels.rows();++r) {
+      const auto trow = types::rowPixels(tgt,r);
+      for(unsigned c = 0;c < labels.cols();++c) {
+         const uint32_t label = labels.pixel(r,c).tuple.value0;
+         trow[c].tuple.value0 = static_cast<ValueT>(0u == label ? 0u : (label - 1u) % cycle + 1u);
+      }
+   }
+}
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include "utility/Transpose.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+namespace detail {
+
+   // Felzenszwalb and Huttenlocher's 1D squared distance transform: replaces
+   // each of the count values of f by min over q of (p - q)^2 + f[q], from the
+   // lower envelope of the parabolas rooted at each (finite) f[q]. Linear in
+   // count. v, z and d are scratch of at least count (count+1 for z) values.
+   //
+   // Note: squared distances are doubles, which hold them exactly (as integers)
+   // for any image size, where floats would round them beyond 2^24 (e.g. a
+   // distance of 4097 pixels).
+   inline void squaredDistance1D(double* f,unsigned count,std::vector<unsigned>& v,std::vector<double>& z,std::vector<double>& d) {
+      const double INF = std::numeric_limits<double>::infinity();
+      int k = -1;
+      for(unsigned q = 0;q < count;++q) {
+         if(INF == f[q]) continue;
+         double s = -INF;
+         while(k >= 0) {
+            const unsigned p = v[k];
+            // The intersection of the parabolas of q and of the envelope's last (p)
+            s = ((f[q] + (double)q*q) - (f[p] + (double)p*p))/(2.0*q - 2.0*p);
+            if(s > z[k]) break;
+            --k;
+         }
+         ++k;
+         v[k] = q;
+         z[k] = k > 0 ? s : -INF;
+         z[k+1] = INF;
+      }
+      if(k < 0) return; // all infinite
+
+      k = 0;
+      for(unsigned q = 0;q < count;++q) {
+         while(z[k+1] < q) ++k;
+         const double offset = (double)q - v[k];
+         d[q] = offset*offset + f[v[k]];
+      }
+      std::copy(d.begin(),d.begin() + count,f);
+   }
+
+   // squaredDistance1D of each of the rows of the rows x cols plane, bands of
+   // rows concurrently.
+   inline void squaredDistanceRows(std::vector<double>& plane,unsigned rows,unsigned cols) {
+      utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+         std::vector<unsigned> v(cols);
+         std::vector<double>   z(cols + 1u);
+         std::vector<double>   d(cols);
+         for(unsigned r = rowBegin;r < rowEnd;++r) squaredDistance1D(&plane[static_cast<std::size_t>(r)*cols],cols,v,z,d);
+      },std::max(1u,(1u << 14)/std::max(1u,cols)));
+   }
+
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// The exact Euclidean distance transform (Felzenszwalb & Huttenlocher): the
+// distance (in pixels) from each foreground (non-zero) pixel of src, e.g. the
+// output of binarize, to the nearest background (zero) pixel, which is 0 for
+// background pixels. If src has no background, distances are infinite.
+//
+// The separable 1D lower envelope passes are done for the columns (as the
+// rows of the transposed plane) and then for the rows, each a band of rows
+// concurrently, so that the cost is linear in the number of pixels.
+//
+// Distances are written as is to floating point tgt pixels, while integral
+// tgt pixels are scaled so that maxDistance (or if 0, the largest finite
+// distance) is their largest value, and saturate beyond it.
+template<typename SrcImageT,typename TgtImageT>
+void distanceTransform(const SrcImageT& src, TgtImageT& tgt,float maxDistance = 0.0f,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                 types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename PixelT::value_type                                      ValueT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+   typedef typename std::remove_const<TgtPixelT>::type::value_type          TgtValueT;
+
+   utility::reportIfNotLessThan("maxDistance",-1e-6f,maxDistance);
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   if(0 == rows || 0 == cols) return;
+   const double INF = std::numeric_limits<double>::infinity();
+
+   // Columns first (transposed, so that columns are rows), then rows
+   std::vector<double> plane(static_cast<std::size_t>(rows)*cols);
+   for(unsigned r = 0;r < rows;++r) {
+      const auto srow = types::rowPixels(src,r);
+      double* prow = &plane[static_cast<std::size_t>(r)*cols];
+      for(unsigned c = 0;c < cols;++c) prow[c] = static_cast<ValueT>(0) == srow[c].tuple.value0 ? 0.0 : INF;
+   }
+   {
+      std::vector<double> transposed(plane.size());
+      utility::transposePlane(&plane[0],&transposed[0],rows,cols);
+      detail::squaredDistanceRows(transposed,cols,rows);
+      utility::transposePlane(&transposed[0],&plane[0],cols,rows);
+   }
+   detail::squaredDistanceRows(plane,rows,cols);
+
+   double scale = 1.0;
+   if(std::is_integral<TgtValueT>::value) {
+      double largest = maxDistance;
+      if(0.0 == largest) {
+         for(double value : plane) if(INF != value) largest = std::max(largest,value);
+         largest = std::sqrt(largest);
+      }
+      scale = largest > 0.0 ? static_cast<double>(TgtPixelT::traits::max())/largest : 0.0;
+   }
+   for(unsigned r = 0;r < rows;++r) {
+      const auto trow = types::rowPixels(tgt,r);
+      const double* prow = &plane[static_cast<std::size_t>(r)*cols];
+      for(unsigned c = 0;c < cols;++c) {
+         const double distance = std::sqrt(prow[c]);
+         if(!std::is_integral<TgtValueT>::value) trow[c].tuple.value0 = static_cast<TgtValueT>(distance);
+         else if(0.0 == scale) trow[c].tuple.value0 = static_cast<TgtValueT>(INF == distance ? TgtPixelT::traits::max() : 0);
+         else trow[c].tuple.value0 = static_cast<TgtValueT>(std::min(static_cast<double>(TgtPixelT::traits::max()),std::floor(distance*scale + 0.5)));
+      }
+   }
+}
+
+} // namespace algorithm
+} // namespace batchIP
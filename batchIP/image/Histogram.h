@@ -0,0 +1,287 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+///////////////////////////////////////////////////////////////////////////////
+// ChannelHistogram - integer histograms of one or all channels of an Image
+//                    (or any view), computed in a single pass.
+//
+// Notes:
+// 1) There is one bin per channel value, i.e. 256 bins for 8-bit channels and
+//    65536 bins for 16-bit channels. Floating point channels are truncated
+//    into traits::max()+1 bins (so are of limited use).
+// 2) Rows are split into bands that are counted concurrently (see
+//    utility::parallelFor), and each band's counts are merged at the end.
+// 3) Within a band, consecutive pixels are counted into separate
+//    sub-histograms, so that runs of equal values don't serialize on
+//    incrementing the same bin (store-to-load forwarding stalls).
+// 4) Band counts are 32-bit, so a band is limited to 4G pixels per
+//    sub-histogram; merged counts are 64-bit.
+//
+template<typename PixelT>
+class ChannelHistogram {
+public:
+   typedef typename std::remove_const<PixelT>::type pixel_type;
+   typedef typename pixel_type::value_type          value_type;
+   typedef uint64_t                                 count_type;
+
+   enum { BINS = static_cast<unsigned>(pixel_type::traits::max()) + 1u };
+   enum { MAX_CHANNELS = pixel_type::MAX_CHANNELS };
+   // Sub-histograms only pay off while they (all) fit in L1 cache
+   enum { SUB_HISTOGRAMS = sizeof(value_type) == 1 ? 4 : 1 };
+   // Fewest pixels worth handing to a thread
+   enum { MIN_PIXELS_PER_BAND = 1u << 16 };
+
+private:
+   typedef uint32_t BandCountT;
+
+   unsigned                mChannelBegin;
+   unsigned                mChannelEnd;
+   count_type              mTotal;
+   std::vector<count_type> mCounts; // MAX_CHANNELS x BINS
+
+   template<typename ValueT>
+   static unsigned binIndex(ValueT value,typename std::enable_if<std::is_integral<ValueT>::value,int>::type* = 0) {
+      return static_cast<unsigned>(value);
+   }
+
+   template<typename ValueT>
+   static unsigned binIndex(ValueT value,typename std::enable_if<!std::is_integral<ValueT>::value,int>::type* = 0) {
+      if(!(value > 0)) return 0u;
+      return std::min(static_cast<unsigned>(value),static_cast<unsigned>(BINS) - 1u);
+   }
+
+   template<typename SrcImageT>
+   void countBand(const SrcImageT& src,unsigned rowBegin,unsigned rowEnd,std::vector<BandCountT>& band) const {
+      const unsigned channels = mChannelEnd - mChannelBegin;
+      const unsigned cols = src.cols();
+      band.assign(static_cast<std::size_t>(SUB_HISTOGRAMS)*channels*BINS,0u);
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto row = types::rowPixels(src,r);
+         unsigned c = 0;
+         for(;c + SUB_HISTOGRAMS <= cols;c += SUB_HISTOGRAMS) {
+            for(unsigned s = 0;s < SUB_HISTOGRAMS;++s) {
+               const pixel_type& pixel = row[c+s];
+               BandCountT* sub = &band[static_cast<std::size_t>(s)*channels*BINS];
+               for(unsigned ch = 0;ch < channels;++ch) {
+                  ++sub[ch*BINS + binIndex(pixel.indexedColor[mChannelBegin+ch])];
+               }
+            }
+         }
+         for(;c < cols;++c) {
+            const pixel_type& pixel = row[c];
+            for(unsigned ch = 0;ch < channels;++ch) {
+               ++band[ch*BINS + binIndex(pixel.indexedColor[mChannelBegin+ch])];
+            }
+         }
+      }
+   }
+
+   template<typename SrcImageT>
+   void compute(const SrcImageT& src) {
+      const unsigned rows = src.rows();
+      const unsigned cols = src.cols();
+      const unsigned channels = mChannelEnd - mChannelBegin;
+      mTotal = static_cast<count_type>(rows)*cols;
+      if(0 == mTotal) return;
+
+      const unsigned minRows = std::max(1u,static_cast<unsigned>(MIN_PIXELS_PER_BAND)/cols);
+      std::vector<std::vector<BandCountT> > bands(utility::parallelBlocks(0,rows,minRows));
+      utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned b) {
+         countBand(src,rowBegin,rowEnd,bands[b]);
+      },minRows);
+
+      // Now merge all sub-histograms of all bands
+      for(const std::vector<BandCountT>& band : bands) {
+         for(unsigned s = 0;s < SUB_HISTOGRAMS;++s) {
+            const BandCountT* sub = &band[static_cast<std::size_t>(s)*channels*BINS];
+            count_type* counts = &mCounts[mChannelBegin*BINS];
+            for(unsigned i = 0;i < channels*BINS;++i) counts[i] += sub[i];
+         }
+      }
+   }
+
+public:
+   // Histograms of all channels
+   template<typename SrcImageT>
+   explicit ChannelHistogram(const SrcImageT& src) :
+      mChannelBegin(0),
+      mChannelEnd(MAX_CHANNELS),
+      mTotal(0),
+      mCounts(static_cast<std::size_t>(MAX_CHANNELS)*BINS,0u) {
+      compute(src);
+   }
+
+   // Histogram of a single channel
+   template<typename SrcImageT>
+   ChannelHistogram(const SrcImageT& src,unsigned channel) :
+      mChannelBegin(channel),
+      mChannelEnd(channel+1),
+      mTotal(0),
+      mCounts(static_cast<std::size_t>(MAX_CHANNELS)*BINS,0u) {
+      utility::reportIfNotLessThan("channel",channel,(unsigned)MAX_CHANNELS);
+      compute(src);
+   }
+
+   unsigned bins() const { return BINS; }
+
+   bool hasChannel(unsigned channel) const { return channel >= mChannelBegin && channel < mChannelEnd; }
+
+   // Number of pixels counted (for each channel)
+   count_type total() const { return mTotal; }
+
+   // The BINS counts of channel
+   const count_type* counts(unsigned channel) const {
+      utility::reportIfEqual("channel was not counted",hasChannel(channel),false);
+      return &mCounts[channel*BINS];
+   }
+
+   count_type count(unsigned channel,unsigned bin) const {
+      utility::reportIfNotLessThan("bin",bin,(unsigned)BINS);
+      return counts(channel)[bin];
+   }
+
+   count_type maxCount(unsigned channel) const {
+      const count_type* c = counts(channel);
+      return *std::max_element(c,c + BINS);
+   }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// QuantileHistogram - order statistics (e.g. the median or a percentile) of
+//                     one channel of an Image (or any view), without copying
+//                     or sorting its values.
+//
+// Notes:
+// 1) The constructor counts the channel into a fine fixed-bin histogram of
+//    [low,high] (values outside are counted in the end bins), in a single pass
+//    of concurrently counted bands (as ChannelHistogram).
+// 2) rank() then finds the bin holding the requested order statistic, and only
+//    the values of that bin are collected (in a second pass) and selected
+//    with std::nth_element. So results are exact, for O(bins) extra memory
+//    (plus the values of one bin).
+// 3) The same histogram may be queried for any number of ranks, but each
+//    query reads src again, so src must not have changed.
+//
+template<typename ValueT>
+class QuantileHistogram {
+public:
+   typedef ValueT   value_type;
+   typedef uint64_t count_type;
+
+   enum { DEFAULT_BINS = 1u << 12 };
+   // Fewest pixels worth handing to a thread
+   enum { MIN_PIXELS_PER_BAND = 1u << 16 };
+
+private:
+   unsigned                mChannel;
+   double                  mLow;
+   double                  mScale;
+   count_type              mTotal;
+   std::vector<count_type> mCounts;
+
+   unsigned binIndex(ValueT value) const {
+      const double bin = (static_cast<double>(value) - mLow)*mScale;
+      if(!(bin > 0.0)) return 0u;
+      return std::min(static_cast<unsigned>(bin),bins() - 1u);
+   }
+
+   // Calls func(value) for the channel of each pixel in a band of rows
+   template<typename SrcImageT,typename FuncT>
+   void visitBand(const SrcImageT& src,unsigned rowBegin,unsigned rowEnd,FuncT func) const {
+      const unsigned cols = src.cols();
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto row = types::rowPixels(src,r);
+         for(unsigned c = 0;c < cols;++c) func(row[c].indexedColor[mChannel]);
+      }
+   }
+
+   template<typename SrcImageT>
+   unsigned minRowsPerBand(const SrcImageT& src) const {
+      return std::max(1u,static_cast<unsigned>(MIN_PIXELS_PER_BAND)/std::max(1u,src.cols()));
+   }
+
+public:
+   template<typename SrcImageT>
+   QuantileHistogram(const SrcImageT& src,unsigned channel,ValueT low,ValueT high,unsigned bins = DEFAULT_BINS) :
+      mChannel(channel),
+      mLow(static_cast<double>(low)),
+      mScale(0.0),
+      mTotal(static_cast<count_type>(src.rows())*src.cols()),
+      mCounts(bins,0u) {
+
+      typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+      static_assert(std::is_same<typename PixelT::value_type,ValueT>::value,"ValueT must be the channel type");
+      utility::reportIfNotLessThan("channel",channel,(unsigned)PixelT::MAX_CHANNELS);
+      utility::reportIfEqual("bins",bins,0u);
+      if(high > low) mScale = bins/(static_cast<double>(high) - mLow);
+      if(0 == mTotal) return;
+
+      const unsigned rows = src.rows();
+      const unsigned minRows = minRowsPerBand(src);
+      std::vector<std::vector<uint32_t> > bands(utility::parallelBlocks(0,rows,minRows));
+      utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned b) {
+         std::vector<uint32_t>& band = bands[b];
+         band.assign(bins,0u);
+         visitBand(src,rowBegin,rowEnd,[&](ValueT value) { ++band[binIndex(value)]; });
+      },minRows);
+
+      for(const std::vector<uint32_t>& band : bands) {
+         for(unsigned i = 0;i < bins;++i) mCounts[i] += band[i];
+      }
+   }
+
+   unsigned bins() const { return static_cast<unsigned>(mCounts.size()); }
+
+   count_type total() const { return mTotal; }
+
+   // The k-th smallest (from 0) value of the channel of src (which must be the
+   // image the histogram was counted from)
+   template<typename SrcImageT>
+   ValueT rank(const SrcImageT& src,count_type k) const {
+      utility::reportIfNotLessThan("rank",k,mTotal);
+
+      // Find the bin holding the k-th value...
+      unsigned bin = 0;
+      count_type below = 0;
+      for(;below + mCounts[bin] <= k;++bin) below += mCounts[bin];
+
+      // ...and select among just its values
+      const unsigned rows = src.rows();
+      const unsigned minRows = minRowsPerBand(src);
+      std::vector<std::vector<ValueT> > bands(utility::parallelBlocks(0,rows,minRows));
+      utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned b) {
+         std::vector<ValueT>& band = bands[b];
+         visitBand(src,rowBegin,rowEnd,[&](ValueT value) { if(binIndex(value) == bin) band.push_back(value); });
+      },minRows);
+      std::vector<ValueT> values;
+      values.reserve(static_cast<std::size_t>(mCounts[bin]));
+      for(const std::vector<ValueT>& band : bands) values.insert(values.end(),band.begin(),band.end());
+      utility::reportIfNotEqual("src does not match the histogram",static_cast<count_type>(values.size()),mCounts[bin]);
+
+      typename std::vector<ValueT>::iterator nth = values.begin() + static_cast<std::ptrdiff_t>(k - below);
+      std::nth_element(values.begin(),nth,values.end());
+      return *nth;
+   }
+
+   // The value below which fraction (in [0,1]) of the channel's values lie,
+   // i.e. the rank of floor(fraction*(total-1))
+   template<typename SrcImageT>
+   ValueT quantile(const SrcImageT& src,double fraction) const {
+      utility::reportIfEqual("empty image",mTotal,(count_type)0u);
+      fraction = std::max(0.0,std::min(1.0,fraction));
+      return rank(src,static_cast<count_type>(fraction*(mTotal - 1u)));
+   }
+};
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,423 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "cppTools/NumericConstants.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+// A line of the points (row,col) where col*cos(theta) + row*sin(theta) = rho,
+// with theta in [0,pi) (the direction of the line's normal, clockwise from
+// the column axis).
+struct HoughLine {
+   float    rho;
+   float    theta;
+   unsigned votes;
+};
+
+struct HoughCircle {
+   float    row;
+   float    col;
+   float    radius;
+   unsigned votes;
+};
+
+// An edge pixel, and its gradient direction (NaN if it is unknown)
+struct HoughPoint {
+   uint16_t row;
+   uint16_t col;
+   float    direction;
+};
+
+enum { HOUGH_DEFAULT_THETA_BINS = 180 };
+// The side (in pixels) of the cells of houghCircles' center accumulator
+enum { HOUGH_CENTER_CELL = 2 };
+
+namespace detail {
+
+   // The direction of the normal (i.e. theta) of the edge through a pixel,
+   // within [0,pi), from its gradient direction as edgeGradientAndDirection
+   // gives it (atan2 of the partial gradients, with rows increasing upward).
+   inline float houghNormal(float direction) {
+      const float pi = static_cast<float>(stdesque::numeric::pi());
+      float theta = std::fmod(-direction,pi);
+      if(theta < 0.0f) theta += pi;
+      return theta;
+   }
+
+   // Adds the per-thread accumulators into the first (a band of bins per thread)
+   inline void mergeAccumulators(std::vector<std::vector<uint32_t> >& accumulators) {
+      if(accumulators.size() < 2) return;
+      std::vector<uint32_t>& merged = accumulators[0];
+      utility::parallelFor(0,static_cast<unsigned>(merged.size()),[&](unsigned begin,unsigned end,unsigned) {
+         for(unsigned a = 1;a < accumulators.size();++a) {
+            const uint32_t* votes = &accumulators[a][0];
+            for(unsigned i = begin;i < end;++i) merged[i] += votes[i];
+         }
+      },1u << 16);
+   }
+
+   // Replaces each count of the rows x cols accumulator by the sum of the
+   // (clipped) square of half pixels around it (rows, then columns, of
+   // running sums).
+   inline void accumulatorBoxSum(std::vector<uint32_t>& accumulator,unsigned rows,unsigned cols,unsigned half) {
+      std::vector<uint32_t> line(std::max(rows,cols) + 1u);
+      auto boxLine = [&](uint32_t* values,unsigned count,std::size_t step) {
+         line[0] = 0u;
+         for(unsigned i = 0;i < count;++i) line[i+1] = line[i] + values[i*step];
+         for(unsigned i = 0;i < count;++i) values[i*step] = line[std::min(count,i + half + 1u)] - line[i > half ? i - half : 0u];
+      };
+      for(unsigned r = 0;r < rows;++r) boxLine(&accumulator[static_cast<std::size_t>(r)*cols],cols,1u);
+      for(unsigned c = 0;c < cols;++c) boxLine(&accumulator[c],rows,cols);
+   }
+
+   // Indices of the bins of the rows x cols accumulator holding at least
+   // minVotes which are maxima of their 3x3 neighbourhood, most votes first.
+   // If mirrored, the last row neighbours the first, reversed (as theta = pi
+   // is theta = 0 with the sign of rho reversed).
+   inline std::vector<unsigned> accumulatorPeaks(const std::vector<uint32_t>& accumulator,unsigned rows,unsigned cols,unsigned minVotes,bool mirrored) {
+      std::vector<unsigned> peaks;
+      for(unsigned r = 0;r < rows;++r) {
+         for(unsigned c = 0;c < cols;++c) {
+            const unsigned index = r*cols + c;
+            const uint32_t votes = accumulator[index];
+            if(votes < std::max(1u,minVotes)) continue;
+            bool isPeak = true;
+            for(int i = (int)r - 1;isPeak && i <= (int)r + 1;++i) {
+               const bool wrapped = i < 0 || i >= (int)rows;
+               if(wrapped && (!mirrored || rows < 3)) continue;
+               const unsigned row = wrapped ? (i < 0 ? rows - 1 : 0) : (unsigned)i;
+               for(int j = (int)c - 1;j <= (int)c + 1;++j) {
+                  if(j < 0 || j >= (int)cols) continue;
+                  const unsigned col = wrapped ? cols - 1 - (unsigned)j : (unsigned)j;
+                  const unsigned neighbour = row*cols + col;
+                  // Note: of equal neighbours, only the first is a peak
+                  if(accumulator[neighbour] > votes || (neighbour < index && accumulator[neighbour] == votes)) { isPeak = false; break; }
+               }
+            }
+            if(isPeak) peaks.push_back(index);
+         }
+      }
+      std::stable_sort(peaks.begin(),peaks.end(),[&](unsigned a,unsigned b) { return accumulator[a] > accumulator[b]; });
+      return peaks;
+   }
+
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Gathers the edge (i.e. non-zero) pixels of edges (and their directions, if
+// given) into a compact list in one sweep, of bands of rows concurrently.
+template<typename EdgeImageT,typename DirectionImageT>
+std::vector<HoughPoint> houghPoints(const EdgeImageT& edges,const DirectionImageT* directions) {
+
+   typedef typename std::remove_const<typename EdgeImageT::pixel_type>::type PixelT;
+   typedef typename PixelT::value_type                                      ValueT;
+
+   const unsigned rows = edges.rows();
+   const unsigned cols = edges.cols();
+   utility::reportIfNotLessThan("edges.rows()",rows,(unsigned)std::numeric_limits<uint16_t>::max() + 1u);
+   utility::reportIfNotLessThan("edges.cols()",cols,(unsigned)std::numeric_limits<uint16_t>::max() + 1u);
+   if(0 != directions) {
+      utility::reportIfNotEqual("edges.rows() != directions->rows()",rows,directions->rows());
+      utility::reportIfNotEqual("edges.cols() != directions->cols()",cols,directions->cols());
+   }
+   if(0 == rows || 0 == cols) return std::vector<HoughPoint>();
+
+   std::vector<std::vector<HoughPoint> > bands(utility::parallelBlocks(0,rows,64u));
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned block) {
+      std::vector<HoughPoint>& band = bands[block];
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto row = types::rowPixels(edges,r);
+         for(unsigned c = 0;c < cols;++c) {
+            if(static_cast<ValueT>(0) == row[c].tuple.value0) continue;
+            HoughPoint point;
+            point.row = static_cast<uint16_t>(r);
+            point.col = static_cast<uint16_t>(c);
+            point.direction = 0 != directions ? static_cast<float>(directions->pixel(r,c).tuple.value0)
+                                              : std::numeric_limits<float>::quiet_NaN();
+            band.push_back(point);
+         }
+      }
+   },64u);
+
+   std::vector<HoughPoint> points;
+   for(const std::vector<HoughPoint>& band : bands) points.insert(points.end(),band.begin(),band.end());
+   return points;
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Finds (up to maxLines of) the straight lines through the edge pixels of
+// edges with the (rho,theta) Hough transform, at a resolution of one pixel of
+// rho and thetaBins steps of theta.
+//
+// Each edge point votes with precomputed sin/cos tables into its own thread's
+// accumulator, and the accumulators are merged at the end. If directions (the
+// gradient directions of edgeGradientAndDirection) are given, each point votes
+// only for the thetas within angleTolerance (radians) of its edge normal
+// (points whose direction is NaN vote for all thetas).
+//
+// Lines are local maxima of the accumulator with at least minVotes, most
+// votes first.
+template<typename EdgeImageT,typename DirectionImageT>
+std::vector<HoughLine> houghLines(const EdgeImageT& edges,const DirectionImageT* directions,
+                                  unsigned thetaBins,float angleTolerance,unsigned minVotes,unsigned maxLines) {
+
+   utility::reportIfNotLessThan("thetaBins",0u,thetaBins);
+   utility::reportIfNotLessThan("angleTolerance",-1e-6f,angleTolerance);
+
+   const std::vector<HoughPoint> points = houghPoints(edges,directions);
+   const double pi = stdesque::numeric::pi();
+   const int maxRho = static_cast<int>(std::ceil(std::hypot((double)edges.rows(),(double)edges.cols())));
+   const unsigned rhoBins = 2u*maxRho + 1u;
+
+   std::vector<float> cosTable(thetaBins);
+   std::vector<float> sinTable(thetaBins);
+   for(unsigned t = 0;t < thetaBins;++t) {
+      cosTable[t] = static_cast<float>(std::cos(t*pi/thetaBins));
+      sinTable[t] = static_cast<float>(std::sin(t*pi/thetaBins));
+   }
+   // Bins either side of the normal's bin that a directed point votes for
+   const unsigned spread = std::min(thetaBins/2u,static_cast<unsigned>(std::ceil(angleTolerance*thetaBins/pi)));
+
+   std::vector<std::vector<uint32_t> > accumulators(utility::parallelBlocks(0,(unsigned)points.size(),4096u));
+   utility::parallelFor(0,(unsigned)points.size(),[&](unsigned begin,unsigned end,unsigned block) {
+      std::vector<uint32_t>& accumulator = accumulators[block];
+      accumulator.assign(static_cast<std::size_t>(thetaBins)*rhoBins,0u);
+      for(unsigned p = begin;p < end;++p) {
+         const HoughPoint& point = points[p];
+         const float x = point.col;
+         const float y = point.row;
+         if(std::isnan(point.direction) || 2u*spread + 1u >= thetaBins) {
+            for(unsigned t = 0;t < thetaBins;++t) {
+               const int rho = static_cast<int>(std::lround(x*cosTable[t] + y*sinTable[t]));
+               ++accumulator[static_cast<std::size_t>(t)*rhoBins + (rho + maxRho)];
+            }
+         }
+         else {
+            const unsigned center = static_cast<unsigned>(std::lround(detail::houghNormal(point.direction)*thetaBins/pi)) % thetaBins;
+            for(unsigned i = 0;i <= 2u*spread;++i) {
+               // Note: the (wrapped) table of theta gives the matching sign of rho
+               const unsigned t = (center + thetaBins + i - spread) % thetaBins;
+               const int rho = static_cast<int>(std::lround(x*cosTable[t] + y*sinTable[t]));
+               ++accumulator[static_cast<std::size_t>(t)*rhoBins + (rho + maxRho)];
+            }
+         }
+      }
+   },4096u);
+   if(accumulators.empty()) return std::vector<HoughLine>();
+   detail::mergeAccumulators(accumulators);
+
+   const std::vector<unsigned> peaks = detail::accumulatorPeaks(accumulators[0],thetaBins,rhoBins,minVotes,true);
+   std::vector<HoughLine> lines;
+   for(unsigned i = 0;i < peaks.size() && lines.size() < maxLines;++i) {
+      HoughLine line;
+      line.rho = static_cast<float>(static_cast<int>(peaks[i] % rhoBins) - maxRho);
+      line.theta = static_cast<float>((peaks[i] / rhoBins)*pi/thetaBins);
+      line.votes = accumulators[0][peaks[i]];
+      lines.push_back(line);
+   }
+   return lines;
+}
+
+template<typename EdgeImageT>
+std::vector<HoughLine> houghLines(const EdgeImageT& edges,unsigned thetaBins,unsigned minVotes,unsigned maxLines) {
+   typedef types::Image<types::MonochromePixel<float> > DirectionImageT;
+   return houghLines(edges,(const DirectionImageT*)0,thetaBins,0.0f,minVotes,maxLines);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Finds (up to maxCircles of) the circles with radii in [minRadius,maxRadius]
+// through the edge pixels of edges, from their gradient directions (those of
+// edgeGradientAndDirection; points whose direction is NaN don't vote).
+//
+// Each point votes for the centers along its gradient line, both ways, from
+// minRadius to maxRadius away, into one accumulator (shared by all threads,
+// with atomic increments) of cells of HOUGH_CENTER_CELL x HOUGH_CENTER_CELL
+// pixels, so that its memory is the same for any number of threads. Peaks are
+// local maxima of the votes of 3x3 cells with at least minVotes, most votes
+// first. Each is refined (with the radius) to the center within its cell (or
+// 2 pixels around it) that the most edge points are equally distant from
+// (which must also number at least minVotes), among just the points binned
+// near the peak, and peaks are refined concurrently. Centers closer than
+// minRadius to a circle already found are skipped.
+template<typename EdgeImageT,typename DirectionImageT>
+std::vector<HoughCircle> houghCircles(const EdgeImageT& edges,const DirectionImageT& directions,
+                                      unsigned minRadius,unsigned maxRadius,unsigned minVotes,unsigned maxCircles) {
+
+   utility::reportIfNotLessThan("minRadius",0u,minRadius);
+   utility::reportIfNotLessThan("minRadius",minRadius,maxRadius + 1u);
+
+   const unsigned rows = edges.rows();
+   const unsigned cols = edges.cols();
+   const std::vector<HoughPoint> points = houghPoints(edges,&directions);
+   if(points.empty()) return std::vector<HoughCircle>();
+   const unsigned CELL = HOUGH_CENTER_CELL;
+   const unsigned cellRows = (rows + CELL - 1u)/CELL;
+   const unsigned cellCols = (cols + CELL - 1u)/CELL;
+
+   std::vector<uint32_t> accumulator;
+   {
+      std::vector<std::atomic<uint32_t> > votes(static_cast<std::size_t>(cellRows)*cellCols);
+      utility::parallelFor(0,(unsigned)points.size(),[&](unsigned begin,unsigned end,unsigned) {
+         for(unsigned p = begin;p < end;++p) {
+            const HoughPoint& point = points[p];
+            if(std::isnan(point.direction)) continue;
+            // Note: directions are measured with rows increasing upward
+            const float dx = std::cos(point.direction);
+            const float dy = -std::sin(point.direction);
+            for(int sign = -1;sign <= 1;sign += 2) {
+               for(unsigned radius = minRadius;radius <= maxRadius;++radius) {
+                  const long r = std::lround(point.row + sign*(float)radius*dy);
+                  const long c = std::lround(point.col + sign*(float)radius*dx);
+                  if(r < 0 || c < 0 || r >= (long)rows || c >= (long)cols) break;
+                  votes[static_cast<std::size_t>(r/CELL)*cellCols + c/CELL].fetch_add(1u,std::memory_order_relaxed);
+               }
+            }
+         }
+      },4096u);
+      accumulator.resize(votes.size());
+      for(std::size_t i = 0;i < votes.size();++i) accumulator[i] = votes[i].load(std::memory_order_relaxed);
+   }
+   // The votes for centers are smeared by the quantized gradient directions
+   detail::accumulatorBoxSum(accumulator,cellRows,cellCols,1u);
+   const std::vector<unsigned> peaks = detail::accumulatorPeaks(accumulator,cellRows,cellCols,minVotes,false);
+
+   // Bin the points (by square bins of side maxRadius), so that refining a peak only visits the points near it
+   const int CENTER_SEARCH = 2;
+   const unsigned binSide = std::max(16u,maxRadius);
+   const unsigned binRows = (rows + binSide - 1u)/binSide;
+   const unsigned binCols = (cols + binSide - 1u)/binSide;
+   std::vector<unsigned> binBegins(static_cast<std::size_t>(binRows)*binCols + 1u,0u);
+   for(const HoughPoint& point : points) ++binBegins[(point.row/binSide)*binCols + point.col/binSide + 1u];
+   for(unsigned b = 1;b < binBegins.size();++b) binBegins[b] += binBegins[b-1];
+   std::vector<HoughPoint> binned(points.size());
+   {
+      std::vector<unsigned> next(binBegins.begin(),binBegins.end() - 1);
+      for(const HoughPoint& point : points) binned[next[(point.row/binSide)*binCols + point.col/binSide]++] = point;
+   }
+
+   // The center (and radius) within CENTER_SEARCH pixels of the peak's cell
+   // which the most edge points are equally distant from
+   auto refine = [&](unsigned peak,std::vector<unsigned>& radii,std::vector<const HoughPoint*>& nearby) {
+      const int rowBegin = std::max(0,(int)((peak / cellCols)*CELL) - CENTER_SEARCH);
+      const int colBegin = std::max(0,(int)((peak % cellCols)*CELL) - CENTER_SEARCH);
+      const int rowEnd = std::min((int)rows,(int)((peak / cellCols + 1u)*CELL) + CENTER_SEARCH);
+      const int colEnd = std::min((int)cols,(int)((peak % cellCols + 1u)*CELL) + CENTER_SEARCH);
+      const int reach = (int)maxRadius + 1;
+      nearby.clear();
+      const unsigned binRowEnd = std::min(binRows - 1u,(unsigned)(rowEnd - 1 + reach)/binSide);
+      const unsigned binColEnd = std::min(binCols - 1u,(unsigned)(colEnd - 1 + reach)/binSide);
+      for(unsigned br = (unsigned)std::max(0,rowBegin - reach)/binSide;br <= binRowEnd;++br) {
+         for(unsigned bc = (unsigned)std::max(0,colBegin - reach)/binSide;bc <= binColEnd;++bc) {
+            for(unsigned p = binBegins[br*binCols + bc];p < binBegins[br*binCols + bc + 1u];++p) {
+               const HoughPoint& point = binned[p];
+               if((int)point.row >= rowBegin - reach && (int)point.row < rowEnd + reach &&
+                  (int)point.col >= colBegin - reach && (int)point.col < colEnd + reach) nearby.push_back(&point);
+            }
+         }
+      }
+      HoughCircle circle;
+      circle.votes = 0;
+      for(int row = rowBegin;row < rowEnd;++row) {
+         for(int col = colBegin;col < colEnd;++col) {
+            std::fill(radii.begin(),radii.end(),0u);
+            for(const HoughPoint* point : nearby) {
+               const unsigned radius = static_cast<unsigned>(std::lround(std::hypot((float)point->row - row,(float)point->col - col)));
+               if(radius >= minRadius && radius <= maxRadius) ++radii[radius];
+            }
+            const unsigned best = static_cast<unsigned>(std::max_element(radii.begin(),radii.end()) - radii.begin());
+            if(radii[best] > circle.votes) {
+               circle.row = static_cast<float>(row);
+               circle.col = static_cast<float>(col);
+               circle.radius = static_cast<float>(best);
+               circle.votes = radii[best];
+            }
+         }
+      }
+      return circle;
+   };
+
+   // Peaks are refined concurrently, a batch at a time, and accepted in order
+   std::vector<HoughCircle> circles;
+   auto near = [&](float row,float col) {
+      for(const HoughCircle& circle : circles) if(std::hypot(circle.row - row,circle.col - col) < minRadius) return true;
+      return false;
+   };
+   const unsigned batchSize = std::max(maxCircles,utility::threadCount());
+   for(unsigned i = 0;i < peaks.size() && circles.size() < maxCircles;) {
+      std::vector<unsigned> batch;
+      for(;i < peaks.size() && batch.size() < batchSize;++i) {
+         const float peakRow = (peaks[i] / cellCols + 0.5f)*CELL;
+         const float peakCol = (peaks[i] % cellCols + 0.5f)*CELL;
+         if(!near(peakRow,peakCol)) batch.push_back(peaks[i]);
+      }
+      std::vector<HoughCircle> refined(batch.size());
+      utility::parallelFor(0,(unsigned)batch.size(),[&](unsigned begin,unsigned end,unsigned) {
+         std::vector<unsigned> radii(maxRadius + 1u);
+         std::vector<const HoughPoint*> nearby;
+         for(unsigned b = begin;b < end;++b) refined[b] = refine(batch[b],radii,nearby);
+      });
+      for(const HoughCircle& circle : refined) {
+         if(circles.size() == maxCircles) break;
+         if(circle.votes >= std::max(1u,minVotes) && !near(circle.row,circle.col)) circles.push_back(circle);
+      }
+   }
+   return circles;
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Draws lines (or circles) over tgt with value
+template<typename TgtImageT>
+void drawHoughLines(TgtImageT& tgt,const std::vector<HoughLine>& lines,typename TgtImageT::pixel_type::value_type value) {
+   const int rows = static_cast<int>(tgt.rows());
+   const int cols = static_cast<int>(tgt.cols());
+   for(const HoughLine& line : lines) {
+      const double cosTheta = std::cos(line.theta);
+      const double sinTheta = std::sin(line.theta);
+      // Step along whichever axis the line is closer to
+      if(std::fabs(sinTheta) >= std::fabs(cosTheta)) {
+         for(int c = 0;c < cols;++c) {
+            const long r = std::lround((line.rho - c*cosTheta)/sinTheta);
+            if(r >= 0 && r < rows) tgt.pixel(r,c).tuple.value0 = value;
+         }
+      }
+      else {
+         for(int r = 0;r < rows;++r) {
+            const long c = std::lround((line.rho - r*sinTheta)/cosTheta);
+            if(c >= 0 && c < cols) tgt.pixel(r,c).tuple.value0 = value;
+         }
+      }
+   }
+}
+
+template<typename TgtImageT>
+void drawHoughCircles(TgtImageT& tgt,const std::vector<HoughCircle>& circles,typename TgtImageT::pixel_type::value_type value) {
+   const long rows = static_cast<long>(tgt.rows());
+   const long cols = static_cast<long>(tgt.cols());
+   for(const HoughCircle& circle : circles) {
+      const unsigned steps = std::max(8u,static_cast<unsigned>(std::ceil(stdesque::numeric::twoPi()*circle.radius))*2u);
+      for(unsigned s = 0;s < steps;++s) {
+         const double angle = stdesque::numeric::twoPi()*s/steps;
+         const long r = std::lround(circle.row + circle.radius*std::sin(angle));
+         const long c = std::lround(circle.col + circle.radius*std::cos(angle));
+         if(r >= 0 && r < rows && c >= 0 && c < cols) tgt.pixel(r,c).tuple.value0 = value;
+      }
+   }
+}
+
+} // namespace algorithm
+} // namespace batchIP
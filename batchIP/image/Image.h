@@ -2,7 +2,10 @@
 
 #include "cppTools/TemplateMetaprogramming.h"
 #include "utility/Error.h"
+#include <cstddef>
 #include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace batchIP {
@@ -445,15 +448,15 @@ private:
 
       ++mColPos;
 
-      unsigned halfCols = (mBounds.cols()-1)/2;
+      // Note: the window stays centered, so is limited by the nearer border (even
+      // when the window is larger than the bounds)
+      unsigned rColPos = mBounds.cols()-1-mColPos;
 
-      if(mColPos < mHalfWindowCols) mElasticHalfWindowCols = std::min(mColPos,halfCols);
+      if(mColPos < mHalfWindowCols) mElasticHalfWindowCols = std::min(mColPos,rColPos);
       else {
-         unsigned rColPos = mBounds.cols()-1-mColPos;
-         if(rColPos < mHalfWindowCols) mElasticHalfWindowCols = std::min(rColPos,halfCols);
+         if(rColPos < mHalfWindowCols) mElasticHalfWindowCols = rColPos;
          else {
-            // We can only get here if Window is smaller or equal to bounds
-            // so no need to do std::min(mHalfWindowCols,halfCols)
+            // Both borders are at least a half window away
             mElasticHalfWindowCols = mHalfWindowCols;
          }
       }
@@ -490,15 +493,15 @@ private:
 
       ++mRowPos;
 
-      unsigned halfRows = (mBounds.rows()-1)/2;
+      // Note: the window stays centered, so is limited by the nearer border (even
+      // when the window is larger than the bounds)
+      unsigned rRowPos = mBounds.rows()-1-mRowPos;
 
-      if(mRowPos < mHalfWindowRows) mElasticHalfWindowRows = std::min(mRowPos,halfRows);
+      if(mRowPos < mHalfWindowRows) mElasticHalfWindowRows = std::min(mRowPos,rRowPos);
       else {
-         unsigned rRowPos = mBounds.rows()-1-mRowPos;
-         if(rRowPos < mHalfWindowRows) mElasticHalfWindowRows = std::min(rRowPos,halfRows);
+         if(rRowPos < mHalfWindowRows) mElasticHalfWindowRows = rRowPos;
          else {
-            // We can only get here if Window is smaller or equal to bounds
-            // so no need to do std::min(mHalfWindowRows,halfRows)
+            // Both borders are at least a half window away
             mElasticHalfWindowRows = mHalfWindowRows;
          }
       }
@@ -591,6 +594,151 @@ public:
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+// StridedImageView - a decimated view of an Image that visits every rowStep'th
+//                    row and every colStep'th column of its parent.
+//
+// Supports:
+// 1) Iteration of the decimated view (compatible with any algorithm that
+//    accepts an ImageView as a source or target).
+// 2) Indexed access to pixels for read or write, in decimated coordinates.
+// 3) Subviews and further decimation (strides compose multiplicatively).
+//
+// No pixels are copied, so a nearest-neighbour downsample is simply a
+// StridedImageView, and statistics (histograms, thresholds, means...) may be
+// estimated on a StridedImageView at a fraction of the cost of the full view.
+//
+template<typename PixelT,
+         typename ImageStoreT  = ImageStore<typename std::remove_const<PixelT>::type>,
+         typename ImageBoundsT = ImageBounds<typename std::remove_const<PixelT>::type> >
+class StridedImageView {
+public:
+   typedef StridedImageView<PixelT,ImageStoreT,ImageBoundsT>   this_type;
+   typedef typename std::remove_const<PixelT>::type            pixel_type;
+   typedef ImageStoreT                                         image_store;
+   typedef ImageBoundsT                                        image_bounds;
+   typedef StridedImageView<PixelT,ImageStoreT,ImageBoundsT>   strided_image_view;
+   typedef const StridedImageView<const pixel_type>            const_strided_image_view;
+   typedef ImageViewIterator<PixelT,this_type>                 iterator;
+   typedef ImageViewIterator<const pixel_type,const this_type> const_iterator;
+
+private:
+   unsigned     mRows;     // rows in decimated coordinates
+   unsigned     mCols;     // cols in decimated coordinates
+   unsigned     mRowStep;
+   unsigned     mColStep;
+   // mRowBegin and mColBegin are absolute ImageStore coordinates
+   unsigned     mRowBegin;
+   unsigned     mColBegin;
+   image_store* mStore;
+
+public:
+   // Note: rowPos and colPos are offsets (not decimated) within bounds.
+   StridedImageView(unsigned rows,unsigned cols,
+                    unsigned rowStep,unsigned colStep,
+                    image_store* store,
+                    image_bounds* bounds,
+                    unsigned rowPos = 0, unsigned colPos = 0) :
+      mRows(rows),
+      mCols(cols),
+      mRowStep(rowStep),
+      mColStep(colStep),
+      mRowBegin(rowPos+bounds->rowBegin()),
+      mColBegin(colPos+bounds->colBegin()),
+      mStore(store) {
+      // Ensure steps are at least 1 or greater!
+      utility::reportIfNotLessThan("rowStep",0u,rowStep);
+      utility::reportIfNotLessThan("colStep",0u,colStep);
+      // Ensure that the last pixel visited is within bounds, and throw exception if not
+      if(rows > 0) utility::reportIfNotLessThan("rowPos+(rows-1)*rowStep",rowPos + (rows-1)*rowStep,bounds->rows());
+      if(cols > 0) utility::reportIfNotLessThan("colPos+(cols-1)*colStep",colPos + (cols-1)*colStep,bounds->cols());
+   }
+
+   // This conversion constructor is used to convert between non-const
+   // and const versions of PixelT.
+   template<typename StridedImageViewT>
+   explicit StridedImageView(const StridedImageViewT& that) :
+      mRows(that.rows()),
+      mCols(that.cols()),
+      mRowStep(that.rowStep()),
+      mColStep(that.colStep()),
+      mRowBegin(that.rowBegin()),
+      mColBegin(that.colBegin()),
+      mStore(const_cast<image_store*>(static_cast<const image_store*>(that.store())))
+   {}
+
+   const PixelT& pixel(unsigned row, unsigned col) const {
+      // Verify that the requested pixel is within the bounds of the StridedImageView
+      utility::reportIfNotLessThan("row",row,mRows);
+      utility::reportIfNotLessThan("col",col,mCols);
+      return mStore->pixel(row*mRowStep+mRowBegin,col*mColStep+mColBegin);
+   }
+
+   PixelT& pixel(unsigned row, unsigned col) {
+      // Note: if StridedImageView PixelT is a const type, the below const_cast is a no-op.
+      return const_cast<PixelT&>(static_cast<const this_type&>(*this).pixel(row,col));
+   }
+
+   unsigned rows() const { return mRows; }
+
+   unsigned cols() const { return mCols; }
+
+   unsigned size() const { return mRows*mCols; }
+
+   unsigned rowStep() const { return mRowStep; }
+
+   unsigned colStep() const { return mColStep; }
+
+   unsigned rowBegin() const { return mRowBegin; }
+
+   unsigned colBegin() const { return mColBegin; }
+
+   const_strided_image_view view(unsigned rows,unsigned cols,
+                                 unsigned rowPos = 0,unsigned colPos = 0) const {
+      utility::reportIfNotLessThan("rowPos+rows",rowPos + rows,mRows+1);
+      utility::reportIfNotLessThan("colPos+cols",colPos + cols,mCols+1);
+      return const_strided_image_view(rows,cols,mRowStep,mColStep,mStore,mStore,
+                                      mRowBegin + rowPos*mRowStep,mColBegin + colPos*mColStep);
+   }
+
+   // take a subview of the view, where all arguments are in decimated coordinates
+   strided_image_view view(unsigned rows,unsigned cols,
+                           unsigned rowPos = 0,unsigned colPos = 0) {
+      utility::reportIfNotLessThan("rowPos+rows",rowPos + rows,mRows+1);
+      utility::reportIfNotLessThan("colPos+cols",colPos + cols,mCols+1);
+      return strided_image_view(rows,cols,mRowStep,mColStep,mStore,mStore,
+                                mRowBegin + rowPos*mRowStep,mColBegin + colPos*mColStep);
+   }
+
+   const_strided_image_view strided_view(unsigned rowStep,unsigned colStep) const {
+      utility::reportIfNotLessThan("rowStep",0u,rowStep);
+      utility::reportIfNotLessThan("colStep",0u,colStep);
+      return const_strided_image_view((mRows + rowStep - 1)/rowStep,(mCols + colStep - 1)/colStep,
+                                      mRowStep*rowStep,mColStep*colStep,mStore,mStore,
+                                      mRowBegin,mColBegin);
+   }
+
+   // further decimate the view
+   strided_image_view strided_view(unsigned rowStep,unsigned colStep) {
+      utility::reportIfNotLessThan("rowStep",0u,rowStep);
+      utility::reportIfNotLessThan("colStep",0u,colStep);
+      return strided_image_view((mRows + rowStep - 1)/rowStep,(mCols + colStep - 1)/colStep,
+                                mRowStep*rowStep,mColStep*colStep,mStore,mStore,
+                                mRowBegin,mColBegin);
+   }
+
+   iterator begin() { return iterator::begin(this); }
+
+   iterator end() { return iterator::end(this); }
+
+   const_iterator begin() const { return const_iterator::begin(this); }
+
+   const_iterator end() const { return const_iterator::end(this); }
+
+   const void* store() const { return mStore; }
+};
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ImageView - a view of an Image is a bounded box that is valid anywhere
@@ -629,6 +777,8 @@ public:
    typedef ImageViewIterator<const pixel_type,const image_window> const_iterator;
    typedef ElasticImageView<pixel_type>                           elastic_image_view;
    typedef ElasticImageView<const pixel_type>                     const_elastic_image_view;
+   typedef StridedImageView<pixel_type>                           strided_image_view;
+   typedef const StridedImageView<const pixel_type>               const_strided_image_view;
 
    ImageView(unsigned rows,unsigned cols,
              image_store* store,
@@ -746,6 +896,25 @@ public:
    // take a subview of the view
    elastic_image_view elastic_view(unsigned rows,unsigned cols) { return elastic_image_view(rows,cols,this->mStore,this); }
 
+   const_strided_image_view strided_view(unsigned rowStep,unsigned colStep) const {
+      utility::reportIfNotLessThan("rowStep",0u,rowStep);
+      utility::reportIfNotLessThan("colStep",0u,colStep);
+      return const_strided_image_view((this->mRows + rowStep - 1)/rowStep,(this->mCols + colStep - 1)/colStep,
+                             rowStep,colStep,
+                             // Although Views can be made const, it does not make sense to have
+                             // a const ImageStore or ImageBounds type.
+                             const_cast<typename std::remove_const<image_store>::type*>(this->mStore),
+                             const_cast<typename std::remove_const<image_bounds>::type*>(static_cast<const image_bounds*>(this)));
+   }
+
+   // take a decimated view of the view (every rowStep'th row and colStep'th column)
+   strided_image_view strided_view(unsigned rowStep,unsigned colStep) {
+      utility::reportIfNotLessThan("rowStep",0u,rowStep);
+      utility::reportIfNotLessThan("colStep",0u,colStep);
+      return strided_image_view((this->mRows + rowStep - 1)/rowStep,(this->mCols + colStep - 1)/colStep,
+                                rowStep,colStep,this->mStore,this);
+   }
+
    iterator begin() { return iterator::begin(this); }
    
    iterator end() { return iterator::end(this); }
@@ -783,6 +952,8 @@ public:
    typedef const ImageView<const pixel_type>        const_image_view;
    typedef ElasticImageView<pixel_type>             elastic_image_view;
    typedef ElasticImageView<const pixel_type>       const_elastic_image_view;
+   typedef StridedImageView<pixel_type>             strided_image_view;
+   typedef const StridedImageView<const pixel_type> const_strided_image_view;
    typedef typename image_view::iterator            iterator;
    typedef typename image_view::const_iterator      const_iterator;
 
@@ -828,6 +999,18 @@ public:
       for(;tpos != tend;++tpos,++spos) *tpos = *spos;
    }
 
+   template<typename PixelTT>
+   Image(const StridedImageView<PixelTT>& that) :
+      mStore(that.rows(),that.cols(),0),
+      mDefaultView(that.rows(),that.cols(),&mStore,&mStore,0,0) {
+      iterator tpos = begin();
+      iterator tend = end();
+      typename StridedImageView<PixelTT>::const_iterator spos = that.begin();
+      // The below allows, conversion between two image pixel types.
+      // However, the Pixels must be implicitly convertible.
+      for(;tpos != tend;++tpos,++spos) *tpos = *spos;
+   }
+
    Image& operator=(const Image& that) {
       if(this != &that) {
          // Note: that the ImageStore assignment is what copies all of the data
@@ -936,6 +1119,14 @@ public:
       return elastic_image_view(rows,cols,&mStore,&mStore);
    }
 
+   const_strided_image_view strided_view(unsigned rowStep,unsigned colStep) const {
+      return mDefaultView.strided_view(rowStep,colStep);
+   }
+
+   strided_image_view strided_view(unsigned rowStep,unsigned colStep) {
+      return mDefaultView.strided_view(rowStep,colStep);
+   }
+
    iterator begin() { return mDefaultView.begin(); }
    
    iterator end() { return mDefaultView.end(); }
@@ -948,5 +1139,31 @@ public:
    const void* store() const { return &mStore; }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// RowPixels - one row of an Image or of any of its views, as a pointer to its
+//             first pixel and the distance (in pixels) between its pixels.
+//
+// Pixels within a row are equally spaced for all view types (contiguous for
+// Image and ImageView, colStep apart for StridedImageView), so algorithms
+// that visit whole rows walk them with rowPixels rather than calling pixel()
+// for every column.
+//
+template<typename PixelT>
+struct RowPixels {
+   PixelT*        first;
+   std::ptrdiff_t step;
+
+   PixelT& operator[](unsigned col) const { return first[col*step]; }
+};
+
+template<typename ViewT>
+RowPixels<typename std::remove_reference<decltype(std::declval<ViewT&>().pixel(0u,0u))>::type>
+rowPixels(ViewT& view,unsigned row) {
+   typedef typename std::remove_reference<decltype(view.pixel(row,0u))>::type PixelT;
+   PixelT* first = &view.pixel(row,0u);
+   RowPixels<PixelT> pixels = { first, view.cols() > 1 ? &view.pixel(row,1u) - first : 1 };
+   return pixels;
+}
+
 } // namespace types
 } // namespace batchIP
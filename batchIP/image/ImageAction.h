@@ -32,11 +32,17 @@ enum ActionType {
    SELECT_HSI,
    AFIX_HSI,
    UNIFORM_SMOOTH,
+   GAUSSIAN_SMOOTH,
    EDGE, // TODO: possibly support family of edge algorithms
    QR_DECODE,
    POWER_SPECTUM,
    FILTER_RESP,
-   FILTER
+   FILTER,
+   RANK_FILTER,
+   MORPHOLOGY,
+   HOUGH,
+   COMPONENTS,
+   DISTANCE
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3,6 +3,7 @@
 #include "ImageAction.h"
 #include "RegionOfInterest.h"
 #include "ImageAlgorithm.h"
+#include "ImageAlgorithmExperimental.h"
 #include "ImageAlgorithmOpenCV.h"
 #include "utility/StringParse.h"
 #include "utility/Error.h"
@@ -25,7 +26,7 @@ private:
    enum { NUM_PARAMETERS = 1 };
 
 public:
-   explicit Scale(int amount) : mAmount(amount) {}
+   explicit Scale(float amount) : mAmount(amount) {}
 
    virtual ~Scale() {}
 
@@ -42,12 +43,49 @@ public:
    }
 
    static Scale* make(std::istream& ins) {
-      int amount = utility::parseWord<float>(ins);
+      float amount = utility::parseWord<float>(ins);
       return new Scale<ImageT>(amount);
    }
 };
 
 
+template<typename ImageT>
+class Resample : public Action<ImageT> {
+public:
+   typedef Resample<ImageT> ThisT;
+
+private:
+   float                     mRatio;
+   algorithm::ResampleMethod mMethod;
+
+   enum { NUM_PARAMETERS = 2 };
+
+public:
+   Resample(float ratio,algorithm::ResampleMethod method) : mRatio(ratio), mMethod(method) {}
+
+   virtual ~Resample() {}
+
+   virtual ActionType type() const { return SCALE; }
+
+   virtual unsigned numParameters() const { return NUM_PARAMETERS; }
+
+   virtual void run(const ImageT& src,ImageT& tgt) const {
+      algorithm::resample(src,tgt,mRatio,mMethod);
+   }
+
+   virtual void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const types::ParameterPack& parameters) const {
+      utility::fail("resize function does not support regions");
+   }
+
+   static Resample* make(std::istream& ins) {
+      float ratio = utility::parseWord<float>(ins);
+      unsigned method = utility::parseWord<unsigned>(ins);
+      utility::reportIfNotLessThan("method",method,(unsigned)algorithm::NUM_RESAMPLE_METHODS);
+      return new Resample<ImageT>(ratio,static_cast<algorithm::ResampleMethod>(method));
+   }
+};
+
+
 template<typename ImageT>
 class Crop : public Action<ImageT> {
 public:
@@ -228,6 +266,7 @@ public:
 };                                                                                                                                        \
 /* End of ZERO_ARG_ACTION */
 
+ZERO_ARG_ACTION(HistogramEqualize,histogramEqualize,HISTOGRAM_EQ)
 ZERO_ARG_ACTION(HistogramEqualizeOCV,histogramEqualizeOCV,HISTOGRAM_EQ)
 ZERO_ARG_ACTION(OptimalBinarize,optimalBinarize,BINARIZE)
 ZERO_ARG_ACTION(OtsuBinarize,otsuBinarize,BINARIZE)
@@ -320,13 +359,19 @@ public:
 };                                                                                                                                        \
 /* End of ZERO_ARG_ACTION */
 
-ONE_ARG_ACTION(Intensity,add,INTENSITY,int)
 ONE_ARG_ACTION(ThresholdEqualizeOCV,thresholdEqualizeOCV,BINARIZE,unsigned)
-ONE_ARG_ACTION(Binarize,binarize,BINARIZE,unsigned)
+ONE_ARG_ACTION(HistogramUnify,histogramUnify,HISTOGRAM_EQ,unsigned)
 #ifdef SUPPORT_QRCODE_DETECT
 ONE_ARG_ACTION(QRDecodeOCV,qrDecodeOCV,QR_DECODE,unsigned)
 #endif
 ONE_ARG_ACTION(UniformSmooth,uniformSmooth,UNIFORM_SMOOTH,unsigned)
+ONE_ARG_ACTION(GaussianSmooth,gaussianSmooth,GAUSSIAN_SMOOTH,float)
+ONE_ARG_ACTION(Convolve,convolveKernel,FILTER,std::string)
+ONE_ARG_ACTION(ConnectedComponents,labelComponents,COMPONENTS,unsigned)
+ONE_ARG_ACTION(DistanceTransform,distanceTransform,DISTANCE,float)
+ONE_ARG_ACTION(MedianFilter,medianFilter,RANK_FILTER,unsigned)
+ONE_ARG_ACTION(MinFilter,minFilter,RANK_FILTER,unsigned)
+ONE_ARG_ACTION(MaxFilter,maxFilter,RANK_FILTER,unsigned)
 ONE_ARG_ACTION(LPFilterResponse,lpResponse,FILTER_RESP,double)
 ONE_ARG_ACTION(HPFilterResponse,hpResponse,FILTER_RESP,double)
 ONE_ARG_ACTION(LPFilter,lpFilter,FILTER,double)
@@ -378,13 +423,151 @@ public:
 };                                                                                                                 \
 /* End of Macro HISTACTION */
 
-TWO_ARG_ACTION(HistogramModify,histogramModify,HISTOGRAM_MOD,unsigned,unsigned)
-TWO_ARG_ACTION(HistogramModifyRGB,histogramModifyRGB,HISTOGRAM_MOD,unsigned,unsigned)
 TWO_ARG_ACTION(HistogramModifyIntensity,histogramModifyIntensity,HISTOGRAM_MOD,unsigned,unsigned)
-TWO_ARG_ACTION(BinarizeDT,binarizeDouble,BINARIZE,unsigned,unsigned)
 TWO_ARG_ACTION(AfixAnyHSI,afixAnyHSI,AFIX_HSI,uint8_t,unsigned)
 TWO_ARG_ACTION(BPFilterResponse,bpResponse,FILTER_RESP,double,double)
 TWO_ARG_ACTION(BPFilter,bpFilter,FILTER,double,double)
+TWO_ARG_ACTION(NiblackBinarize,niblackBinarize,BINARIZE,unsigned,double)
+TWO_ARG_ACTION(SauvolaBinarize,sauvolaBinarize,BINARIZE,unsigned,double)
+TWO_ARG_ACTION(BradleyBinarize,bradleyBinarize,BINARIZE,unsigned,double)
+TWO_ARG_ACTION(AdaptiveEqualize,adaptiveEqualize,HISTOGRAM_EQ,unsigned,double)
+TWO_ARG_ACTION(PercentileFilter,percentileFilter,RANK_FILTER,unsigned,double)
+TWO_ARG_ACTION(Erode,erode,MORPHOLOGY,unsigned,unsigned)
+TWO_ARG_ACTION(Dilate,dilate,MORPHOLOGY,unsigned,unsigned)
+TWO_ARG_ACTION(Opening,opening,MORPHOLOGY,unsigned,unsigned)
+TWO_ARG_ACTION(Closing,closing,MORPHOLOGY,unsigned,unsigned)
+TWO_ARG_ACTION(TopHat,topHat,MORPHOLOGY,unsigned,unsigned)
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// LookupTableAction - base of the Actions that are point operations (see
+//                     algorithm::point) on 8- or 16-bit channels. The point
+//                     operation is tabulated once for the default parameters
+//                     and once per distinct ROI ParameterPack, and each table
+//                     is then applied to its regions.
+//
+template<typename ImageT>
+class LookupTableAction : public Action<ImageT> {
+protected:
+   typedef typename ImageT::pixel_type                              PixelT;
+   typedef typename PixelT::value_type                              ValueT;
+   typedef algorithm::LookupTableCache<ValueT,types::ParameterPack> CacheT;
+   typedef typename CacheT::table_type                              TableT;
+
+private:
+   mutable CacheT mTables;
+
+   // Tabulates the point operation with parameters (or the defaults if empty)
+   virtual TableT makeTable(const types::ParameterPack& parameters) const = 0;
+
+   void runPr(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const types::ParameterPack& parameters) const {
+      const TableT& table = mTables.table(parameters,[&]() { return makeTable(parameters); });
+      typename ImageT::image_view tgtview = types::roi2view(tgt,roi);
+      algorithm::applyLookupTable(types::roi2view(src,roi),tgtview,table,algorithm::colorChannelMask<PixelT>());
+   }
+
+public:
+   virtual ~LookupTableAction() {}
+
+   virtual void run(const ImageT& src,ImageT& tgt) const {
+      runPr(src,tgt,view2roi(src.defaultView()),types::ParameterPack());
+   }
+
+   virtual void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const types::ParameterPack& parameters) const {
+      utility::reportIfNotEqual("parameters.size()",this->numParameters(),(unsigned)parameters.size());
+      runPr(src,tgt,roi,parameters);
+   }
+
+   // The table for the default parameters (e.g. to compose chains of point operations)
+   const TableT& table() const {
+      const types::ParameterPack defaults;
+      return mTables.table(defaults,[&]() { return makeTable(defaults); });
+   }
+
+   // Number of distinct tables built so far
+   unsigned tables() const { return mTables.size(); }
+};
+
+
+#define ONE_ARG_LOOKUP_ACTION(NAME,POINT,TYPE,VAL0T)                                                               \
+template<typename ImageT>                                                                                          \
+class NAME : public LookupTableAction<ImageT> {                                                                    \
+public:                                                                                                            \
+   typedef NAME<ImageT> ThisT;                                                                                     \
+private:                                                                                                           \
+   typedef LookupTableAction<ImageT> SuperT;                                                                       \
+   typedef typename SuperT::PixelT PixelT;                                                                         \
+   typedef typename SuperT::TableT TableT;                                                                         \
+                                                                                                                   \
+   VAL0T mVal0;                                                                                                    \
+                                                                                                                   \
+   enum { NUM_PARAMETERS = 1 };                                                                                    \
+                                                                                                                   \
+   virtual TableT makeTable(const types::ParameterPack& parameters) const {                                        \
+      VAL0T val0 = parameters.empty() ? mVal0 : utility::parseWord<VAL0T>(parameters[0]);                          \
+      return TableT(algorithm::point::POINT<PixelT>(val0));                                                        \
+   }                                                                                                               \
+                                                                                                                   \
+public:                                                                                                            \
+   explicit NAME(VAL0T val0) : mVal0(val0) {}                                                                      \
+                                                                                                                   \
+   virtual ~NAME() {}                                                                                              \
+                                                                                                                   \
+   virtual ActionType type() const { return TYPE; }                                                                \
+                                                                                                                   \
+   virtual unsigned numParameters() const { return NUM_PARAMETERS; }                                               \
+                                                                                                                   \
+   static NAME* make(std::istream& ins) {                                                                          \
+      VAL0T val0 = utility::parseWord<VAL0T>(ins);                                                                 \
+      return new NAME<ImageT>(val0);                                                                               \
+   }                                                                                                               \
+};                                                                                                                 \
+/* End of ONE_ARG_LOOKUP_ACTION */
+
+#define TWO_ARG_LOOKUP_ACTION(NAME,POINT,TYPE,VAL0T,VAL1T)                                                         \
+template<typename ImageT>                                                                                          \
+class NAME : public LookupTableAction<ImageT> {                                                                    \
+public:                                                                                                            \
+   typedef NAME<ImageT> ThisT;                                                                                     \
+private:                                                                                                           \
+   typedef LookupTableAction<ImageT> SuperT;                                                                       \
+   typedef typename SuperT::PixelT PixelT;                                                                         \
+   typedef typename SuperT::TableT TableT;                                                                         \
+                                                                                                                   \
+   VAL0T mVal0;                                                                                                    \
+   VAL1T mVal1;                                                                                                    \
+                                                                                                                   \
+   enum { NUM_PARAMETERS = 2 };                                                                                    \
+                                                                                                                   \
+   virtual TableT makeTable(const types::ParameterPack& parameters) const {                                        \
+      VAL0T val0 = parameters.empty() ? mVal0 : utility::parseWord<VAL0T>(parameters[0]);                          \
+      VAL1T val1 = parameters.empty() ? mVal1 : utility::parseWord<VAL1T>(parameters[1]);                          \
+      return TableT(algorithm::point::POINT<PixelT>(val0,val1));                                                   \
+   }                                                                                                               \
+                                                                                                                   \
+public:                                                                                                            \
+   explicit NAME(VAL0T val0,VAL1T val1) : mVal0(val0), mVal1(val1) {}                                              \
+                                                                                                                   \
+   virtual ~NAME() {}                                                                                              \
+                                                                                                                   \
+   virtual ActionType type() const { return TYPE; }                                                                \
+                                                                                                                   \
+   virtual unsigned numParameters() const { return NUM_PARAMETERS; }                                               \
+                                                                                                                   \
+   static NAME* make(std::istream& ins) {                                                                          \
+      VAL0T val0 = utility::parseWord<VAL0T>(ins);                                                                 \
+      VAL1T val1 = utility::parseWord<VAL1T>(ins);                                                                 \
+      return new NAME<ImageT>(val0,val1);                                                                          \
+   }                                                                                                               \
+};                                                                                                                 \
+/* End of TWO_ARG_LOOKUP_ACTION */
+
+ONE_ARG_LOOKUP_ACTION(Intensity,Add,INTENSITY,int)
+ONE_ARG_LOOKUP_ACTION(Binarize,Threshold,BINARIZE,unsigned)
+TWO_ARG_LOOKUP_ACTION(BinarizeDT,DoubleThreshold,BINARIZE,unsigned,unsigned)
+TWO_ARG_LOOKUP_ACTION(HistogramModify,HistogramStretch,HISTOGRAM_MOD,unsigned,unsigned)
+TWO_ARG_LOOKUP_ACTION(HistogramModifyRGB,LinearStretch,HISTOGRAM_MOD,unsigned,unsigned)
 
 
 
@@ -490,6 +673,8 @@ public:
 TWO_ARG_GRAY_OUT_ACTION(EdgeGradientClipped,edgeGradientClipped,EDGE,unsigned,double)
 //TWO_ARG_GRAY_OUT_ACTION(EdgeGradient,edgeGradient,EDGE,unsigned,unsigned)
 //TWO_ARG_GRAY_OUT_ACTION(EdgeDetect,edgeDetect,EDGE,unsigned,unsigned)
+TWO_ARG_GRAY_OUT_ACTION(EdgeGradientSmoothed,edgeGradient,EDGE,unsigned,float)
+TWO_ARG_GRAY_OUT_ACTION(EdgeDetectSmoothed,edgeDetect,EDGE,unsigned,float)
 
 
 template<typename ImageT>
@@ -661,6 +846,78 @@ public:
 };
 
 
+// Binarizes by several reference colors in one pass (white if within the
+// threshold of any). The parameters are the number of references followed by
+// the threshold, red, green and blue of each, for the image and each ROI.
+template<typename ImageT>
+class BinarizeColors : public Action<ImageT> {
+public:
+   typedef Action<ImageT> SuperT;
+   typedef BinarizeColors<ImageT> ThisT;
+   typedef typename ImageT::pixel_type pixel_type;
+   typedef algorithm::ColorReference<pixel_type> ReferenceT;
+
+private:
+   std::vector<ReferenceT> mReferences;
+
+   void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const std::vector<ReferenceT>& references) const {
+      typename ImageT::image_view tgtview = types::roi2view(tgt,roi);
+      algorithm::binarizeColor(types::roi2view(src,roi),tgtview,references);
+   }
+
+   enum { PARAMETERS_PER_REFERENCE = 4 };
+
+   template<typename SourceT>
+   static ReferenceT parseReference(SourceT threshold,SourceT red,SourceT green,SourceT blue) {
+      pixel_type referenceColor;
+      referenceColor.namedColor.red = utility::parseWord<unsigned>(red);
+      referenceColor.namedColor.green = utility::parseWord<unsigned>(green);
+      referenceColor.namedColor.blue = utility::parseWord<unsigned>(blue);
+      return ReferenceT(utility::parseWord<float>(threshold),referenceColor);
+   }
+
+public:
+   BinarizeColors(const std::vector<ReferenceT>& references) : mReferences(references) {}
+
+   virtual ~BinarizeColors() {}
+
+   virtual ActionType type() const { return BINARIZE; }
+
+   virtual unsigned numParameters() const { return 1u + PARAMETERS_PER_REFERENCE*(unsigned)mReferences.size(); }
+
+   virtual void run(const ImageT& src,ImageT& tgt) const {
+      run(src,tgt,view2roi(src.defaultView()),mReferences);
+   }
+
+   virtual void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const types::ParameterPack& parameters) const {
+      utility::reportIfNotEqual("parameters.size()",numParameters(),(unsigned)parameters.size());
+      unsigned count = utility::parseWord<unsigned>(parameters[0]);
+      utility::reportIfNotEqual("number of references",(unsigned)mReferences.size(),count);
+      std::vector<ReferenceT> references;
+      for(unsigned k = 0;k < count;++k) {
+         const unsigned first = 1u + PARAMETERS_PER_REFERENCE*k;
+         references.push_back(parseReference(parameters[first],parameters[first+1],parameters[first+2],parameters[first+3]));
+      }
+      run(src,tgt,roi,references);
+   }
+
+   static BinarizeColors* make(std::istream& ins) {
+      unsigned count = utility::parseWord<unsigned>(ins);
+      utility::reportIfEqual("number of references",count,0u);
+      std::vector<ReferenceT> references;
+      for(unsigned k = 0;k < count;++k) {
+         // Note: arguments must be parsed in order
+         std::string threshold = utility::parseWord<std::string>(ins);
+         std::string red = utility::parseWord<std::string>(ins);
+         std::string green = utility::parseWord<std::string>(ins);
+         std::string blue = utility::parseWord<std::string>(ins);
+         references.push_back(parseReference(threshold,red,green,blue));
+      }
+      return new BinarizeColors<ImageT>(references);
+   }
+};
+
+
 #define ORIENTED_EDGE_ACTION(NAME,ALGO)                                                                                                               \
 template<typename ImageSrc,typename ImageTgt = types::Image<types::GrayAlphaPixel<typename ImageSrc::pixel_type::value_type> > >                      \
 class NAME : public Action<ImageSrc,ImageTgt> {                                                                                                       \
@@ -822,6 +1079,65 @@ public:
 
 FOUR_ARG_ACTION(Filter,filter,FILTER,double,double,double,double)
 FOUR_ARG_ACTION(FilterResponse,filterResponse,FILTER,double,double,double,double)
+FOUR_ARG_ACTION(HoughLines,detectHoughLines,HOUGH,unsigned,float,unsigned,unsigned)
+
+#define FIVE_ARG_ACTION(NAME,CALL,TYPE,VAL0T,VAL1T,VAL2T,VAL3T,VAL4T)                                                                                        \
+template<typename ImageT>                                                                                                                                    \
+class NAME : public Action<ImageT> {                                                                                                                         \
+public:                                                                                                                                                      \
+   typedef Action<ImageT> SuperT;                                                                                                                            \
+   typedef NAME<ImageT> ThisT;                                                                                                                               \
+   typedef typename ImageT::pixel_type pixel_type;                                                                                                           \
+                                                                                                                                                             \
+private:                                                                                                                                                     \
+   VAL0T mP0;                                                                                                                                                \
+   VAL1T mP1;                                                                                                                                                \
+   VAL2T mP2;                                                                                                                                                \
+   VAL3T mP3;                                                                                                                                                \
+   VAL4T mP4;                                                                                                                                                \
+                                                                                                                                                             \
+   void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,VAL0T p0,VAL1T p1,VAL2T p2,VAL3T p3,VAL4T p4) const {                           \
+      typename ImageT::image_view tgtview = types::roi2view(tgt,roi);                                                                                        \
+      algorithm::CALL(types::roi2view(src,roi),tgtview,p0,p1,p2,p3,p4);                                                                                      \
+   }                                                                                                                                                         \
+                                                                                                                                                             \
+   enum { NUM_PARAMETERS = 5 };                                                                                                                              \
+                                                                                                                                                             \
+public:                                                                                                                                                      \
+   NAME(VAL0T p0,VAL1T p1,VAL2T p2,VAL3T p3,VAL4T p4) : mP0(p0),mP1(p1),mP2(p2),mP3(p3),mP4(p4) {}                                                           \
+                                                                                                                                                             \
+   virtual ~NAME() {}                                                                                                                                        \
+                                                                                                                                                             \
+   virtual ActionType type() const { return TYPE; }                                                                                                          \
+                                                                                                                                                             \
+   virtual unsigned numParameters() const { return NUM_PARAMETERS; }                                                                                         \
+                                                                                                                                                             \
+   virtual void run(const ImageT& src,ImageT& tgt) const {                                                                                                   \
+      run(src,tgt,view2roi(src.defaultView()),mP0,mP1,mP2,mP3,mP4);                                                                                          \
+   }                                                                                                                                                         \
+                                                                                                                                                             \
+   virtual void run(const ImageT& src,ImageT& tgt,const types::RegionOfInterest& roi,const types::ParameterPack& parameters) const {                         \
+      utility::reportIfNotEqual("parameters.size()",(unsigned)NUM_PARAMETERS,(unsigned)parameters.size());                                                   \
+      VAL0T p0 = utility::parseWord<VAL0T>(parameters[0]);                                                                                                   \
+      VAL1T p1 = utility::parseWord<VAL1T>(parameters[1]);                                                                                                   \
+      VAL2T p2 = utility::parseWord<VAL2T>(parameters[2]);                                                                                                   \
+      VAL3T p3 = utility::parseWord<VAL3T>(parameters[3]);                                                                                                   \
+      VAL4T p4 = utility::parseWord<VAL4T>(parameters[4]);                                                                                                   \
+      run(src,tgt,roi,p0,p1,p2,p3,p4);                                                                                                                       \
+   }                                                                                                                                                         \
+                                                                                                                                                             \
+   static NAME* make(std::istream& ins) {                                                                                                                    \
+      VAL0T p0 = utility::parseWord<VAL0T>(ins);                                                                                                             \
+      VAL1T p1 = utility::parseWord<VAL1T>(ins);                                                                                                             \
+      VAL2T p2 = utility::parseWord<VAL2T>(ins);                                                                                                             \
+      VAL3T p3 = utility::parseWord<VAL3T>(ins);                                                                                                             \
+      VAL4T p4 = utility::parseWord<VAL4T>(ins);                                                                                                             \
+      return new NAME<ImageT>(p0,p1,p2,p3,p4);                                                                                                               \
+   }                                                                                                                                                         \
+};                                                                                                                                                           \
+/* FIVE_ARG_ACTION */
+
+FIVE_ARG_ACTION(HoughCircles,detectHoughCircles,HOUGH,unsigned,unsigned,unsigned,unsigned,unsigned)
 
 } // namespace operation
 } // namespace batchIP
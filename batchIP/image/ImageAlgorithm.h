@@ -1,11 +1,26 @@
 #pragma once
 
+#include "AdaptiveEqualize.h"
+#include "AdaptiveThreshold.h"
+#include "ColorConversion.h"
+#include "ConnectedComponents.h"
+#include "DistanceTransform.h"
+#include "GaussianSmooth.h"
+#include "Histogram.h"
+#include "Hough.h"
 #include "Image.h"
+#include "IntegralImage.h"
+#include "LookupTable.h"
+#include "Morphology.h"
 #include "Pixel.h"
+#include "ImageAlgorithmSIMD.h"
+#include "RankFilter.h"
+#include "Resample.h"
 #include "utility/Error.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <algorithm>
 
@@ -22,6 +37,91 @@ inline ValueT checkValue(ValueT value)
    return value;
 }
 
+template<typename SrcPixelT,typename TgtPixelT,typename Bounds,typename Constraints>
+inline void linearlyStretch(const SrcPixelT& src,TgtPixelT& tgt,double rescale,Bounds min, Bounds max,Constraints low,Constraints high) {
+   if(src <= low) tgt = min;
+   else if(src <= high) tgt = std::min(max,static_cast<Bounds>(rescale * (src - low)));
+   else tgt = max;
+}
+
+namespace point {
+
+///////////////////////////////////////////////////////////////////////////////
+// Point operations - mappings of a single channel value of PixelT, which
+// may be tabulated into a LookupTable or applied with pointOperation.
+//
+
+template<typename PixelT>
+struct Add {
+   typedef typename PixelT::value_type value_type;
+   int mValue;
+   explicit Add(int value) : mValue(value) {}
+   value_type operator()(value_type value) const {
+      return static_cast<value_type>(checkValue<PixelT>(static_cast<int>(value) + mValue));
+   }
+};
+
+template<typename PixelT>
+struct Threshold {
+   typedef typename PixelT::value_type value_type;
+   unsigned mThreshold;
+   explicit Threshold(unsigned threshold) : mThreshold(threshold) {}
+   value_type operator()(value_type value) const {
+      return value < mThreshold ? PixelT::traits::min() : PixelT::traits::max();
+   }
+};
+
+// Selects (max) values in [low,high)
+template<typename PixelT>
+struct DoubleThreshold {
+   typedef typename PixelT::value_type value_type;
+   unsigned mLow;
+   unsigned mHigh;
+   DoubleThreshold(unsigned low,unsigned high) : mLow(low), mHigh(high) {}
+   value_type operator()(value_type value) const {
+      return value < mLow || value >= mHigh ? PixelT::traits::min() : PixelT::traits::max();
+   }
+};
+
+// Stretches [low,high] to [min,max] (as histogramModify)
+template<typename PixelT,typename Value = unsigned>
+struct HistogramStretch {
+   typedef typename PixelT::value_type value_type;
+   Value mLow;
+   Value mHigh;
+   float mRescale;
+   HistogramStretch(Value low,Value high) :
+      mLow(low), mHigh(high), mRescale((float) PixelT::traits::max()/(high - low)) {
+      utility::reportIfNotLessThan("low<high",low,high);
+   }
+   value_type operator()(value_type value) const {
+      if(value <= mLow) return PixelT::traits::min();
+      else if(value <= mHigh) return static_cast<value_type>(mRescale * (value - mLow));
+      else return PixelT::traits::max();
+   }
+};
+
+// Stretches [low,high] to [min,max] (as linearlyStretch)
+template<typename PixelT,typename Value = unsigned>
+struct LinearStretch {
+   typedef typename PixelT::value_type value_type;
+   Value mLow;
+   Value mHigh;
+   double mRescale;
+   LinearStretch(Value low,Value high) :
+      mLow(low), mHigh(high),
+      mRescale(((double) PixelT::traits::max() - (double) PixelT::traits::min()) / (high - low)) {
+      utility::reportIfNotLessThan("low<high",low,high);
+   }
+   value_type operator()(value_type value) const {
+      value_type stretched;
+      linearlyStretch(value,stretched,mRescale,PixelT::traits::min(),PixelT::traits::max(),mLow,mHigh);
+      return stretched;
+   }
+};
+
+} // namespace point
+
 /*-----------------------------------------------------------------------**/
 
 template<typename SrcImageT,typename TgtImageT,typename Value>
@@ -34,17 +134,8 @@ void add(const SrcImageT& src, TgtImageT& tgt, Value value,
          typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
    // TODO: SFINAE selection of integral, versus floating point types, or need way to select
    // signed value type that is larger than native type(if possible)
- 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   for(;spos != send;++spos,++tpos) {
-      *tpos = *spos;
-      int gray = static_cast<int>(tpos->namedColor.gray);
-      gray += value;
-      tpos->namedColor.gray = checkValue<typename TgtImageT::pixel_type>(gray);
-   }
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::Add<PixelT>(value),colorChannelMask<PixelT>());
 }
 
 
@@ -54,16 +145,16 @@ typedef std::vector<double> HistogramT;
 template<typename SrcImageT>
 HistogramT computeHistogram(const SrcImageT& src,unsigned cols,unsigned channel,double& maxColumnHeight) {
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
+   typedef ChannelHistogram<typename SrcImageT::pixel_type> ChannelHistogramT;
+   ChannelHistogramT counts(src,channel);
 
-   // Compute Histogram
+   // Fold the bins into cols columns (e.g. a 16-bit histogram drawn 256 columns wide)
    HistogramT histogram(cols,0u);
-   maxColumnHeight = 0;
-   for(;spos != send;++spos) {
-      ++histogram[spos->indexedColor[channel]];
-      if(histogram[spos->indexedColor[channel]] > maxColumnHeight) ++maxColumnHeight;
+   const typename ChannelHistogramT::count_type* bins = counts.counts(channel);
+   for(unsigned b = 0;b < counts.bins();++b) {
+      histogram[static_cast<unsigned>(static_cast<uint64_t>(b)*cols/counts.bins())] += static_cast<double>(bins[b]);
    }
+   maxColumnHeight = *std::max_element(histogram.begin(),histogram.end());
    return histogram;
 }
 
@@ -183,6 +274,70 @@ void histogram(const SrcImageT& src, TgtImageT& tgt,unsigned logBase,unsigned ch
 
 
 // Note: with this algorithm, we can stretch each HSI channel separately
+/*-----------------------------------------------------------------------**/
+// The histogram equalization of each of the bins values counted in histogram
+// (scaled to [0,maxValue]), or an empty mapping if nothing was counted.
+template<typename CountT>
+std::vector<double> equalizationMapping(const CountT* histogram,unsigned bins,CountT total,double maxValue) {
+   // Build the value mapping from the cumulative histogram
+   std::vector<double> mapping;
+   unsigned first = 0;
+   while(first < bins && 0 == histogram[first]) ++first;
+   if(first == bins) return mapping; // empty image
+   mapping.assign(bins,0.0);
+   CountT remaining = total - histogram[first];
+   if(0 == remaining) {
+      std::fill(mapping.begin(),mapping.end(),static_cast<double>(first));
+   }
+   else {
+      double scale = maxValue/remaining;
+      CountT cumulative = 0;
+      for(unsigned b = first + 1;b < bins;++b) {
+         cumulative += histogram[b];
+         mapping[b] = std::min(maxValue,std::floor(cumulative*scale + 0.5));
+      }
+   }
+   return mapping;
+}
+
+/*-----------------------------------------------------------------------**/
+// Histogram equalization, mapping each value through the normalized cumulative
+// histogram (the lowest occupied value maps to min and the highest to max, as
+// with OpenCV's equalizeHist).
+template<typename SrcImageT,typename TgtImageT>
+void histogramEqualize(const SrcImageT& src, TgtImageT& tgt,
+         // This ugly bit is an unnamed argument with a default which means it neither           
+         // contributes to the mangled declaration name nor requires an argument. So what is the 
+         // point? It still participates in SFINAE to help select that this is an appropriate    
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+         // deduction so can't be applied to in parameter directly.                              
+         typename std::enable_if<(types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                  types::is_monochrome<typename SrcImageT::pixel_type>::value) &&
+                                 std::is_integral<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   typedef typename SrcImageT::pixel_type                   PixelT;
+   typedef typename TgtImageT::pixel_type::value_type       ValueT;
+   typedef ChannelHistogram<PixelT>                         ChannelHistogramT;
+   typedef typename ChannelHistogramT::count_type           CountT;
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   ChannelHistogramT counts(src,PixelT::GRAY_CHANNEL);
+   const CountT* histogram = counts.counts(PixelT::GRAY_CHANNEL);
+   const unsigned bins = counts.bins();
+   const double maxValue = TgtImageT::pixel_type::traits::max();
+
+   const std::vector<double> equalized = equalizationMapping(histogram,bins,counts.total(),maxValue);
+   if(equalized.empty()) return; // empty image
+   std::vector<ValueT> mapping(equalized.begin(),equalized.end());
+
+   typename SrcImageT::const_iterator spos(src.begin());
+   typename SrcImageT::const_iterator send(src.end());
+   typename TgtImageT::iterator       tpos(tgt.begin());
+   for(;spos != send;++spos,++tpos) tpos->tuple.value0 = mapping[spos->tuple.value0];
+}
+
 template<typename SrcImageT,typename TgtImageT,typename Value>
 void afixAnyHSI(const SrcImageT& src, TgtImageT& tgt,
          Value value,unsigned channel,
@@ -195,28 +350,19 @@ void afixAnyHSI(const SrcImageT& src, TgtImageT& tgt,
 
    utility::reportIfNotLessThan("value<max",value,SrcImageT::pixel_type::traits::max());
 
+   utility::reportIfNotLessThan("channels",channel,(unsigned)types::HSIPixel<float>::MAX_CHANNELS);
+
    // Algorithm
    // Idea here is simple. 
-   // 1) Convert image from RGBA to HSI
+   // 1) Convert (a block of) the image from RGBA to HSI
    // 2) assigned afixed value to appropriate channel
    // 3) convert HSI back into RGBA
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
-
-   utility::reportIfNotLessThan("channels",channel,(unsigned)HSIImage::pixel_type::MAX_CHANNELS);
+   const float normVal = (float)value/SrcImageT::pixel_type::traits::max();
 
-   HSIImage hsiImage(src);
-
-   double normVal = (double)value/SrcImageT::pixel_type::traits::max();
-
-   typename HSIImage::iterator spos(hsiImage.begin());
-   typename HSIImage::iterator send(hsiImage.end());
-
-   for(;spos != send;++spos) {
-      spos->indexedColor[channel] = normVal;
-   }
-
-   tgt = hsiImage.defaultView();
+   transformHSI(src,tgt,[&](unsigned,unsigned,float* hue,float* saturation,float* intensity,unsigned count) {
+      float* planes[] = { hue, saturation, intensity };
+      std::fill(planes[channel],planes[channel] + count,normVal);
+   });
 }
 
 
@@ -231,26 +377,8 @@ void histogramModify(const SrcImageT& src, TgtImageT& tgt,Value low,Value high,
 
    utility::reportIfNotLessThan("cols!=max",low,high);
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   float rescale = (float) TgtImageT::pixel_type::traits::max()/(high - low);
-
-   for(;spos != send;++spos,++tpos) {
-      if(spos->namedColor.gray <= low) tpos->namedColor.gray = TgtImageT::pixel_type::traits::min();
-      else if(spos->namedColor.gray <= high)
-         tpos->namedColor.gray = static_cast<typename TgtImageT::pixel_type::value_type>(rescale * (spos->namedColor.gray - low));
-      else tpos->namedColor.gray = TgtImageT::pixel_type::traits::max();
-   }
-}
-
-
-template<typename SrcPixelT,typename TgtPixelT,typename Bounds,typename Constraints>
-inline void linearlyStretch(const SrcPixelT& src,TgtPixelT& tgt,double rescale,Bounds min, Bounds max,Constraints low,Constraints high) {
-   if(src <= low) tgt = min;
-   else if(src <= high) tgt = std::min(max,static_cast<Bounds>(rescale * (src - low)));
-   else tgt = max;
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::HistogramStretch<PixelT,Value>(low,high),colorChannelMask<PixelT>());
 }
 
 
@@ -265,22 +393,8 @@ void histogramModifyRGB(const SrcImageT& src, TgtImageT& tgt,Value low,Value hig
 
    utility::reportIfNotLessThan("low<high",low,high);
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   double rescale = ((double) TgtImageT::pixel_type::traits::max() - 
-                     (double) TgtImageT::pixel_type::traits::min()) /
-                              (high - low);
-
-   typename TgtImageT::pixel_type::value_type min = TgtImageT::pixel_type::traits::min();
-   typename TgtImageT::pixel_type::value_type max = TgtImageT::pixel_type::traits::max();
-
-   for(;spos != send;++spos,++tpos) {
-      linearlyStretch(spos->namedColor.red,tpos->namedColor.red,rescale,min,max,low,high);
-      linearlyStretch(spos->namedColor.green,tpos->namedColor.green,rescale,min,max,low,high);
-      linearlyStretch(spos->namedColor.blue,tpos->namedColor.blue,rescale,min,max,low,high);
-   }
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::LinearStretch<PixelT,Value>(low,high),colorChannelMask<PixelT>());
 }
 
 
@@ -296,20 +410,8 @@ void histogramModifyAnyRGB(const SrcImageT& src, TgtImageT& tgt,Value low,Value
    utility::reportIfNotLessThan("channels",channel,(unsigned)SrcImageT::pixel_type::MAX_CHANNELS);
    utility::reportIfNotLessThan("low<high",low,high);
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   double rescale = ((double) TgtImageT::pixel_type::traits::max() - 
-                     (double) TgtImageT::pixel_type::traits::min()) /
-                              (high - low);
-
-   typename TgtImageT::pixel_type::value_type min = TgtImageT::pixel_type::traits::min();
-   typename TgtImageT::pixel_type::value_type max = TgtImageT::pixel_type::traits::max();
-
-   for(;spos != send;++spos,++tpos) {
-      linearlyStretch(spos->indexedColor[channel],tpos->indexedColor[channel],rescale,min,max,low,high);
-   }
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::LinearStretch<PixelT,Value>(low,high),1u << channel);
 }
 
 
@@ -340,6 +442,27 @@ void linearlyStretchChannel(HSIImage& hsiImage,Bounds minBounds,Bounds maxBounds
 }
 
 
+// The same stretch as linearlyStretchChannel, of a (block) plane of
+// normalized HSI channel values (see transformHSI).
+class PlaneStretch {
+   double mRescale;
+   double mLowNorm;
+   double mHighNorm;
+
+public:
+   template<typename Bounds,typename Constraints>
+   PlaneStretch(Bounds minBounds,Bounds maxBounds,Constraints low,Constraints high) :
+      mRescale(((double)maxBounds - (double)minBounds) / (high - low)),
+      mLowNorm((double)low/maxBounds),
+      mHighNorm((double)high/maxBounds)
+   {}
+
+   void operator()(float* plane,unsigned count) const {
+      for(unsigned k = 0;k < count;++k) linearlyStretch(plane[k],plane[k],mRescale,0.0f,1.0f,mLowNorm,mHighNorm);
+   }
+};
+
+
 template<typename SrcImageT,typename TgtImageT,typename Value>
 void histogramModifyIntensity(const SrcImageT& src, TgtImageT& tgt,Value low,Value high,
          // This ugly bit is an unnamed argument with a default which means it neither           
@@ -353,20 +476,16 @@ void histogramModifyIntensity(const SrcImageT& src, TgtImageT& tgt,Value low,Val
 
    // Algorithm
    // Idea here is simple. 
-   // 1) Convert image from RGBA to HSI
+   // 1) Convert (a block of) the image from RGBA to HSI
    // 2) histogram stretch just the intensity channel
    // 3) convert HSI back into RGBA
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
+   const PlaneStretch stretch(SrcImageT::pixel_type::traits::min(),
+                              SrcImageT::pixel_type::traits::max(),
+                              low,high);
 
-   HSIImage hsiImage(src);
-
-   linearlyStretchChannel(hsiImage,
-                          SrcImageT::pixel_type::traits::min(),
-                          SrcImageT::pixel_type::traits::max(),
-                          low,high,HSIPixelT::INTENSITY_CHANNEL);
-
-   tgt = hsiImage.defaultView();
+   transformHSI(src,tgt,[&](unsigned,unsigned,float*,float*,float* intensity,unsigned count) {
+      stretch(intensity,count);
+   });
 }
 
 
@@ -387,28 +506,58 @@ void histogramModifyHSI(const SrcImageT& src, TgtImageT& tgt,
 
    // Algorithm
    // Idea here is simple. 
-   // 1) Convert image from RGBA to HSI
+   // 1) Convert (a block of) the image from RGBA to HSI
    // 2) histogram stretch just the intensity,saturation and hue channels
    // 3) convert HSI back into RGBA
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
-
-   HSIImage hsiImage(src);
-
-   linearlyStretchChannel(hsiImage,
-                          SrcImageT::pixel_type::traits::min(),
-                          SrcImageT::pixel_type::traits::max(),
-                          lowI,highI,HSIPixelT::INTENSITY_CHANNEL);
-   linearlyStretchChannel(hsiImage,
-                          SrcImageT::pixel_type::traits::min(),
-                          SrcImageT::pixel_type::traits::max(),
-                          lowS,highS,HSIPixelT::SATURATION_CHANNEL);
-   linearlyStretchChannel(hsiImage,
-                          SrcImageT::pixel_type::traits::min(),
-                          SrcImageT::pixel_type::traits::max(),
-                          lowH,highH,HSIPixelT::HUE_CHANNEL);
-
-   tgt = hsiImage.defaultView();
+   const PlaneStretch stretchI(SrcImageT::pixel_type::traits::min(),SrcImageT::pixel_type::traits::max(),lowI,highI);
+   const PlaneStretch stretchS(SrcImageT::pixel_type::traits::min(),SrcImageT::pixel_type::traits::max(),lowS,highS);
+   const PlaneStretch stretchH(SrcImageT::pixel_type::traits::min(),SrcImageT::pixel_type::traits::max(),lowH,highH);
+
+   transformHSI(src,tgt,[&](unsigned,unsigned,float* hue,float* saturation,float* intensity,unsigned count) {
+      stretchI(intensity,count);
+      stretchS(saturation,count);
+      stretchH(hue,count);
+   });
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Histogram equalization of the intensity of a color image (hue and
+// saturation are preserved). This needs the histogram of the whole image, so
+// takes two passes: the first streams just the intensity channel (quantized
+// to the source channel's levels) to count it, and the second streams the
+// image through HSI, mapping intensity as histogramEqualize maps gray.
+template<typename SrcImageT,typename TgtImageT>
+void histogramEqualize(const SrcImageT& src, TgtImageT& tgt,
+         // This ugly bit is an unnamed argument with a default which means it neither           
+         // contributes to the mangled declaration name nor requires an argument. So what is the 
+         // point? It still participates in SFINAE to help select that this is an appropriate    
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+         // deduction so can't be applied to in parameter directly.                              
+         typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value &&
+                                 std::is_integral<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type SrcPixelT;
+   typedef types::MonochromePixel<typename SrcPixelT::value_type>           MonoPixelT;
+   typedef ChannelHistogram<MonoPixelT>                                     ChannelHistogramT;
+
+   // Pass 1: the histogram of intensity (streamed into 1 channel per pixel)
+   types::Image<MonoPixelT> intensities(src.rows(),src.cols());
+   selectHSIChannel(src,intensities,(unsigned)types::HSIPixel<float>::INTENSITY_CHANNEL);
+   const ChannelHistogramT counts(intensities,0u);
+   const double max = SrcPixelT::traits::max();
+   const std::vector<double> equalized = equalizationMapping(counts.counts(0u),counts.bins(),counts.total(),max);
+   if(equalized.empty()) return; // empty image
+   std::vector<float> normalized(equalized.size());
+   for(unsigned v = 0;v < equalized.size();++v) normalized[v] = static_cast<float>(equalized[v]/max);
+
+   // Pass 2: stream the image through HSI, replacing intensity
+   transformHSI(src,tgt,[&](unsigned,unsigned,float*,float*,float* intensity,unsigned count) {
+      for(unsigned k = 0;k < count;++k) {
+         unsigned level = static_cast<unsigned>(std::round(std::max(0.0f,std::min(1.0f,intensity[k]))*max));
+         intensity[k] = normalized[level];
+      }
+   });
 }
 
 
@@ -421,26 +570,9 @@ void add(const SrcImageT& src, TgtImageT& tgt, int value,
          // matching function given its arguments. Note, SFINAE techniques are incompatible with 
          // deduction so can't be applied to in parameter directly.                              
          typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
- 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
 
-   for(;spos != send;++spos,++tpos) {
-      *tpos = *spos;
-      // Update Red
-      int signedColor = tpos->namedColor.red;
-      signedColor += value;
-      tpos->namedColor.red = checkValue<typename TgtImageT::pixel_type>(signedColor);
-      // Update Blue
-      signedColor = tpos->namedColor.blue;
-      signedColor += value;
-      tpos->namedColor.blue = checkValue<typename TgtImageT::pixel_type>(signedColor);
-      // Update Green
-      signedColor = tpos->namedColor.green;
-      signedColor += value;
-      tpos->namedColor.green = checkValue<typename TgtImageT::pixel_type>(signedColor);
-   }
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::Add<PixelT>(value),colorChannelMask<PixelT>());
 }
 
 
@@ -454,27 +586,83 @@ void binarize(const SrcImageT& src, TgtImageT& tgt, unsigned threshold,
               // deduction so can't be applied to in parameter directly.                              
               typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::Threshold<PixelT>(threshold),colorChannelMask<PixelT>());
+}
 
-   for(;spos != send;++spos,++tpos) {
-      if(spos->namedColor.gray < threshold) tpos->namedColor.gray = TgtImageT::pixel_type::traits::min();
-      else                                  tpos->namedColor.gray = TgtImageT::pixel_type::traits::max();
+/*-----------------------------------------------------------------------**/
+// Isodata (iterative intermeans) threshold solved on a histogram: starting from
+// the mean, the threshold moves to the midpoint between the means of the values
+// below it and the values at or above it, until it moves by no more than
+// tolerance. Cumulative count and moment tables are built once (O(bins)), so
+// each iteration is O(1).
+template<typename CountT>
+unsigned isodataThreshold(const CountT* histogram,unsigned bins,unsigned tolerance) {
+
+   // cumulativeCount[t] and cumulativeMoment[t] cover the values [0,t)
+   std::vector<uint64_t> cumulativeCount(bins+1,0u);
+   std::vector<uint64_t> cumulativeMoment(bins+1,0u);
+   for(unsigned v = 0;v < bins;++v) {
+      cumulativeCount[v+1] = cumulativeCount[v] + histogram[v];
+      cumulativeMoment[v+1] = cumulativeMoment[v] + static_cast<uint64_t>(histogram[v])*v;
+   }
+   const uint64_t total = cumulativeCount[bins];
+   const uint64_t moment = cumulativeMoment[bins];
+   if(0 == total) return 0;
 
+   unsigned threshold = static_cast<unsigned>((double)moment/total);
+   unsigned thresholdLast = 0;
+   // Note a ternary expression is used to ensure unsigned math is performed correctly.
+   // The iteration limit only guards against the (pathological) case of oscillation.
+   for(unsigned iteration = 0;
+       iteration < bins && (thresholdLast > threshold ? thresholdLast - threshold : threshold - thresholdLast) > tolerance;
+       ++iteration) {
+      thresholdLast = threshold;
+      const uint64_t numberBG = cumulativeCount[threshold];
+      const uint64_t numberFG = total - numberBG;
+      // A threshold with an empty class can't move any further
+      if(0 == numberBG || 0 == numberFG) break;
+      const double meanBG = (double)cumulativeMoment[threshold]/numberBG;
+      const double meanFG = (double)(moment - cumulativeMoment[threshold])/numberFG;
+      threshold = static_cast<unsigned>((meanFG + meanBG)/2);
    }
+   return threshold;
 }
 
 /*-----------------------------------------------------------------------**/
-template<typename SrcImageT,typename TgtImageT>
-void optimalBinarize(const SrcImageT& src, TgtImageT& tgt,
+// For 8- and 16-bit images the threshold is solved on the histogram, so the
+// image (or ROI view) is only read once.
+template<typename SrcImageT>
+typename SrcImageT::pixel_type::value_type optimalThreshold(const SrcImageT& src,
               // This ugly bit is an unnamed argument with a default which means it neither           
               // contributes to the mangled declaration name nor requires an argument. So what is the 
               // point? It still participates in SFINAE to help select that this is an appropriate    
               // matching function given its arguments. Note, SFINAE techniques are incompatible with 
               // deduction so can't be applied to in parameter directly.                              
-              typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
-                                      types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+              typename std::enable_if<(types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                       types::is_monochrome<typename SrcImageT::pixel_type>::value) &&
+                                      std::is_integral<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   typedef typename SrcImageT::pixel_type PixelT;
+   typedef typename PixelT::value_type    ValueT;
+
+   ChannelHistogram<PixelT> counts(src,PixelT::GRAY_CHANNEL);
+   unsigned thresholdCondition = (PixelT::traits::max() - PixelT::traits::min())/255;
+   return static_cast<ValueT>(isodataThreshold(counts.counts(PixelT::GRAY_CHANNEL),counts.bins(),thresholdCondition));
+}
+
+/*-----------------------------------------------------------------------**/
+// Floating point images have no useful histogram, so are iterated over the pixels.
+template<typename SrcImageT>
+typename SrcImageT::pixel_type::value_type optimalThreshold(const SrcImageT& src,
+              // This ugly bit is an unnamed argument with a default which means it neither           
+              // contributes to the mangled declaration name nor requires an argument. So what is the 
+              // point? It still participates in SFINAE to help select that this is an appropriate    
+              // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+              // deduction so can't be applied to in parameter directly.                              
+              typename std::enable_if<(types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                       types::is_monochrome<typename SrcImageT::pixel_type>::value) &&
+                                      !std::is_integral<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
 
    typedef typename SrcImageT::pixel_type PixelT;
    typedef typename PixelT::value_type    ValueT;
@@ -486,13 +674,12 @@ void optimalBinarize(const SrcImageT& src, TgtImageT& tgt,
    typename SrcImageT::const_iterator send(src.end());
    unsigned number = 0;
    for(;spos != send;++spos,++number) {
-      accum += spos->namedColor.gray;
+      accum += spos->tuple.value0;
    }
    
    ValueT threshold = static_cast<ValueT>((double)accum/number);
    ValueT thresholdLast = 0;
    // TODO: come up with a generic way to specify a more intelligent thresholdCondition.
-   // E.g. does this work properly for larger bit depths, and also for float pointing types???
    ValueT thresholdCondition = (SrcImageT::pixel_type::traits::max() - SrcImageT::pixel_type::traits::min())/255;
    // Now create loop checking stop condition.
    // Note a ternary expression is used to ensure unsigned math is performed correctly.
@@ -510,16 +697,37 @@ void optimalBinarize(const SrcImageT& src, TgtImageT& tgt,
          if(sposl->tuple.value0 < threshold) accumBG += sposl->tuple.value0,++numberBG;
          else accumFG += sposl->tuple.value0,++numberFG;
       }
+      // A threshold with an empty class can't move any further
+      if(0 == numberBG || 0 == numberFG) break;
       // Now compute new threshold
       threshold = static_cast<ValueT>(((double)accumFG/numberFG + (double)accumBG/numberBG)/2);
    }
+   return threshold;
+}
+
+/*-----------------------------------------------------------------------**/
+template<typename SrcImageT,typename TgtImageT>
+void optimalBinarize(const SrcImageT& src, TgtImageT& tgt,
+              // This ugly bit is an unnamed argument with a default which means it neither           
+              // contributes to the mangled declaration name nor requires an argument. So what is the 
+              // point? It still participates in SFINAE to help select that this is an appropriate    
+              // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+              // deduction so can't be applied to in parameter directly.                              
+              typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                      types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename SrcImageT::pixel_type PixelT;
+   typedef typename PixelT::value_type    ValueT;
+
+   ValueT threshold = optimalThreshold(src);
 
    // Now do the actual binarization based on threshold.
-   spos = src.begin();
+   typename SrcImageT::const_iterator spos(src.begin());
+   typename SrcImageT::const_iterator send(src.end());
    typename TgtImageT::iterator tpos = tgt.begin();
    for(;spos != send;++spos,++tpos) {
-      if(spos->namedColor.gray < threshold) tpos->tuple.value0 = TgtImageT::pixel_type::traits::min();
-      else                                  tpos->tuple.value0 = TgtImageT::pixel_type::traits::max();
+      if(spos->tuple.value0 < threshold) tpos->tuple.value0 = TgtImageT::pixel_type::traits::min();
+      else                               tpos->tuple.value0 = TgtImageT::pixel_type::traits::max();
    }
 }
 
@@ -527,8 +735,11 @@ void optimalBinarize(const SrcImageT& src, TgtImageT& tgt,
 // Note: because of the discrete histogram approach of this algorithm
 // currently it can only operate properly on integral pixel channels. Floating
 // point (or continuous-valued) images will not render properly.
-template<typename SrcImageT,typename TgtImageT>
-void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
+//
+// The threshold may be estimated on a decimated view (see StridedImageView)
+// and then applied to the full image with binarize.
+template<typename SrcImageT>
+unsigned otsuThreshold(const SrcImageT& src,
               // This ugly bit is an unnamed argument with a default which means it neither           
               // contributes to the mangled declaration name nor requires an argument. So what is the 
               // point? It still participates in SFINAE to help select that this is an appropriate    
@@ -538,16 +749,17 @@ void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
                                       types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
    // First compute histogram:
-   //uint32_t maxChannelHeight = 0u;
-   double maxChannelHeight = 0u;
+   typedef ChannelHistogram<typename SrcImageT::pixel_type> ChannelHistogramT;
+   typedef typename ChannelHistogramT::count_type           CountT;
    unsigned maxColor = SrcImageT::pixel_type::traits::max();
-   HistogramT histogram(computeHistogram(src,maxColor + 1u,SrcImageT::pixel_type::GRAY_CHANNEL,maxChannelHeight));
+   ChannelHistogramT counts(src,SrcImageT::pixel_type::GRAY_CHANNEL);
+   const CountT* histogram = counts.counts(SrcImageT::pixel_type::GRAY_CHANNEL);
 
    // Otsu Algorithm, find max sigma(t) = w1(t)*w2(t)*(u1(t) - u2(t))^2
    // so need to quickly compute u1 and u2, and w1(t) and w2(t)
    // Note: w1 and w2 will be later normalized by size
-   unsigned w1 = 0;
-   unsigned w2 = 0;
+   CountT w1 = 0;
+   CountT w2 = 0;
    // Using a "BigAccumulator", because for very large images, say 10000x10000, we could easily
    // exceed the max range of normal Accumulator.
    typedef typename types::BigAccumulatorVariableSelect<typename SrcImageT::pixel_type>::type AccumulatorT;
@@ -557,14 +769,14 @@ void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
 
    // Initialize accumulator of u2 and w2
    for(unsigned t = 0;t < maxColor;++t) {
-      w2 += (unsigned)histogram[t];
+      w2 += histogram[t];
       u2 += static_cast<AccumulatorT>(histogram[t]*t);
    }
    // Now compute means using incremental solution (much like a sliding average, except
    // copmuting average of subset by iterating histogram).
    unsigned maxThreshold = 0;
    double maxSigma = 0.0;
-   unsigned size = src.size();
+   double size = static_cast<double>(counts.total());
    for(unsigned t = 0;t < maxColor;++t) {
       w1 += histogram[t];
       u1 += histogram[t]*t;
@@ -575,6 +787,21 @@ void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
       double sigma = (double)w1/size*(double)w2/size*meanDiff*meanDiff;
       if(sigma > maxSigma) maxSigma = sigma, maxThreshold = t+1;
    }
+   return maxThreshold;
+}
+
+/*-----------------------------------------------------------------------**/
+template<typename SrcImageT,typename TgtImageT>
+void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
+              // This ugly bit is an unnamed argument with a default which means it neither           
+              // contributes to the mangled declaration name nor requires an argument. So what is the 
+              // point? It still participates in SFINAE to help select that this is an appropriate    
+              // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+              // deduction so can't be applied to in parameter directly.                              
+              typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                      types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   unsigned maxThreshold = otsuThreshold(src);
 
    // Now do the actual binarization based on threshold.
    typename SrcImageT::const_iterator spos(src.begin());
@@ -591,9 +818,26 @@ void otsuBinarize(const SrcImageT& src, TgtImageT& tgt,
 
 
 /*-----------------------------------------------------------------------**/
+// A reference color of binarizeColor, and its threshold distance
+template<typename PixelT>
+struct ColorReference {
+   float  threshold;
+   PixelT color;
+
+   ColorReference(float thresholdDistance,const PixelT& referenceColor) :
+      threshold(thresholdDistance),
+      color(referenceColor) {}
+};
+
+/*-----------------------------------------------------------------------**/
+// Binarizes src by its RGB distance to the reference colors: pixels within the
+// threshold distance of any reference are white, and all others red. Several
+// references are thus segmented in a single pass.
+//
+// Note: 8-bit pixels are tested in integer vector lanes (simd::binarizeColor).
 template<typename SrcImageT,typename TgtImageT>
-void binarizeColor(const SrcImageT& src, TgtImageT& tgt, float thresholdDistance,
-                   const typename SrcImageT::pixel_type& referenceColor,
+void binarizeColor(const SrcImageT& src, TgtImageT& tgt,
+                   const std::vector<ColorReference<typename std::remove_const<typename SrcImageT::pixel_type>::type> >& references,
                    // This ugly bit is an unnamed argument with a default which means it neither           
                    // contributes to the mangled declaration name nor requires an argument. So what is the 
                    // point? It still participates in SFINAE to help select that this is an appropriate    
@@ -601,51 +845,78 @@ void binarizeColor(const SrcImageT& src, TgtImageT& tgt, float thresholdDistance
                    // deduction so can't be applied to in parameter directly.                              
                    typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+   typedef typename TgtPixelT::traits                                       TgtTraits;
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
 
    // To avoid expensive sqrt on all distance calculations,
    // we may instead compare to the squared thresholdDistance.
-   double thresholdDistance2 = thresholdDistance * thresholdDistance;
-#ifdef DEBUG_BINARIZE_COLOR
-   unsigned count = 0;
-#endif
-   for(;spos != send;++spos,++tpos) {
-      double diffr = (double)spos->namedColor.red -
-                     (double)referenceColor.namedColor.red;
-      double diffg = (double)spos->namedColor.green -
-                     (double)referenceColor.namedColor.green;
-      double diffb = (double)spos->namedColor.blue -
-                     (double)referenceColor.namedColor.blue;
-      //double distance = std::sqrt(diffr*diffr + diffg*diffg + diffb*diffb);
-      double distance = diffr*diffr + diffg*diffg + diffb*diffb;
-
-#ifdef DEBUG_BINARIZE_COLOR
-      if(++count % 10000 == 0) 
-         std::cout << "diffr=" << diffr << " "
-                   << "diffg=" << diffg << " "
-                   << "diffb=" << diffb << " "
-                   << "distance=" << distance << " "
-                   << "thresholdDistance2=" << thresholdDistance2 << " "
-                   << "distance<thresholdDistance=" << (distance < thresholdDistance) << std::endl;
-#endif
-
-      if(distance < thresholdDistance2) {
-         // Anything below the threshold is white
-         tpos->namedColor.red = TgtImageT::pixel_type::traits::max();
-         tpos->namedColor.green = TgtImageT::pixel_type::traits::max();
-         tpos->namedColor.blue = TgtImageT::pixel_type::traits::max();
+   std::vector<double> thresholds2;
+   // For integer distances (of 8-bit channels), distance < thresholdDistance2
+   // exactly when distance < ceil(thresholdDistance2)
+   std::vector<uint8_t> colors;
+   std::vector<int32_t> limits;
+   for(const ColorReference<PixelT>& reference : references) {
+      const double thresholdDistance2 = (double)reference.threshold * (double)reference.threshold;
+      thresholds2.push_back(thresholdDistance2);
+      for(unsigned ch = 0;ch < 4u;++ch) colors.push_back(static_cast<uint8_t>(reference.color.indexedColor[ch]));
+      const double limit = std::ceil(std::min(thresholdDistance2,3.0*255.0*255.0 + 1.0));
+      limits.push_back(limit > 0.0 ? static_cast<int32_t>(limit) : 0);
+   }
+   const bool bytes = std::is_same<typename PixelT::value_type,uint8_t>::value &&
+                      std::is_same<typename std::remove_const<TgtPixelT>::type,PixelT>::value &&
+                      255 == TgtTraits::max() && 0 == TgtTraits::min();
+
+   const unsigned cols = src.cols();
+   for(unsigned r = 0;r < src.rows();++r) {
+      const auto srow = types::rowPixels(src,r);
+      const auto trow = types::rowPixels(tgt,r);
+      // Rows of Images and ImageViews are contiguous, but not those of strided views
+      if(bytes && 1 == srow.step && 1 == trow.step) {
+         simd::binarizeColor(reinterpret_cast<const uint8_t*>(srow.first),reinterpret_cast<uint8_t*>(trow.first),cols,
+                             colors.data(),limits.data(),static_cast<unsigned>(references.size()));
+         continue;
       }
-      else {
-         // Anything above the threshold is red
-         tpos->namedColor.red = TgtImageT::pixel_type::traits::max();
-         tpos->namedColor.green = TgtImageT::pixel_type::traits::min();
-         tpos->namedColor.blue = TgtImageT::pixel_type::traits::min();
+      for(unsigned c = 0;c < cols;++c) {
+         const PixelT& spixel = srow[c];
+         TgtPixelT&    tpixel = trow[c];
+         bool near = false;
+         for(unsigned k = 0;k < references.size() && !near;++k) {
+            const PixelT& referenceColor = references[k].color;
+            double diffr = (double)spixel.namedColor.red -
+                           (double)referenceColor.namedColor.red;
+            double diffg = (double)spixel.namedColor.green -
+                           (double)referenceColor.namedColor.green;
+            double diffb = (double)spixel.namedColor.blue -
+                           (double)referenceColor.namedColor.blue;
+            double distance = diffr*diffr + diffg*diffg + diffb*diffb;
+            near = distance < thresholds2[k];
+         }
+         // Anything below the threshold is white, and anything above it red
+         tpixel.namedColor.red = TgtTraits::max();
+         tpixel.namedColor.green = near ? TgtTraits::max() : TgtTraits::min();
+         tpixel.namedColor.blue = near ? TgtTraits::max() : TgtTraits::min();
       }
    }
 }
 
+template<typename SrcImageT,typename TgtImageT>
+void binarizeColor(const SrcImageT& src, TgtImageT& tgt, float thresholdDistance,
+                   const typename SrcImageT::pixel_type& referenceColor,
+                   // This ugly bit is an unnamed argument with a default which means it neither           
+                   // contributes to the mangled declaration name nor requires an argument. So what is the 
+                   // point? It still participates in SFINAE to help select that this is an appropriate    
+                   // matching function given its arguments. Note, SFINAE techniques are incompatible with 
+                   // deduction so can't be applied to in parameter directly.                              
+                   typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   binarizeColor(src,tgt,std::vector<ColorReference<PixelT> >(1u,ColorReference<PixelT>(thresholdDistance,referenceColor)));
+}
+
 /*-----------------------------------------------------------------------**/
 template<typename SrcImageT,typename TgtImageT>
 void selectChannel(const SrcImageT& src, TgtImageT& tgt, unsigned channel) {
@@ -684,16 +955,7 @@ void selectHSI(const SrcImageT& src, TgtImageT& tgt, unsigned channel,
                // deduction so can't be applied to in parameter directly.                              
                typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typedef types::Image<types::HSIPixel<float> > HSIImageT;
-
-   HSIImageT hsiSrc(src.rows(),src.cols());
-   hsiSrc = src;
-
-   typename HSIImageT::const_iterator spos(hsiSrc.begin());
-   typename HSIImageT::const_iterator send(hsiSrc.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   for(;spos != send;++spos,++tpos) channel2mono(*spos,*tpos,channel);
+   selectHSIChannel(src,tgt,channel);
 }
 
 
@@ -708,17 +970,8 @@ void binarizeDouble(const SrcImageT& src, TgtImageT& tgt, unsigned thresholdLow,
          // deduction so can't be applied to in parameter directly.                              
          typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typename SrcImageT::const_iterator spos(src.begin());
-   typename SrcImageT::const_iterator send(src.end());
-   typename TgtImageT::iterator       tpos(tgt.begin());
-
-   for(;spos != send;++spos,++tpos) {
-      if(spos->namedColor.gray < thresholdLow || spos->namedColor.gray >= thresholdHigh)
-         tpos->namedColor.gray = TgtImageT::pixel_type::traits::min();
-      else
-         tpos->namedColor.gray = TgtImageT::pixel_type::traits::max();
-
-   }
+   typedef typename TgtImageT::pixel_type PixelT;
+   pointOperation(src,tgt,point::DoubleThreshold<PixelT>(thresholdLow,thresholdHigh),colorChannelMask<PixelT>());
 }
 
 template<typename PixelT,typename AccumulatorVariableTT>
@@ -826,96 +1079,43 @@ void uniformSmooth(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,
    utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
    utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
 
+   typedef typename SrcImageT::pixel_type                               PixelT;
+   typedef typename TgtImageT::pixel_type::value_type                   ValueT;
+   typedef types::IntegralImage<PixelT>                                 IntegralT;
+   typedef typename IntegralT::accumulator_type                         AccumulatorT;
+
    unsigned rows = src.rows();
    unsigned cols = src.cols();
+   unsigned halfWindow = windowSize >> 1u;
+
+   // All window sums come from one summed-area table, so the cost per pixel is
+   // independent of windowSize.
+   IntegralT integral(src,PixelT::GRAY_CHANNEL,false);
 
    // We can write out result to iterator operating over entire passed Image or ImageView
    // since the iteration order is exactly the same as our loops.
    typename TgtImageT::iterator tpos(tgt.begin());
 
-   // Start by smoothing along X for each row
+   // Near the borders the window shrinks symmetrically about the pixel (so that
+   // it stays centered), independently along rows and cols.
    for(unsigned i = 0;i < rows;++i) {
-      typedef SmoothX<SrcImageT> SmoothXT;
-      typedef typename SrcImageT::image_view RowViewT;
-      
-      RowViewT rowView(src.view(1,cols,i));
-      SmoothXT smoothX(rowView,windowSize);
-      // We always start with the first answer precomputed
-      // which also implies we will only iterate and shift cols-1 times.
-      tpos->namedColor.gray = smoothX.average();
-      ++tpos;
-      for(unsigned j = 1;j < cols;++j,++tpos) {
-         ++smoothX;
-         tpos->namedColor.gray = smoothX.average();
-      }
-   }
-
-   typedef typename TgtImageT::image_view ColumnViewT; // not strictly a Column type, but will be
-                                                       // parameterized below to operate as one.
-   typedef typename ColumnViewT::iterator ColumnIteratorT;
-   // In this case our iteration order is flipped, and since we don't have a column-first
-   // iterator type, we just need to create column views to write out our output.
-   for(unsigned j = 0; j < cols; ++j) {
-      typedef SmoothY<TgtImageT> SmoothYT;
-      ColumnViewT columnView(tgt.view(rows,1,0,j));
-      SmoothYT smoothY(columnView,windowSize);
-      ColumnIteratorT cpos = columnView.begin();
-      // As above, we always start with the first answer precomputed
-      // which also implies we will only iterate and shift rows-1 times.
-      cpos->namedColor.gray = smoothY.average();
-      ++cpos;
-      for(unsigned i = 1;i < rows;++i,++cpos) {
-         ++smoothY;
-         cpos->namedColor.gray = smoothY.average();
+      unsigned halfRows = std::min(halfWindow,std::min(i,rows-1-i));
+      for(unsigned j = 0;j < cols;++j,++tpos) {
+         unsigned halfCols = std::min(halfWindow,std::min(j,cols-1-j));
+         unsigned windowRows = 2*halfRows+1;
+         unsigned windowCols = 2*halfCols+1;
+         AccumulatorT sum = integral.sum(i-halfRows,j-halfCols,windowRows,windowCols);
+         tpos->namedColor.gray = static_cast<ValueT>(checkValue<PixelT>(static_cast<AccumulatorT>((double)sum / (windowRows*windowCols))));
       }
    }
 }
 
 /*-----------------------------------------------------------------------**/
+// Resizes src by ratio (see resample): reductions average the covered area
+// (e.g. 2x2 pixels for 0.5), and enlargements replicate pixels.
 template<typename SrcImageT,typename TgtImageT>
-void scale(const SrcImageT& src, TgtImageT& tgt, float ratio,
-              // This ugly bit is an unnamed argument with a default which means it neither           
-              // contributes to the mangled declaration name nor requires an argument. So what is the 
-              // point? It still participates in SFINAE to help select that this is an appropriate    
-              // matching function given its arguments. Note, SFINAE techniques are incompatible with 
-              // deduction so can't be applied to in parameter directly.                              
-              typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
-
-   if(ratio > 1.9f) { // assume ratio is double
-      tgt.resize(src.rows()*2,src.cols()*2);
-      unsigned rows = src.rows()*2;
-      unsigned cols = src.cols()*2;
-      for(unsigned i = 0; i < rows; ++i) {
-         unsigned i2 = i >> 1u; // divide by 2
-         for(unsigned j = 0; j < cols; ++j) {
-            unsigned j2 = j >> 1u; // divide by 2
-            tgt.pixel(i,j) = src.pixel(i2,j2);
-         }
-      }
-   }
-   else if(ratio < 0.55) { // assume ratio is half
-      typedef typename SrcImageT::pixel_type pixel_type;
-      typedef typename pixel_type::value_type value_type;
-      typedef typename types::AccumulatorVariableSelect<pixel_type>::type AccumulatorT;
-
-      tgt.resize(src.rows()/2,src.cols()/2);
-      unsigned rows = src.rows() >> 1;
-      unsigned cols = src.cols() >> 1;
-      for(unsigned i = 0; i < rows; ++i) {
-         unsigned i2 = i << 1u; // multiply by 2
-         for(unsigned j = 0; j < cols; ++j) {
-            unsigned j2 = j << 1u; // multiply by 2
-            // average the values of four pixels
-            AccumulatorT acc = src.pixel(i2,j2).namedColor.gray;
-            acc += src.pixel(i2,j2+1).namedColor.gray;
-            acc += src.pixel(i2+1,j2).namedColor.gray;
-            acc += src.pixel(i2+1,j2+1).namedColor.gray;
-            // Now divide value by 4
-            acc >>= 2;
-            tgt.pixel(i,j).namedColor.gray = static_cast<value_type>(checkValue<pixel_type>(acc));
-         }
-      }
-   }
+void scale(const SrcImageT& src, TgtImageT& tgt, float ratio) {
+   resample(src,tgt,ratio,ratio < 1.0f ? RESAMPLE_AREA : RESAMPLE_NEAREST);
 }
 
 
@@ -981,6 +1181,337 @@ void convolve(const SrcImageT& src,const KernelT& kernel,TgtImageT& tgt,unsigned
    }
 }
 
+
+/*-----------------------------------------------------------------------**/
+// Vectorized core shared by convolveVectorized and the fused gradient functions: the
+// source is convolved with one or more equally sized kernels, reading each source row
+// only once, and each output row of every kernel is handed to rowSink as
+// rowSink(row,accumulators), where accumulators[k] holds the row for kernels[k].
+//
+// Source rows (8-bit, 16-bit or floating point channels) are converted once into a
+// ring of ValueT line buffers, and each kernel coefficient is then applied to a whole
+// output row at a time via simd::multiplyAccumulate, which processes 4, 8 or 16 float
+// output pixels per instruction depending on the processor (detected at runtime).
+// Zero kernel coefficients (e.g. the center column of Sobel kernels) are skipped.
+template<typename SrcImageT,typename KernelT,typename RowSinkT>
+void convolveVectorizedRows(const SrcImageT& src,const std::vector<const KernelT*>& kernels,unsigned channel,RowSinkT& rowSink) {
+
+   typedef typename KernelT::pixel_type::value_type ValueT;
+
+   utility::reportIfEqual("kernels.size() == 0",kernels.size(),(std::size_t)0u);
+   unsigned kernelRows = kernels.front()->rows();
+   unsigned kernelCols = kernels.front()->cols();
+   unsigned numKernels = static_cast<unsigned>(kernels.size());
+   utility::reportIfNotLessThan("kernel.rows() < src.rows()",kernelRows,src.rows()+1);
+   utility::reportIfNotLessThan("kernel.cols() < src.cols()",kernelCols,src.cols()+1);
+
+   unsigned srcCols = src.cols();
+   unsigned tgtRows = src.rows() - kernelRows + 1;
+   unsigned tgtCols = src.cols() - kernelCols + 1;
+
+   std::vector<ValueT> weights(numKernels*kernelRows*kernelCols);
+   for(unsigned k = 0; k < numKernels; ++k) {
+      utility::reportIfNotEqual("kernel.rows()",kernels[k]->rows(),kernelRows);
+      utility::reportIfNotEqual("kernel.cols()",kernels[k]->cols(),kernelCols);
+      for(unsigned m = 0; m < kernelRows; ++m) {
+         for(unsigned n = 0; n < kernelCols; ++n) {
+            weights[(k*kernelRows + m)*kernelCols + n] = static_cast<ValueT>(kernels[k]->pixel(m,n).tuple.value0);
+         }
+      }
+   }
+
+   // Ring of kernelRows source lines, where source row r lives in line r % kernelRows
+   std::vector<ValueT> lines(static_cast<std::size_t>(kernelRows)*srcCols);
+   for(unsigned r = 0; r + 1 < kernelRows; ++r) {
+      ValueT* line = &lines[static_cast<std::size_t>(r)*srcCols];
+      for(unsigned c = 0; c < srcCols; ++c) line[c] = static_cast<ValueT>(src.pixel(r,c).indexedColor[channel]);
+   }
+
+   std::vector<std::vector<ValueT> > accumulators(numKernels,std::vector<ValueT>(tgtCols));
+   for(unsigned i = 0; i < tgtRows; ++i) {
+      // Load the newest source row needed by this output row
+      unsigned newest = i + kernelRows - 1;
+      ValueT* newLine = &lines[static_cast<std::size_t>(newest % kernelRows)*srcCols];
+      for(unsigned c = 0; c < srcCols; ++c) newLine[c] = static_cast<ValueT>(src.pixel(newest,c).indexedColor[channel]);
+
+      for(unsigned k = 0; k < numKernels; ++k) {
+         std::vector<ValueT>& acc = accumulators[k];
+         std::fill(acc.begin(),acc.end(),static_cast<ValueT>(0));
+         for(unsigned m = 0; m < kernelRows; ++m) {
+            const ValueT* line = &lines[static_cast<std::size_t>((i + m) % kernelRows)*srcCols];
+            const ValueT* kernelRow = &weights[(k*kernelRows + m)*kernelCols];
+            for(unsigned n = 0; n < kernelCols; ++n) {
+               if(kernelRow[n] != static_cast<ValueT>(0)) simd::multiplyAccumulate(&acc[0],line + n,kernelRow[n],tgtCols);
+            }
+         }
+      }
+      rowSink(i,accumulators);
+   }
+}
+
+namespace sink {
+
+   // Writes convolution output rows to a target image, tracking the largest magnitude
+   template<typename TgtImageT,typename ValueT>
+   struct ConvolutionRowSink {
+      TgtImageT& tgt;
+      ValueT&    maxVal;
+      ConvolutionRowSink(TgtImageT& target,ValueT& maximum) : tgt(target), maxVal(maximum) {}
+      template<typename AccumulatorT>
+      void operator()(unsigned row,const std::vector<std::vector<AccumulatorT> >& accumulators) {
+         const std::vector<AccumulatorT>& acc = accumulators.front();
+         for(unsigned j = 0; j < tgt.cols(); ++j) {
+            ValueT v = static_cast<ValueT>(acc[j]);
+            tgt.pixel(row,j).tuple.value0 = v;
+            if(std::abs(v) > maxVal) maxVal = std::abs(v);
+         }
+      }
+   };
+
+} // namespace sink
+
+
+/*-----------------------------------------------------------------------**/
+// Vectorized counterpart to convolve (which is kept as the reference implementation).
+// The output area and semantics (including maxVal) are identical to convolve.
+template<typename SrcImageT,typename KernelT,typename TgtImageT,typename ValueT>
+void convolveVectorized(const SrcImageT& src,const KernelT& kernel,TgtImageT& tgt,unsigned channel,ValueT& maxVal) {
+
+   utility::reportIfNotEqual("src.rows()-kernel.rows()+1 != tgt.rows()",src.rows()-kernel.rows()+1,tgt.rows());
+   utility::reportIfNotEqual("src.cols()-kernel.cols()+1 != tgt.cols()",src.cols()-kernel.cols()+1,tgt.cols());
+
+   maxVal = static_cast<ValueT>(0);
+   std::vector<const KernelT*> kernels(1,&kernel);
+   sink::ConvolutionRowSink<TgtImageT,ValueT> rowSink(tgt,maxVal);
+   convolveVectorizedRows(src,kernels,channel,rowSink);
+}
+
+/*-----------------------------------------------------------------------**/
+// A separable kernel term is the outer product of a column kernel and a row kernel,
+// i.e. kernel(m,n) = column[m]*row[n]. Any kernel of rank R may be exactly expressed
+// as the sum of R separable terms.
+template<typename ValueT>
+struct SeparableTerm {
+   std::vector<ValueT> column;
+   std::vector<ValueT> row;
+};
+
+
+/*-----------------------------------------------------------------------**/
+// Decomposes a (monochrome) kernel into a sum of separable (rank-1) terms using
+// a fully pivoted cross (skeleton) approximation: at each step the largest
+// residual coefficient selects a column and row of the residual, whose outer
+// product is subtracted. For a kernel of exact rank R this terminates after R
+// terms, e.g. a classic Sobel or box kernel decomposes into a single term.
+//
+// Decomposition stops once every residual coefficient is within
+// relativeTolerance of the largest kernel coefficient.
+//
+// Returns the number of terms (the numerical rank of the kernel).
+template<typename KernelT,typename ValueT>
+unsigned separableDecompose(const KernelT& kernel,std::vector<SeparableTerm<ValueT> >& terms,double relativeTolerance = 1e-6) {
+
+   unsigned rows = kernel.rows();
+   unsigned cols = kernel.cols();
+
+   // Work in double precision to not accumulate error in the residual
+   std::vector<double> residual(rows*cols);
+   double maxCoefficient = 0.0;
+   for(unsigned m = 0; m < rows; ++m) {
+      for(unsigned n = 0; n < cols; ++n) {
+         residual[m*cols+n] = kernel.pixel(m,n).tuple.value0;
+         maxCoefficient = std::max(maxCoefficient,std::abs(residual[m*cols+n]));
+      }
+   }
+
+   terms.clear();
+   double tolerance = relativeTolerance * maxCoefficient;
+   for(unsigned rank = 0; rank < std::min(rows,cols); ++rank) {
+      // Find pivot
+      unsigned pivotRow = 0;
+      unsigned pivotCol = 0;
+      double pivot = 0.0;
+      for(unsigned m = 0; m < rows; ++m) {
+         for(unsigned n = 0; n < cols; ++n) {
+            if(std::abs(residual[m*cols+n]) > std::abs(pivot)) pivot = residual[m*cols+n], pivotRow = m, pivotCol = n;
+         }
+      }
+      if(std::abs(pivot) <= tolerance) break;
+
+      SeparableTerm<ValueT> term;
+      term.column.resize(rows);
+      term.row.resize(cols);
+      std::vector<double> column(rows);
+      std::vector<double> row(cols);
+      for(unsigned m = 0; m < rows; ++m) column[m] = residual[m*cols+pivotCol];
+      for(unsigned n = 0; n < cols; ++n) row[n] = residual[pivotRow*cols+n] / pivot;
+      for(unsigned m = 0; m < rows; ++m) {
+         term.column[m] = static_cast<ValueT>(column[m]);
+         for(unsigned n = 0; n < cols; ++n) residual[m*cols+n] -= column[m]*row[n];
+      }
+      for(unsigned n = 0; n < cols; ++n) term.row[n] = static_cast<ValueT>(row[n]);
+      terms.push_back(term);
+   }
+   return static_cast<unsigned>(terms.size());
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Separable counterpart to convolveVectorizedRows: each of the kernels is given as a
+// sum of separable terms (kernelTerms[k] for kernel k, see separableDecompose), so
+// each term costs the nonzero coefficients of its row plus its column per pixel,
+// rather than those of the whole kernel. Output rows are handed to rowSink just as
+// with convolveVectorizedRows.
+//
+// Each source row is read once into a line buffer and filtered by the row of every
+// term into a ring of kernelRows horizontally filtered rows (per term), which the
+// columns of the terms then combine, both via simd::multiplyAccumulate.
+template<typename SrcImageT,typename ValueT,typename RowSinkT>
+void convolveSeparableRows(const SrcImageT& src,const std::vector<std::vector<SeparableTerm<ValueT> > >& kernelTerms,
+                           unsigned channel,RowSinkT& rowSink) {
+
+   utility::reportIfEqual("kernelTerms.size() == 0",kernelTerms.size(),(std::size_t)0u);
+   utility::reportIfEqual("terms.size() == 0",kernelTerms.front().size(),(std::size_t)0u);
+   unsigned kernelRows = static_cast<unsigned>(kernelTerms.front().front().column.size());
+   unsigned kernelCols = static_cast<unsigned>(kernelTerms.front().front().row.size());
+   utility::reportIfNotLessThan("kernel.rows() < src.rows()",kernelRows,src.rows()+1);
+   utility::reportIfNotLessThan("kernel.cols() < src.cols()",kernelCols,src.cols()+1);
+
+   unsigned srcCols = src.cols();
+   unsigned tgtRows = src.rows() - kernelRows + 1;
+   unsigned tgtCols = src.cols() - kernelCols + 1;
+   unsigned numKernels = static_cast<unsigned>(kernelTerms.size());
+
+   // All terms of all kernels, in order
+   std::vector<const SeparableTerm<ValueT>*> terms;
+   for(const std::vector<SeparableTerm<ValueT> >& kernel : kernelTerms) {
+      utility::reportIfEqual("terms.size() == 0",kernel.size(),(std::size_t)0u);
+      for(const SeparableTerm<ValueT>& term : kernel) {
+         utility::reportIfNotEqual("kernel.rows()",(unsigned)term.column.size(),kernelRows);
+         utility::reportIfNotEqual("kernel.cols()",(unsigned)term.row.size(),kernelCols);
+         terms.push_back(&term);
+      }
+   }
+   const std::size_t numTerms = terms.size();
+
+   // Rings of kernelRows filtered rows per term, where source row r lives in slot r % kernelRows
+   std::vector<ValueT> line(srcCols);
+   std::vector<ValueT> horizontal(numTerms*kernelRows*tgtCols);
+   auto filterRow = [&](unsigned r) {
+      for(unsigned c = 0; c < srcCols; ++c) line[c] = static_cast<ValueT>(src.pixel(r,c).indexedColor[channel]);
+      for(std::size_t t = 0; t < numTerms; ++t) {
+         const ValueT* row = &terms[t]->row[0];
+         ValueT* hrow = &horizontal[(t*kernelRows + r % kernelRows)*tgtCols];
+         std::fill(hrow,hrow+tgtCols,static_cast<ValueT>(0));
+         for(unsigned n = 0; n < kernelCols; ++n) {
+            if(row[n] != static_cast<ValueT>(0)) simd::multiplyAccumulate(hrow,&line[n],row[n],tgtCols);
+         }
+      }
+   };
+   for(unsigned r = 0; r + 1 < kernelRows; ++r) filterRow(r);
+
+   std::vector<std::vector<ValueT> > accumulators(numKernels,std::vector<ValueT>(tgtCols));
+   for(unsigned i = 0; i < tgtRows; ++i) {
+      filterRow(i + kernelRows - 1);
+      std::size_t t = 0;
+      for(unsigned k = 0; k < numKernels; ++k) {
+         std::vector<ValueT>& acc = accumulators[k];
+         std::fill(acc.begin(),acc.end(),static_cast<ValueT>(0));
+         for(std::size_t end = t + kernelTerms[k].size(); t < end; ++t) {
+            const ValueT* column = &terms[t]->column[0];
+            for(unsigned m = 0; m < kernelRows; ++m) {
+               const ValueT* hrow = &horizontal[(t*kernelRows + (i + m) % kernelRows)*tgtCols];
+               if(column[m] != static_cast<ValueT>(0)) simd::multiplyAccumulate(&acc[0],hrow,column[m],tgtCols);
+            }
+         }
+      }
+      rowSink(i,accumulators);
+   }
+}
+
+// Separable counterpart to convolve: the output area and semantics (including maxVal)
+// are identical to convolve.
+template<typename SrcImageT,typename ValueT,typename TgtImageT>
+void convolveSeparable(const SrcImageT& src,const std::vector<SeparableTerm<ValueT> >& terms,
+                       TgtImageT& tgt,unsigned channel,ValueT& maxVal) {
+
+   utility::reportIfEqual("terms.size() == 0",terms.size(),(std::size_t)0u);
+   utility::reportIfNotEqual("src.rows()-kernel.rows()+1 != tgt.rows()",src.rows()-(unsigned)terms.front().column.size()+1,tgt.rows());
+   utility::reportIfNotEqual("src.cols()-kernel.cols()+1 != tgt.cols()",src.cols()-(unsigned)terms.front().row.size()+1,tgt.cols());
+
+   maxVal = static_cast<ValueT>(0);
+   std::vector<std::vector<SeparableTerm<ValueT> > > kernelTerms(1,terms);
+   sink::ConvolutionRowSink<TgtImageT,ValueT> rowSink(tgt,maxVal);
+   convolveSeparableRows(src,kernelTerms,channel,rowSink);
+}
+
+// Convenience form for a single separable (rank-1) kernel: kernel(m,n) = column[m]*row[n]
+template<typename SrcImageT,typename ValueT,typename TgtImageT>
+void convolveSeparable(const SrcImageT& src,const std::vector<ValueT>& column,const std::vector<ValueT>& row,
+                       TgtImageT& tgt,unsigned channel,ValueT& maxVal) {
+   std::vector<SeparableTerm<ValueT> > terms(1);
+   terms[0].column = column;
+   terms[0].row = row;
+   convolveSeparable(src,terms,tgt,channel,maxVal);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Multiplies per pixel of the direct (convolveVectorized, which skips zero
+// coefficients) and separable (convolveSeparable) convolutions with a kernel
+// and its separable terms.
+namespace convolution {
+
+   template<typename KernelT>
+   unsigned directTaps(const KernelT& kernel) {
+      unsigned nonzeros = 0;
+      for(unsigned m = 0; m < kernel.rows(); ++m) {
+         for(unsigned n = 0; n < kernel.cols(); ++n) if(kernel.pixel(m,n).tuple.value0 != 0) ++nonzeros;
+      }
+      return nonzeros;
+   }
+
+   template<typename ValueT>
+   unsigned separableTaps(const std::vector<SeparableTerm<ValueT> >& terms) {
+      unsigned taps = 0;
+      for(const SeparableTerm<ValueT>& term : terms) {
+         for(ValueT value : term.column) if(value != static_cast<ValueT>(0)) ++taps;
+         for(ValueT value : term.row) if(value != static_cast<ValueT>(0)) ++taps;
+      }
+      return taps;
+   }
+
+   // Whether the separable convolution (with terms, from separableDecompose) is cheaper
+   // than the direct one. Both are vectorized alike, but the separable one also clears
+   // and stores a horizontally filtered row per term, which costs about one multiply
+   // (so rank-1 kernels such as Sobel 3x3 and boxes of any size are separable).
+   template<typename KernelT,typename ValueT>
+   bool preferSeparable(const KernelT& kernel,const std::vector<SeparableTerm<ValueT> >& terms) {
+      return !terms.empty() && separableTaps(terms) + static_cast<unsigned>(terms.size()) <= directTaps(kernel);
+   }
+
+} // namespace convolution
+
+
+/*-----------------------------------------------------------------------**/
+// Direct (not FFT-based) convolution, with the same output area and semantics as
+// convolve, which is separable (see convolveSeparable) whenever the kernel's rank
+// makes that cheaper (e.g. box kernels, or Gaussians, of any size are rank 1), and
+// otherwise vectorized (see convolveVectorized).
+template<typename SrcImageT,typename KernelT,typename TgtImageT,typename ValueT>
+void convolveDirect(const SrcImageT& src,const KernelT& kernel,TgtImageT& tgt,unsigned channel,ValueT& maxVal) {
+
+   typedef typename KernelT::pixel_type::value_type PrecisionT;
+   std::vector<SeparableTerm<PrecisionT> > terms;
+   separableDecompose(kernel,terms);
+   if(convolution::preferSeparable(kernel,terms)) {
+      PrecisionT maxPrecisionVal;
+      convolveSeparable(src,terms,tgt,channel,maxPrecisionVal);
+      maxVal = static_cast<ValueT>(maxPrecisionVal);
+   }
+   else convolveVectorized(src,kernel,tgt,channel,maxVal);
+}
+
 // Function predicates that can be used in std::transform and other expressions
 namespace predicate {
 
@@ -1076,7 +1607,7 @@ namespace edge {
 
 
 template<typename GradientT,typename SrcImageT,typename KernelT,typename ValueT>
-GradientT gradientPartial(const SrcImageT src,const KernelT& kernel,unsigned windowSize,unsigned channel,ValueT& maxVal) {
+GradientT gradientPartial(const SrcImageT& src,const KernelT& kernel,unsigned windowSize,unsigned channel,ValueT& maxVal) {
 
    unsigned halfWindowSize = windowSize >> 1u;
    unsigned windowSizeEven = halfWindowSize << 1u;
@@ -1086,7 +1617,7 @@ GradientT gradientPartial(const SrcImageT src,const KernelT& kernel,unsigned win
    GradientT gradient(src.rows(),src.cols());
    GradientViewT gradientView(gradient.view(src.rows()-windowSizeEven,src.cols()-windowSizeEven,halfWindowSize,halfWindowSize));
 
-   convolve(src,kernel,gradientView,channel,maxVal);
+   convolveDirect(src,kernel,gradientView,channel,maxVal);
    return gradient;
 }
 
@@ -1110,100 +1641,193 @@ GradientT gradientDirection(const GradientT& gradientX,const GradientT& gradient
 }
 
 
+namespace sink {
+
+   // Gradient directions (in radians, as returned by atan2) within [low,high) are selected,
+   // unless high < low, in which case directions outside of [high,low] are selected.
+   template<typename ValueT>
+   struct OrientationBand {
+      ValueT low;
+      ValueT high;
+      bool includes(ValueT direction) const {
+         if(high < low) return high >= direction || direction > low;
+         else           return low <= direction && direction < high;
+      }
+   };
+
+   // Combines the X and Y partial gradient rows into gradient magnitude and optionally
+   // direction, or an orientation masked magnitude, as each row is produced.
+   template<typename GradientT>
+   struct GradientRowSink {
+      typedef typename GradientT::pixel_type::value_type ValueT;
+      GradientT&                     magnitude;
+      GradientT*                     direction;
+      const OrientationBand<ValueT>* orientation;
+      unsigned                       offset;
+      ValueT                         maxVal; // largest partial gradient magnitude
+
+      GradientRowSink(GradientT& mag,GradientT* dir,const OrientationBand<ValueT>* band,unsigned halfWindowSize) :
+         magnitude(mag),
+         direction(dir),
+         orientation(band),
+         offset(halfWindowSize),
+         maxVal(0)
+      {}
+
+      template<typename AccumulatorT>
+      void operator()(unsigned row,const std::vector<std::vector<AccumulatorT> >& accumulators) {
+         const std::vector<AccumulatorT>& gx = accumulators[0];
+         const std::vector<AccumulatorT>& gy = accumulators[1];
+         unsigned cols = static_cast<unsigned>(gx.size());
+         typename GradientT::pixel_type* mrow = &magnitude.pixel(row + offset,offset);
+         for(unsigned j = 0; j < cols; ++j) {
+            ValueT x = static_cast<ValueT>(gx[j]);
+            ValueT y = static_cast<ValueT>(gy[j]);
+            maxVal = std::max(maxVal,std::max(std::abs(x),std::abs(y)));
+            ValueT mag = std::sqrt(x*x + y*y);
+            if(0 != direction || 0 != orientation) {
+               ValueT dir = std::atan2(y,x);
+               if(0 != direction) direction->pixel(row + offset,j + offset).tuple.value0 = dir;
+               if(0 != orientation && !orientation->includes(dir)) mag = static_cast<ValueT>(0);
+            }
+            mrow[j].tuple.value0 = mag;
+         }
+      }
+   };
+
+} // namespace sink
+
+
+/*-----------------------------------------------------------------------**/
+// Fused single-pass gradient: each source neighbourhood is read once to compute both
+// partial gradients, which are immediately combined into the gradient magnitude (and
+// optionally the gradient direction, and/or masked by an orientation band). This
+// replaces separate partial gradient images and the passes that combine them.
+//
+// magnitude (and direction if given) are resized to the source size, where the
+// border of windowSize/2 pixels is zero (just as with gradientPartial).
+//
+// If normalize is set, magnitude is divided by the largest partial gradient
+// magnitude (the same normalization as edgeGradient). Returns that maximum.
+template<typename SrcImageT,typename KernelT,typename GradientT>
+typename GradientT::pixel_type::value_type
+fusedGradient(const SrcImageT& src,const KernelT& kernelX,const KernelT& kernelY,unsigned windowSize,unsigned channel,
+              GradientT& magnitude,GradientT* direction,
+              const sink::OrientationBand<typename GradientT::pixel_type::value_type>* orientation,bool normalize) {
+
+   typedef typename GradientT::pixel_type::value_type ValueT;
+
+   magnitude = GradientT(src.rows(),src.cols());
+   if(0 != direction) *direction = GradientT(src.rows(),src.cols());
+
+   sink::GradientRowSink<GradientT> rowSink(magnitude,direction,orientation,windowSize >> 1u);
+   std::vector<std::vector<SeparableTerm<ValueT> > > terms(2);
+   separableDecompose(kernelX,terms[0]);
+   separableDecompose(kernelY,terms[1]);
+   if(convolution::preferSeparable(kernelX,terms[0]) && convolution::preferSeparable(kernelY,terms[1])) {
+      convolveSeparableRows(src,terms,channel,rowSink);
+   }
+   else {
+      std::vector<const KernelT*> kernels;
+      kernels.push_back(&kernelX);
+      kernels.push_back(&kernelY);
+      convolveVectorizedRows(src,kernels,channel,rowSink);
+   }
+
+   if(normalize && rowSink.maxVal > static_cast<ValueT>(0)) {
+      typename GradientT::iterator gpos(magnitude.begin());
+      typename GradientT::iterator gend(magnitude.end());
+      for(;gpos != gend;++gpos) gpos->tuple.value0 /= rowSink.maxVal;
+   }
+   return rowSink.maxVal;
+}
+
+
 template<typename SrcImageT,typename KernelT,typename TgtImageT>
-void edgeGradient(const SrcImageT src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,unsigned channel) {
+void edgeGradient(const SrcImageT& src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,unsigned channel) {
 
    typedef typename KernelT::pixel_type::value_type PrecisionT;
    typedef types::Image<types::MonochromePixel<PrecisionT> > GradientT;
-   PrecisionT maxVal1,maxVal2;
-   GradientT gradientX(gradientPartial<GradientT>(src,kernelX,windowSize,channel,maxVal1));
-   GradientT gradientY(gradientPartial<GradientT>(src,kernelY,windowSize,channel,maxVal2));
-   PrecisionT maxVal = std::max(maxVal1,maxVal2);
 
-   // TODO: do I have to worry about scaling the output? as the gradientPartial does not currently account
+   // TODO: do I have to worry about scaling the output? as the gradient does not currently account
    // for scaling input and output if min/max are different ranges.
-   // Now we should normalize the entire image by the maxVal.
-   typename GradientT::iterator gxpos(gradientX.begin());
-   typename GradientT::iterator gxend(gradientX.end());
-   for(;gxpos != gxend;++gxpos) gxpos->tuple.value0 /= maxVal;
-   typename GradientT::iterator gypos(gradientY.begin());
-   typename GradientT::iterator gyend(gradientY.end());
-   for(;gypos != gyend;++gypos) gypos->tuple.value0 /= maxVal;
-
-   tgt = gradientMagnitude(gradientX,gradientY);
+   GradientT gradient;
+   fusedGradient(src,kernelX,kernelY,windowSize,channel,gradient,(GradientT*)0,
+                 (const sink::OrientationBand<PrecisionT>*)0,true);
+   tgt = gradient;
 }
 
 
+// Divides (the first channel of) src by its value of rank size-clipFraction*size
+// (i.e. so that about the clipFraction largest values are clipped to 1), where
+// maxValue is (at least about) the largest value of src. The clipping point is
+// found with a QuantileHistogram of [0,maxValue].
 template<typename SrcImageT>
-void clippedNormalize(SrcImageT& src,double clipFraction) {
+void clippedNormalize(SrcImageT& src,double clipFraction,typename SrcImageT::pixel_type::value_type maxValue) {
 
    typedef typename SrcImageT::pixel_type::value_type PrecisionT;
-   typedef types::Image<types::MonochromePixel<PrecisionT> > GradientT;
+   typedef QuantileHistogram<PrecisionT>              QuantileT;
 
-   unsigned size = src.size();
-   unsigned nthStat = size - static_cast<unsigned>(clipFraction * size) + 1u;
-   typename GradientT::iterator gpos(src.begin());
-   typename GradientT::iterator gend(src.end());
-   std::vector<float> vec(size);
-   for(unsigned int i = 0;gpos != gend;++gpos,++i) {
-      vec[i] = gpos->tuple.value0;
-   }
-   // C++17 nth_element is fast order statistic O(N)
-   std::nth_element(vec.begin(),vec.begin()+nthStat,vec.end());
-   float smallestOfTheLargeVals = vec[nthStat];
+   const uint64_t size = static_cast<uint64_t>(src.rows())*src.cols();
+   if(0 == size) return;
+   const QuantileT quantiles(src,0u,static_cast<PrecisionT>(0),maxValue);
+   uint64_t nthStat = size - static_cast<uint64_t>(clipFraction * size) + 1u;
+   nthStat = std::min(nthStat,size - 1u);
+   const PrecisionT smallestOfTheLargeVals = quantiles.rank(src,nthStat);
 
    // Ok, smallestOfTheLargeVals is our clipping point
-   gpos = src.begin();
-   gend = src.end();
+   typename SrcImageT::iterator gpos(src.begin());
+   typename SrcImageT::iterator gend(src.end());
    for(;gpos != gend;++gpos) {
       if(gpos->tuple.value0 > smallestOfTheLargeVals) gpos->tuple.value0 = 1.0;
-      else gpos->tuple.value0 /= smallestOfTheLargeVals;
+      else if(smallestOfTheLargeVals > static_cast<PrecisionT>(0)) gpos->tuple.value0 /= smallestOfTheLargeVals;
+      else gpos->tuple.value0 = 0.0;
    }
 }
 
+template<typename SrcImageT>
+void clippedNormalize(SrcImageT& src,double clipFraction) {
+   typedef typename SrcImageT::pixel_type::value_type PrecisionT;
+
+   PrecisionT maxValue = static_cast<PrecisionT>(0);
+   typename SrcImageT::iterator gpos(src.begin());
+   typename SrcImageT::iterator gend(src.end());
+   for(;gpos != gend;++gpos) maxValue = std::max(maxValue,static_cast<PrecisionT>(gpos->tuple.value0));
+   clippedNormalize(src,clipFraction,maxValue);
+}
+
 
 template<typename SrcImageT,typename KernelT,typename TgtImageT>
-void edgeGradientClipped(const SrcImageT src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,double clipFraction,unsigned channel) {
+void edgeGradientClipped(const SrcImageT& src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,double clipFraction,unsigned channel) {
 
    typedef typename KernelT::pixel_type::value_type PrecisionT;
    typedef types::Image<types::MonochromePixel<PrecisionT> > GradientT;
-   PrecisionT maxVal1,maxVal2;
-   GradientT gradientX(gradientPartial<GradientT>(src,kernelX,windowSize,channel,maxVal1));
-   GradientT gradientY(gradientPartial<GradientT>(src,kernelY,windowSize,channel,maxVal2));
 
-   GradientT grad = gradientMagnitude(gradientX,gradientY);
-   clippedNormalize(grad,clipFraction);
+   GradientT grad;
+   const PrecisionT maxPartial = fusedGradient(src,kernelX,kernelY,windowSize,channel,grad,(GradientT*)0,
+                                               (const sink::OrientationBand<PrecisionT>*)0,false);
+   // Note: magnitudes are at most sqrt(2) times the largest partial gradient
+   clippedNormalize(grad,clipFraction,static_cast<PrecisionT>(maxPartial*std::sqrt(2.0)));
    tgt = grad;
 }
 
 
 template<typename SrcImageT,typename KernelT,typename TgtImageT>
-void edgeGradientAndDirection(const SrcImageT src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& gradientMag,TgtImageT& gradientDir,unsigned windowSize,unsigned channel) {
+void edgeGradientAndDirection(const SrcImageT& src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& gradientMag,TgtImageT& gradientDir,unsigned windowSize,unsigned channel) {
 
    typedef typename KernelT::pixel_type::value_type PrecisionT;
    typedef types::Image<types::MonochromePixel<PrecisionT> > GradientT;
 
-   PrecisionT maxVal1,maxVal2;
-   GradientT gradientX(gradientPartial<GradientT>(src,kernelX,windowSize,channel,maxVal1));
-   GradientT gradientY(gradientPartial<GradientT>(src,kernelY,windowSize,channel,maxVal2));
-   PrecisionT maxVal = std::max(maxVal1,maxVal2);
-
-   // TODO: do I have to worry about scaling the output? as the gradientPartial does not currently account
-   // for scaling input and output if min/max are different ranges.
-   // Now we should normalize the entire image by the maxVal.
-   typename GradientT::iterator gxpos(gradientX.begin());
-   typename GradientT::iterator gxend(gradientX.end());
-   for(;gxpos != gxend;++gxpos) gxpos->tuple.value0 /= maxVal;
-   typename GradientT::iterator gypos(gradientY.begin());
-   typename GradientT::iterator gyend(gradientY.end());
-   for(;gypos != gyend;++gypos) gypos->tuple.value0 /= maxVal;
-
-   gradientMag = gradientMagnitude(gradientX,gradientY);
-   gradientDir = gradientDirection(gradientX,gradientY);
+   GradientT magnitude;
+   GradientT direction;
+   fusedGradient(src,kernelX,kernelY,windowSize,channel,magnitude,&direction,
+                 (const sink::OrientationBand<PrecisionT>*)0,true);
+   gradientMag = magnitude;
+   gradientDir = direction;
 }
 
 template<typename SrcImageT,typename KernelT,typename TgtImageT>
-void edgeDetect(const SrcImageT src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,unsigned channel) {
+void edgeDetect(const SrcImageT& src,const KernelT& kernelX,const KernelT& kernelY,TgtImageT& tgt,unsigned windowSize,unsigned channel) {
 
    edgeGradient(src,kernelX,kernelY,tgt,windowSize,channel);
 
@@ -1217,7 +1841,7 @@ void edgeDetect(const SrcImageT src,const KernelT& kernelX,const KernelT& kernel
 // TODO: Add SFINAE check for color versus gray sources...
 #define EDGE_FUNCTION(NAME)                                                                     \
 template<typename SrcImageT,typename TgtImageT>                                                 \
-void NAME(const SrcImageT src,TgtImageT& tgt,/*edge::Kernel type,*/unsigned windowSize) {       \
+void NAME(const SrcImageT& src,TgtImageT& tgt,/*edge::Kernel type,*/unsigned windowSize) {      \
    typedef float PrecisionT;                                                                    \
    typedef types::Image<types::MonochromePixel<PrecisionT> > KernelT;                           \
                                                                                                 \
@@ -1239,9 +1863,26 @@ void NAME(const SrcImageT src,TgtImageT& tgt,/*edge::Kernel type,*/unsigned wind
 EDGE_FUNCTION(edgeGradient)
 EDGE_FUNCTION(edgeDetect)
 
+// As above, but src is first smoothed with a Gaussian of standard deviation
+// sigma (see gaussianSmooth), which suppresses noise at any scale for the same
+// cost.
+#define SMOOTHED_EDGE_FUNCTION(NAME)                                                            \
+template<typename SrcImageT,typename TgtImageT>                                                 \
+void NAME(const SrcImageT& src,TgtImageT& tgt,unsigned windowSize,float sigma) {                \
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;            \
+                                                                                                \
+   types::Image<PixelT> smoothed(src.rows(),src.cols());                                        \
+   gaussianSmooth(src,smoothed,sigma);                                                          \
+   NAME(smoothed,tgt,windowSize);                                                               \
+}                                                                                               \
+/* end of SMOOTHED_EDGE_FUNCTION */
+
+SMOOTHED_EDGE_FUNCTION(edgeGradient)
+SMOOTHED_EDGE_FUNCTION(edgeDetect)
+
 // TODO: Add SFINAE check for color versus gray sources...
 template<typename SrcImageT,typename TgtImageT>
-void edgeGradientClipped(const SrcImageT src,TgtImageT& tgt,/*edge::Kernel type,*/unsigned windowSize,double clipFraction) {
+void edgeGradientClipped(const SrcImageT& src,TgtImageT& tgt,/*edge::Kernel type,*/unsigned windowSize,double clipFraction) {
    typedef float PrecisionT;
    typedef types::Image<types::MonochromePixel<PrecisionT> > KernelT;
 
@@ -1260,15 +1901,156 @@ void edgeGradientClipped(const SrcImageT src,TgtImageT& tgt,/*edge::Kernel type,
 }
 
 
+// The Sobel gradient directions of the gray image src for the Hough
+// transforms, which are NaN (i.e. unknown) wherever the gradient is 0
+// (including the border).
+template<typename SrcImageT,typename DirectionImageT>
+void houghDirections(const SrcImageT& src,DirectionImageT& directions,unsigned windowSize) {
+   typedef float PrecisionT;
+   typedef types::Image<types::MonochromePixel<PrecisionT> > KernelT;
+
+   KernelT kernelX;
+   KernelT kernelY;
+   if(windowSize == 3) edge::sobelX(3,kernelX,kernelY);
+   else if(windowSize == 5) edge::sobelX(5,kernelX,kernelY);
+   else if(windowSize == 7) edge::sobelX(7,kernelX,kernelY);
+   else if(windowSize == 9) edge::sobelX(9,kernelX,kernelY);
+   else if(windowSize == 11) edge::sobelX(11,kernelX,kernelY);
+   else utility::fail("Sobel Edge Detection only supports windowSize 3, 5, 7, 9 and 11");
+   KernelT magnitude;
+   edgeGradientAndDirection(src,kernelX,kernelY,magnitude,directions,windowSize,SrcImageT::pixel_type::GRAY_CHANNEL);
+   for(unsigned r = 0;r < magnitude.rows();++r) {
+      for(unsigned c = 0;c < magnitude.cols();++c) {
+         if(0.0f == magnitude.pixel(r,c).tuple.value0) directions.pixel(r,c).tuple.value0 = std::numeric_limits<PrecisionT>::quiet_NaN();
+      }
+   }
+}
+
+// The edges (and their directions, as houghDirections) of the gray image src
+// for the Hough transforms: pixels whose Sobel gradient magnitude is at least
+// the Otsu threshold of the magnitudes, thinned to the maxima along their
+// gradient (non-maximum suppression), so that a step edge is about a pixel
+// wide. edges and directions are resized to src.
+template<typename SrcImageT,typename EdgeImageT,typename DirectionImageT>
+void houghEdges(const SrcImageT& src,EdgeImageT& edges,DirectionImageT& directions,unsigned windowSize) {
+   typedef float PrecisionT;
+   typedef types::Image<types::MonochromePixel<PrecisionT> > GradientT;
+   typedef types::Image<types::MonochromePixel<uint8_t> >    LevelImageT;
+   typedef typename EdgeImageT::pixel_type::value_type       EdgeValueT;
+
+   GradientT magnitude;
+   {
+      GradientT kernelX;
+      GradientT kernelY;
+      if(windowSize == 3) edge::sobelX(3,kernelX,kernelY);
+      else if(windowSize == 5) edge::sobelX(5,kernelX,kernelY);
+      else if(windowSize == 7) edge::sobelX(7,kernelX,kernelY);
+      else if(windowSize == 9) edge::sobelX(9,kernelX,kernelY);
+      else if(windowSize == 11) edge::sobelX(11,kernelX,kernelY);
+      else utility::fail("Sobel Edge Detection only supports windowSize 3, 5, 7, 9 and 11");
+      GradientT direction;
+      fusedGradient(src,kernelX,kernelY,windowSize,SrcImageT::pixel_type::GRAY_CHANNEL,magnitude,&direction,
+                    (const sink::OrientationBand<PrecisionT>*)0,true);
+      directions = direction;
+   }
+
+   // Note: normalized magnitudes are at most sqrt(2)
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   LevelImageT levels(rows,cols);
+   const PrecisionT levelScale = static_cast<PrecisionT>(255.0/std::sqrt(2.0));
+   for(unsigned r = 0;r < rows;++r) {
+      for(unsigned c = 0;c < cols;++c) {
+         const PrecisionT level = magnitude.pixel(r,c).tuple.value0*levelScale + 0.5f;
+         levels.pixel(r,c).tuple.value0 = static_cast<uint8_t>(std::min(255.0f,level));
+      }
+   }
+   const unsigned threshold = std::max(1u,otsuThreshold(levels));
+
+   edges = EdgeImageT(rows,cols);
+   const EdgeValueT on = static_cast<EdgeValueT>(EdgeImageT::pixel_type::traits::max());
+   for(unsigned r = 0;r < rows;++r) {
+      for(unsigned c = 0;c < cols;++c) {
+         const PrecisionT mag = magnitude.pixel(r,c).tuple.value0;
+         PrecisionT& direction = directions.pixel(r,c).tuple.value0;
+         if(0.0f == mag) {
+            direction = std::numeric_limits<PrecisionT>::quiet_NaN();
+            continue;
+         }
+         if(levels.pixel(r,c).tuple.value0 < threshold) continue;
+         // The neighbours along the gradient (with rows increasing upward)
+         const int dc = static_cast<int>(std::lround(std::cos(direction)));
+         const int dr = static_cast<int>(std::lround(-std::sin(direction)));
+         const int r0 = (int)r - dr, c0 = (int)c - dc, r1 = (int)r + dr, c1 = (int)c + dc;
+         const bool inside0 = r0 >= 0 && c0 >= 0 && r0 < (int)rows && c0 < (int)cols;
+         const bool inside1 = r1 >= 0 && c1 >= 0 && r1 < (int)rows && c1 < (int)cols;
+         // Note: of a plateau of equal maxima across the edge, only the last is kept
+         if(inside0 && magnitude.pixel(r0,c0).tuple.value0 > mag) continue;
+         if(inside1 && magnitude.pixel(r1,c1).tuple.value0 >= mag) continue;
+         edges.pixel(r,c).tuple.value0 = on;
+      }
+   }
+}
+
+// Finds (up to maxLines of) the lines with at least minVotes through the
+// edges of the gray image src (see houghEdges, with Sobel windowSize), prints
+// them and draws them over tgt at half intensity, and returns them. Edge
+// pixels only vote for lines within toleranceDegrees of normal to their
+// gradient (90 votes for all lines).
+template<typename SrcImageT,typename TgtImageT>
+std::vector<HoughLine> detectHoughLines(const SrcImageT& src,TgtImageT& tgt,unsigned windowSize,float toleranceDegrees,unsigned minVotes,unsigned maxLines) {
+   typedef types::Image<types::MonochromePixel<float> >   DirectionImageT;
+   typedef types::Image<types::MonochromePixel<uint8_t> > EdgeImageT;
+   typedef typename TgtImageT::pixel_type::value_type     ValueT;
+
+   EdgeImageT edges;
+   DirectionImageT directions;
+   houghEdges(src,edges,directions,windowSize);
+   const std::vector<HoughLine> lines = houghLines(edges,&directions,HOUGH_DEFAULT_THETA_BINS,
+                                                   static_cast<float>(toleranceDegrees*stdesque::numeric::pi()/180.0),minVotes,maxLines);
+   for(const HoughLine& line : lines) {
+      std::cout << "HOUGH LINE: rho " << line.rho << " theta " << line.theta*180.0/stdesque::numeric::pi()
+                << " votes " << line.votes << std::endl;
+   }
+   drawHoughLines(tgt,lines,static_cast<ValueT>(TgtImageT::pixel_type::traits::max()/2));
+   return lines;
+}
+
+// As detectHoughLines, for circles of radii in [minRadius,maxRadius] through
+// the edges of the gray image src, voting along their gradients.
+template<typename SrcImageT,typename TgtImageT>
+std::vector<HoughCircle> detectHoughCircles(const SrcImageT& src,TgtImageT& tgt,unsigned windowSize,unsigned minRadius,unsigned maxRadius,
+                                            unsigned minVotes,unsigned maxCircles) {
+   typedef types::Image<types::MonochromePixel<float> >   DirectionImageT;
+   typedef types::Image<types::MonochromePixel<uint8_t> > EdgeImageT;
+   typedef typename TgtImageT::pixel_type::value_type     ValueT;
+
+   EdgeImageT edges;
+   DirectionImageT directions;
+   houghEdges(src,edges,directions,windowSize);
+   const std::vector<HoughCircle> circles = houghCircles(edges,directions,minRadius,maxRadius,minVotes,maxCircles);
+   for(const HoughCircle& circle : circles) {
+      std::cout << "HOUGH CIRCLE: row " << circle.row << " col " << circle.col << " radius " << circle.radius
+                << " votes " << circle.votes << std::endl;
+   }
+   drawHoughCircles(tgt,circles,static_cast<ValueT>(TgtImageT::pixel_type::traits::max()/2));
+   return circles;
+}
+
+
 template<typename SrcImageT,typename TgtImageT> // maybe predicate?
-void orientedEdgeGradient(const SrcImageT src,TgtImageT& tgt/*,edge::Kernel type*/, unsigned windowSize,float lowBound, float highBound) {
+void orientedEdgeGradient(const SrcImageT& src,TgtImageT& tgt/*,edge::Kernel type*/, unsigned windowSize,float lowBound, float highBound) {
 
    typedef float PrecisionT;
    typedef types::Image<types::MonochromePixel<PrecisionT> > KernelT;
    typedef typename KernelT::pixel_type PixelT;
    typedef KernelT GradientT;
-   GradientT gradientMag(src.rows(),src.cols());
-   GradientT gradientDir(src.rows(),src.cols());
+
+   sink::OrientationBand<PrecisionT> orientation;
+   orientation.low = lowBound * stdesque::numeric::pi()/180.0;
+   orientation.high = highBound * stdesque::numeric::pi()/180.0;
+
+   GradientT gradientMag;
    /*if(type == edge::SOBEL)*/ {
       KernelT kernelX;
       KernelT kernelY;
@@ -1278,30 +2060,13 @@ void orientedEdgeGradient(const SrcImageT src,TgtImageT& tgt/*,edge::Kernel type
       else if(windowSize == 9) edge::sobelX(9,kernelX,kernelY);
       else if(windowSize == 11) edge::sobelX(11,kernelX,kernelY);
       else utility::fail("Sobel Edge Detection only supports windowSize 3, 5, 7, 9 and 11");
-      edgeGradientAndDirection(src,kernelX,kernelY,gradientMag,gradientDir,windowSize,PixelT::GRAY_CHANNEL);
-   }
-
-   highBound *= stdesque::numeric::pi()/180.0;
-   lowBound *= stdesque::numeric::pi()/180.0;
-
-   GradientT mask(src.rows(),src.cols());
-   if(highBound < lowBound) {
-      predicate::IsDisjointBetween<PixelT,PrecisionT> op;
-      op.thresholdLow = highBound;
-      op.thresholdHigh = lowBound;
-      std::transform(gradientDir.begin(),gradientDir.end(),mask.begin(),op);
-   }
-   else {
-      predicate::IsBetween<PixelT,PrecisionT> op;
-      op.thresholdLow = lowBound;
-      op.thresholdHigh = highBound;
-      std::transform(gradientDir.begin(),gradientDir.end(),mask.begin(),op);
+      fusedGradient(src,kernelX,kernelY,windowSize,PixelT::GRAY_CHANNEL,gradientMag,(GradientT*)0,&orientation,true);
    }
-   std::transform(gradientMag.begin(),gradientMag.end(),mask.begin(),tgt.begin(),predicate::Select<PixelT>());
+   tgt = gradientMag;
 }
 
 template<typename SrcImageT,typename TgtImageT> // maybe predicate?
-void orientedEdgeDetect(const SrcImageT src,TgtImageT& tgt/*,edge::Kernel type*/, unsigned windowSize,float lowBound, float highBound) {
+void orientedEdgeDetect(const SrcImageT& src,TgtImageT& tgt/*,edge::Kernel type*/, unsigned windowSize,float lowBound, float highBound) {
 
    orientedEdgeGradient(src,tgt/*,type*/,windowSize,lowBound,highBound);
 
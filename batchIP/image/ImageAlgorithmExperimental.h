@@ -1,44 +1,19 @@
 #pragma once
 
+#include "Image.h"
+#include "LookupTable.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include "utility/RadixSort.h"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
 namespace batchIP {
 namespace algorithm {
 
-template<typename PixelT,typename AccumulatorVariableTT>
-struct PixelSquareSubtractor {
-   AccumulatorVariableTT& mSquareAccumulator;
-   PixelSquareSubtractor(AccumulatorVariableTT& squareAccumulator) : mSquareAccumulator(squareAccumulator) {}
-   void operator()(const PixelT& pixel) { 
-      mSquareAccumulator -= pixel.namedColor.gray * pixel.namedColor.gray; }
-};
-
-
-template<typename PixelT,typename AccumulatorVariableTT>
-struct PixelSquareAdder {
-   AccumulatorVariableTT& mSquareAccumulator;
-   PixelSquareAdder(AccumulatorVariableTT& squareAccumulator) :  mSquareAccumulator(squareAccumulator) {}
-   void operator()(const PixelT& pixel) { 
-      mSquareAccumulator += pixel.namedColor.gray * pixel.namedColor.gray;
-   }
-};
-
-
-
-template<typename ParametricImageT>
-void initParametricImage(ParametricImageT& parImage) {
-   
-   typedef typename ParametricImageT::pixel_type PixelT;
-
-   for(unsigned r = 0; r < parImage.rows();++r) {
-      for(unsigned c = 0; c < parImage.cols();++c) {
-         PixelT& rpix = parImage.pixel(r,c);
-         rpix.row = r;
-         rpix.col = c;
-      }
-   }
-}
-
-
-
 // Computing Variance using the "Sum of Squares" method. Note:
 // that under some circumstances that this approach is numerically unstable.
 // For more details on this see:
@@ -61,39 +36,82 @@ void initParametricImage(ParametricImageT& parImage) {
 // We also expect that the bias is in the same direction for all samples, and we really
 // only care about the relative order of M^2 + S^2 terms for histogram equalization (by sorting),
 // so bias is of no concern.
+//
+// The window is centered on each pixel and shrinks symmetrically near the borders (as an
+// ElasticImageView does). Rather than moving an ElasticImageView over every pixel, the
+// squares of a window's rows are summed per column, and those column sums slide down a row
+// at a time (adding entering rows and subtracting departed rows), so that each row costs
+// O(cols) however large the window, and the window of any column comes from the prefix
+// sums of the column sums. Accumulators are 64-bit, so any window size is exact.
 template<typename ImageViewT,
-         typename PixelT = typename ImageViewT::pixel_type,
-         typename AccumulatorVariableT = typename AccumulatorVariableSelect<PixelT>::type >
+         typename PixelT = typename std::remove_const<typename ImageViewT::pixel_type>::type>
 class SumOfSquares {
 private:
-   typedef ElasticImageView<const PixelT>                     ConstElasticViewT;
-   typedef PixelSquareSubtractor<PixelT,AccumulatorVariableT> SubtractorT;
-   typedef PixelSquareAdder<PixelT,AccumulatorVariableT>      AdderT;
+   typedef uint64_t AccumulatorT;
+
+   const ImageViewT&         mSrc;
+   unsigned                  mHalfWindow;
+   unsigned                  mRow;
+   // Rows [mRowBegin,mRowEnd) are summed in mColumnSums
+   unsigned                  mRowBegin;
+   unsigned                  mRowEnd;
+   std::vector<AccumulatorT> mColumnSums;
+   std::vector<AccumulatorT> mPrefixSums; // of mColumnSums, after a leading 0
+
+   // The (symmetric) half window about position in [0,size)
+   unsigned halfWindow(unsigned position,unsigned size) const {
+      return std::min(mHalfWindow,std::min(position,size-1-position));
+   }
 
-   typename ImageViewT::const_image_view mBoundingView;
-   ConstElasticViewT                     mElasticView;
-   AccumulatorVariableT                  mSquareAccumulator;
-   SubtractorT                           mSubtractor;
-   AdderT                                mAdder;
+   void accumulateRow(unsigned row,bool add) {
+      const unsigned cols = mSrc.cols();
+      const auto srow = types::rowPixels(mSrc,row);
+      for(unsigned c = 0;c < cols;++c) {
+         const AccumulatorT value = srow[c].tuple.value0;
+         if(add) mColumnSums[c] += value*value;
+         else    mColumnSums[c] -= value*value;
+      }
+   }
+
+   void update() {
+      const unsigned half = halfWindow(mRow,mSrc.rows());
+      // Note: as the window moves down, neither of its ends ever moves up
+      while(mRowEnd < mRow + half + 1) accumulateRow(mRowEnd++,true);
+      while(mRowBegin < mRow - half) accumulateRow(mRowBegin++,false);
+      for(unsigned c = 0;c < mColumnSums.size();++c) mPrefixSums[c+1] = mPrefixSums[c] + mColumnSums[c];
+   }
 
 public:
    typedef typename PixelT::value_type value_type;
 
-   SumOfSquares(const ImageViewT& imageView,unsigned windowSize) :
-      mBoundingView(imageView),
-      mElasticView(mBoundingView.elastic_view(windowSize,windowSize)),
-      // Initialize mAccumulator with element 0,0
-      mSquareAccumulator(mElasticView.pixel(0,0).namedColor.gray*mElasticView.pixel(0,0).namedColor.gray),
-      mSubtractor(mSquareAccumulator),
-      mAdder(mSquareAccumulator)
-   {}
-
-   value_type squareAverage() {
-      return static_cast<value_type>(checkValue<PixelT>(static_cast<AccumulatorVariableT>((double) mSquareAccumulator / mElasticView.size())));
+   SumOfSquares(const ImageViewT& imageView,unsigned windowSize,unsigned row = 0) :
+      mSrc(imageView),
+      // The below subract by 1 and divide by 2 enforces odd size windows.
+      mHalfWindow((windowSize-1)/2),
+      mRow(row),
+      mRowBegin(row - halfWindow(row,imageView.rows())),
+      mRowEnd(mRowBegin),
+      mColumnSums(imageView.cols(),0u),
+      mPrefixSums(imageView.cols()+1u,0u) {
+      utility::reportIfNotLessThan("row",row,imageView.rows());
+      update();
    }
 
+   unsigned row() const { return mRow; }
+
+   // The mean of the squares of the window about (row(),col)
+   double squareAverage(unsigned col) const {
+      const unsigned cols = static_cast<unsigned>(mColumnSums.size());
+      const unsigned half = halfWindow(col,cols);
+      const AccumulatorT sum = mPrefixSums[col + half + 1] - mPrefixSums[col - half];
+      return static_cast<double>(sum)/(static_cast<double>(mRowEnd - mRowBegin)*(2*half + 1));
+   }
+
+   // Moves the window down a row
    void operator++() {
-      mElasticView.moveRight(mSubtractor,mAdder);
+      utility::reportIfNotLessThan("rows",mRow+1,mSrc.rows());
+      ++mRow;
+      update();
    }
 };
 
@@ -103,6 +121,19 @@ public:
 // dispersion(variance). Then something like the sum of the squares of the terms will be calculated
 // pixels are than sorted redistributed across the intensity channel. I believe a colleague of mine
 // Dr. Ashwin Sarma suggested a solution like this back in about 2003 when I worked for the Navy.
+//
+// So the ranking is lexicographic on intensity and then M^2 + S^2 (i.e. the mean of the
+// squares about each pixel, see SumOfSquares), which only reorders pixels of the same
+// intensity: the output preserves the order of intensities, but spreads every intensity
+// over as many output values as its count, so that the output histogram is as uniform as
+// the pixel count allows. Ties (of both) keep their raster order.
+//
+// The pipeline is linear in the number of pixels (rather than sorting by comparison):
+//   1) Sliding sums of squares (a band of rows at a time, concurrently) pack each pixel's
+//      intensity, its quantized square average and its index into a 64-bit key.
+//   2) The keys are radix sorted (see utility::radixSort) on just the intensity and square
+//      average bytes, since LSD radix sorting is stable and keys start in index order.
+//   3) The k-th of N ranked pixels gets the value floor(k*(max+1)/N), written to its index.
 template<typename SrcImageT,typename TgtImageT>
 void histogramUnify(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,
          // This ugly bit is an unnamed argument with a default which means it neither           
@@ -110,69 +141,62 @@ void histogramUnify(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,
          // point? It still participates in SFINAE to help select that this is an appropriate    
          // matching function given its arguments. Note, SFINAE techniques are incompatible with 
          // deduction so can't be applied to in parameter directly.                              
-         typename std::enable_if<is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+         typename std::enable_if<(types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                  types::is_monochrome<typename SrcImageT::pixel_type>::value) &&
+                                 is_lookup_channel<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
 
-   typedef typename SrcImageT::pixel_type PixelT;
-   typedef typename AccumulatorVariableSelect<PixelT>::type AccumulatorVariableT;
-   typedef ParametricGrayAlphaPixel<AccumulatorVariableT> IntermediatePixelT;
-   typedef Image<IntermediatePixelT> IntermediateImageT;
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+   typedef typename std::remove_const<TgtPixelT>::type::value_type          TgtValueT;
 
    utility::reportIfNotLessThan("windowSize",2u,windowSize);
    utility::reportIfNotEqual("windowSize (which should be odd)",windowSize-1,((windowSize >> 1u) << 1u));
    utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
    utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
 
-   unsigned rows = src.rows();
-   unsigned cols = src.cols();
-
-   // We can write out result to iterator operating over entire passed Image or ImageView
-   // since the iteration order is exactly the same as our loops.
-   IntermediateImageT interImage(rows,cols);
-   // Start by initializing parametric values;
-   initParametricImage(interImage);
-
-   // TODO: To Complete!!!
-//   typename TgtImageT::iterator tpos = tgt.begin();
-//
-//   // Start by smoothing along X for each row
-//   for(unsigned i = 0;i < rows;++i) {
-//      typedef SumOfSquares<SrcImageT> SquareSmoothT;
-//      typedef typename SrcImageT::image_view RowViewT;
-//      
-//      RowViewT rowView(src.view(rows-i,cols,i));
-//      SquareSmoothT squareSmooth(rowView,windowSize);
-//      // We always start with the first answer precomputed
-//      // which also implies we will only iterate and shift cols-1 times.
-//      tpos->namedColor.gray = smoothX.average();
-//      ++tpos;
-//      for(unsigned j = 1;j < cols;++j,++tpos) {
-//         ++smoothX;
-//         tpos->namedColor.gray = smoothX.average();
-//      }
-//   }
-//
-//   typedef typename TgtImageT::image_view ColumnViewT; // not strictly a Column type, but will be
-//                                                       // parameterized below to operate as one.
-//   typedef typename ColumnViewT::iterator ColumnIteratorT;
-//   // In this case our iteration order is flipped, and since we don't have a column-first
-//   // iterator type, we just need to create column views to write out our output.
-//   for(unsigned j = 0; j < cols; ++j) {
-//      typedef SmoothY<TgtImageT> SmoothYT;
-//      ColumnViewT columnView(tgt.view(rows,1,0,j));
-//      SmoothYT smoothY(columnView,windowSize);
-//      ColumnIteratorT cpos = columnView.begin();
-//      // As above, we always start with the first answer precomputed
-//      // which also implies we will only iterate and shift rows-1 times.
-//      cpos->namedColor.gray = smoothY.average();
-//      ++cpos;
-//      for(unsigned i = 1;i < rows;++i,++cpos) {
-//         ++smoothY;
-//         cpos->namedColor.gray = smoothY.average();
-//      }
-//   }
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   if(0 == rows || 0 == cols) return;
+   const uint64_t count = static_cast<uint64_t>(rows)*cols;
+   utility::reportIfNotLessThan("src.rows()*src.cols()",count,(uint64_t)UINT32_MAX);
+   const unsigned minRows = std::max(1u,(1u << 14)/cols);
+
+   // Pass 1: keys of intensity (bits 48-63), square average (32-47) and index (0-31)
+   const double maxValue = PixelT::traits::max();
+   const double squareScale = 65535.0/(maxValue*maxValue);
+   std::vector<uint64_t> keys(count);
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      SumOfSquares<SrcImageT> squares(src,windowSize,rowBegin);
+      for(unsigned r = rowBegin;;) {
+         const auto srow = types::rowPixels(src,r);
+         uint64_t* rowKeys = &keys[static_cast<std::size_t>(r)*cols];
+         for(unsigned c = 0;c < cols;++c) {
+            const uint64_t value = srow[c].tuple.value0;
+            const uint64_t square = static_cast<uint64_t>(squares.squareAverage(c)*squareScale + 0.5);
+            rowKeys[c] = (value << 48) | (square << 32) | (static_cast<uint64_t>(r)*cols + c);
+         }
+         if(++r == rowEnd) break;
+         ++squares;
+      }
+   },minRows);
+
+   // Pass 2: rank by intensity and then square average
+   utility::radixSort(keys,4u);
+
+   // Pass 3: spread the ranks uniformly over the target's values
+   const uint64_t levels = static_cast<uint64_t>(TgtPixelT::traits::max()) + 1u;
+   std::vector<TgtValueT> unified(count);
+   utility::parallelFor(0,static_cast<unsigned>(count),[&](unsigned begin,unsigned end,unsigned) {
+      for(unsigned k = begin;k < end;++k) unified[keys[k] & 0xFFFFFFFFu] = static_cast<TgtValueT>(k*levels/count);
+   },1u << 16);
+   utility::parallelFor(0,rows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      for(unsigned r = rowBegin;r < rowEnd;++r) {
+         const auto trow = types::rowPixels(tgt,r);
+         const TgtValueT* urow = &unified[static_cast<std::size_t>(r)*cols];
+         for(unsigned c = 0;c < cols;++c) trow[c].tuple.value0 = urow[c];
+      }
+   },minRows);
 }
 
-
 } // namespace algorithm
 } // namespace batchIP
-
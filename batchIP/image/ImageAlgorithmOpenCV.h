@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Image.h"
+#include "ImageAlgorithm.h"
 #include "ImageAlgorithmOpenCV.h"
 #include "Pixel.h"
 #include "utility/Error.h"
@@ -9,6 +10,10 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include <complex>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace batchIP {
 
@@ -412,14 +417,13 @@ void powerSpectrum(const SrcImageT& src, TgtImageT& tgt,
                    // deduction so can't be applied to in parameter directly.
                    typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
+   typedef types::HSIPixel<float> HSIPixelT;
    typedef types::GrayAlphaPixel<double> GrayscalePixelT;
    typedef types::Image<GrayscalePixelT> GrayscaleImage;
 
-   HSIImage hsiImage(src);
+   // Only the intensity channel is needed (and no HSI image)
    GrayscaleImage tgtMono(src.rows(),src.cols());
-   selectChannel(hsiImage,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
+   selectHSIChannel(src,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
 
    powerSpectrum(tgtMono,tgtMono);
 
@@ -634,14 +638,13 @@ void filterResponse(const SrcImageT& src, TgtImageT& tgt,double low1,double high
                     // deduction so can't be applied to in parameter directly.
                     typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
+   typedef types::HSIPixel<float> HSIPixelT;
    typedef types::GrayAlphaPixel<double> GrayscalePixelT;
    typedef types::Image<GrayscalePixelT> GrayscaleImage;
 
-   HSIImage hsiImage(src);
+   // Only the intensity channel is needed (and no HSI image)
    GrayscaleImage tgtMono(src.rows(),src.cols());
-   selectChannel(hsiImage,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
+   selectHSIChannel(src,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
 
    filterResponse(tgtMono,tgtMono,low1,high1,low2,high2);
 
@@ -724,29 +727,23 @@ void filter(const SrcImageT& src, TgtImageT& tgt,double low1,double high1, doubl
             // deduction so can't be applied to in parameter directly.
             typename std::enable_if<types::is_rgba<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
 
-   typedef types::HSIPixel<double> HSIPixelT;
-   typedef types::Image<HSIPixelT> HSIImage;
+   typedef types::HSIPixel<float> HSIPixelT;
    typedef types::GrayAlphaPixel<double> GrayscalePixelT;
    typedef types::Image<GrayscalePixelT> GrayscaleImage;
 
-   HSIImage hsiImage(src);
+   // Only the intensity channel is needed (and no HSI image)
    GrayscaleImage tgtMono(src.rows(),src.cols());
-   selectChannel(hsiImage,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
+   selectHSIChannel(src,tgtMono,(unsigned)HSIPixelT::INTENSITY_CHANNEL);
 
    filter(tgtMono,tgtMono,low1,high1,low2,high2);
 
-   // TODO: Surprisingly I don't yet have a way to assign an image to a channel,
-   // for now I'll just iterate the image and do it manually
-   auto hsipos = hsiImage.begin();
-   auto hsiend = hsiImage.end();
-   auto processedPos = tgtMono.begin();
-   for(;hsipos != hsiend;++hsipos,++processedPos) {
-      hsipos->indexedColor[HSIPixelT::INTENSITY_CHANNEL] = unitClamp(processedPos->tuple.value0);
-   }
-
+   // Second pass: stream the source through HSI again, replacing its intensity
+   // with the filtered intensity.
+   transformHSI(src,tgt,[&](unsigned row,unsigned col,float*,float*,float* intensity,unsigned count) {
+      for(unsigned k = 0;k < count;++k) intensity[k] = static_cast<float>(unitClamp(tgtMono.pixel(row,col+k).tuple.value0));
+   });
    // TODO: there still appears to be some sort of color conversion artifact (hue is swinging incorrectly)
    // need to track this down!!
-   tgt = hsiImage.defaultView();
 }
 
 
@@ -765,5 +762,247 @@ void bpFilter(const SrcImageT& src, TgtImageT& tgt,double low,double high) {
    filter(src,tgt,low,high,0.0,0.0);
 }
 
+
+/*-----------------------------------------------------------------------**/
+// Cost model used to choose between direct (vectorized or separable) and FFT-based convolution.
+// Costs are rough estimates of floating point operations, and only their ratio matters.
+namespace convolution {
+
+   // Largest DFT (per dimension) used by the overlap-add tiling
+   static const unsigned MAX_FFT_TILE_SIZE = 1024;
+
+   // Approximate number of floats processed per vector instruction in the direct path
+   static const unsigned DIRECT_VECTOR_WIDTH = 8;
+
+   inline double directCost(unsigned tgtRows,unsigned tgtCols,unsigned kernelNonzeros) {
+      return (double)tgtRows*tgtCols*kernelNonzeros/DIRECT_VECTOR_WIDTH;
+   }
+
+   // The block size (per dimension) of source data convolved per tile, given a kernel
+   // size: the fewest blocks whose DFTs are at most maxTileSize, split evenly (e.g. a
+   // 1000 pixel side and a 31 pixel kernel take 2 blocks of 500, rather than one of 994
+   // and a sliver of 6 which costs just as large a DFT).
+   inline unsigned blockSize(unsigned srcSize,unsigned kernelSize,unsigned maxTileSize = MAX_FFT_TILE_SIZE) {
+      if(srcSize + kernelSize - 1 <= maxTileSize) return srcSize;
+      unsigned largest = maxTileSize > 2*kernelSize - 1 ? maxTileSize - (kernelSize - 1) : kernelSize;
+      unsigned blocks = (srcSize + largest - 1)/largest;
+      return (srcSize + blocks - 1)/blocks;
+   }
+
+   inline unsigned dftSize(unsigned blockSize,unsigned kernelSize) {
+      return (unsigned)cv::getOptimalDFTSize(blockSize + kernelSize - 1);
+   }
+
+   inline double fftCost(unsigned srcRows,unsigned srcCols,unsigned kernelRows,unsigned kernelCols,
+                         unsigned maxTileSize = MAX_FFT_TILE_SIZE) {
+      unsigned blockRows = blockSize(srcRows,kernelRows,maxTileSize);
+      unsigned blockCols = blockSize(srcCols,kernelCols,maxTileSize);
+      double dftRows = dftSize(blockRows,kernelRows);
+      double dftCols = dftSize(blockCols,kernelCols);
+      double tiles = std::ceil((double)srcRows/blockRows) * std::ceil((double)srcCols/blockCols);
+      double points = dftRows*dftCols;
+      // A forward and an inverse real DFT (~2.5*N*log2(N) each), plus the spectrum product
+      // and the tile copies in and out.
+      return tiles * (5.0*points*std::log2(points) + 8.0*points);
+   }
+
+} // namespace convolution
+
+
+/*-----------------------------------------------------------------------**/
+// FFT-based counterpart to convolve (with identical output area and semantics), for
+// large kernels where direct convolution is too expensive.
+//
+// Uses overlap-add: the source is split into even blocks (sized so each DFT is at most
+// maxTileSize per dimension, see convolution::blockSize), each block is fully convolved with
+// the kernel via cv::dft, and the results are summed into a strip holding one band of
+// block rows (plus the kernelRows-1 rows it overlaps the next band by), whose finished
+// rows are then written to the output. The kernel's spectrum is computed once and shared
+// by all blocks.
+//
+// Note: convolve actually computes a correlation (the kernel is not flipped), so
+// the kernel is flipped here before transforming.
+template<typename SrcImageT,typename KernelT,typename TgtImageT,typename ValueT>
+void convolveFFT(const SrcImageT& src,const KernelT& kernel,TgtImageT& tgt,unsigned channel,ValueT& maxVal,
+                 unsigned maxTileSize = convolution::MAX_FFT_TILE_SIZE) {
+
+   utility::reportIfNotLessThan("kernel.rows() < src.rows()",kernel.rows(),src.rows()+1);
+   utility::reportIfNotLessThan("kernel.cols() < src.cols()",kernel.cols(),src.cols()+1);
+   utility::reportIfNotEqual("src.rows()-kernel.rows()+1 != tgt.rows()",src.rows()-kernel.rows()+1,tgt.rows());
+   utility::reportIfNotEqual("src.cols()-kernel.cols()+1 != tgt.cols()",src.cols()-kernel.cols()+1,tgt.cols());
+
+   unsigned kernelRows = kernel.rows();
+   unsigned kernelCols = kernel.cols();
+   unsigned srcRows = src.rows();
+   unsigned srcCols = src.cols();
+
+   unsigned blockRows = convolution::blockSize(srcRows,kernelRows,maxTileSize);
+   unsigned blockCols = convolution::blockSize(srcCols,kernelCols,maxTileSize);
+   int dftRows = (int)convolution::dftSize(blockRows,kernelRows);
+   int dftCols = (int)convolution::dftSize(blockCols,kernelCols);
+
+   // Spectrum of the flipped kernel
+   cv::Mat ocvKernel(dftRows,dftCols,CV_64FC1,cv::Scalar(0));
+   for(unsigned m = 0; m < kernelRows; ++m) {
+      for(unsigned n = 0; n < kernelCols; ++n) {
+         ocvKernel.at<double>(kernelRows-1-m,kernelCols-1-n) = kernel.pixel(m,n).tuple.value0;
+      }
+   }
+   cv::Mat kernelSpectrum;
+   cv::dft(ocvKernel,kernelSpectrum,cv::DFT_COMPLEX_OUTPUT,kernelRows);
+
+   // One band of block rows of the full convolution output, which the band's blocks are
+   // added into. Only the last kernelRows-1 rows of a band overlap the next band.
+   unsigned fullCols = srcCols+kernelCols-1;
+   unsigned overlapRows = kernelRows-1;
+   cv::Mat strip(blockRows+overlapRows,fullCols,CV_64FC1,cv::Scalar(0));
+
+   maxVal = static_cast<ValueT>(0);
+   cv::Mat block(dftRows,dftCols,CV_64FC1);
+   cv::Mat blockSpectrum;
+   cv::Mat product;
+   cv::Mat blockResult;
+   for(unsigned r0 = 0; r0 < srcRows; r0 += blockRows) {
+      unsigned rows = std::min(blockRows,srcRows-r0);
+      for(unsigned c0 = 0; c0 < srcCols; c0 += blockCols) {
+         unsigned cols = std::min(blockCols,srcCols-c0);
+
+         block = cv::Scalar(0);
+         for(unsigned i = 0; i < rows; ++i) {
+            double* blockRow = block.ptr<double>(i);
+            for(unsigned j = 0; j < cols; ++j) blockRow[j] = src.pixel(r0+i,c0+j).indexedColor[channel];
+         }
+         cv::dft(block,blockSpectrum,cv::DFT_COMPLEX_OUTPUT,rows);
+         cv::mulSpectrums(blockSpectrum,kernelSpectrum,product,0);
+         cv::dft(product,blockResult,cv::DFT_INVERSE + cv::DFT_SCALE + cv::DFT_REAL_OUTPUT);
+
+         // Overlap-add the full convolution of this block
+         for(unsigned i = 0; i < rows+overlapRows; ++i) {
+            const double* resultRow = blockResult.ptr<double>(i);
+            double* stripRow = strip.ptr<double>(i) + c0;
+            for(unsigned j = 0; j < cols+kernelCols-1; ++j) stripRow[j] += resultRow[j];
+         }
+      }
+
+      // The band's first rows are now complete (later bands start below them). Only the
+      // "valid" part of the full convolution is returned, just as with convolve.
+      for(unsigned i = 0; i < rows; ++i) {
+         if(r0+i < overlapRows) continue;
+         unsigned tgtRow = r0+i-overlapRows;
+         const double* stripRow = strip.ptr<double>(i) + (kernelCols-1);
+         for(unsigned j = 0; j < tgt.cols(); ++j) {
+            ValueT v = static_cast<ValueT>(stripRow[j]);
+            tgt.pixel(tgtRow,j).tuple.value0 = v;
+            if(std::abs(v) > maxVal) maxVal = std::abs(v);
+         }
+      }
+
+      // Carry the overlap into the next band, and clear the rest of the strip
+      for(unsigned i = 0; i < overlapRows; ++i) {
+         const double* from = strip.ptr<double>(rows+i);
+         std::copy(from,from+fullCols,strip.ptr<double>(i));
+      }
+      for(unsigned i = overlapRows; i < blockRows+overlapRows; ++i) {
+         double* stripRow = strip.ptr<double>(i);
+         std::fill(stripRow,stripRow+fullCols,0.0);
+      }
+   }
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Convolves with convolveSeparable, convolveVectorized or convolveFFT, whichever the
+// convolution cost model predicts is cheapest for the given image and kernel.
+template<typename SrcImageT,typename KernelT,typename TgtImageT,typename ValueT>
+void convolveAuto(const SrcImageT& src,const KernelT& kernel,TgtImageT& tgt,unsigned channel,ValueT& maxVal) {
+
+   typedef typename KernelT::pixel_type::value_type PrecisionT;
+   std::vector<SeparableTerm<PrecisionT> > terms;
+   separableDecompose(kernel,terms);
+   bool separable = convolution::preferSeparable(kernel,terms);
+   unsigned taps = separable ? convolution::separableTaps(terms) : convolution::directTaps(kernel);
+
+   double direct = convolution::directCost(tgt.rows(),tgt.cols(),taps);
+   double fft = convolution::fftCost(src.rows(),src.cols(),kernel.rows(),kernel.cols());
+   if(fft < direct) convolveFFT(src,kernel,tgt,channel,maxVal);
+   else if(separable) {
+      PrecisionT maxPrecisionVal;
+      convolveSeparable(src,terms,tgt,channel,maxPrecisionVal);
+      maxVal = static_cast<ValueT>(maxPrecisionVal);
+   }
+   else convolveVectorized(src,kernel,tgt,channel,maxVal);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Reads a convolution kernel from a text file holding its (odd) rows and cols
+// followed by its rows*cols coefficients in row order, all whitespace separated.
+template<typename KernelT>
+void readKernel(const std::string& filename,KernelT& kernel) {
+   std::ifstream kernel_file(filename.c_str());
+   if(!kernel_file.is_open()) {
+      std::stringstream ss;
+      ss << "Filename \"" << filename << "\" could not be read. Check path or permissions.";
+      throw std::invalid_argument(ss.str().c_str());
+   }
+
+   unsigned rows = 0, cols = 0;
+   kernel_file >> rows >> cols;
+   if(kernel_file.fail() || 0 == (rows & cols & 1u)) {
+      throw std::invalid_argument("Kernel file should begin with its (odd) rows and cols");
+   }
+   kernel.resize(rows,cols);
+   for(unsigned m = 0; m < rows; ++m) {
+      for(unsigned n = 0; n < cols; ++n) kernel_file >> kernel.pixel(m,n).tuple.value0;
+   }
+   if(kernel_file.fail()) throw std::invalid_argument("Kernel file has fewer coefficients than rows*cols");
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Convolves (i.e. correlates, just as convolve) the gray image src with the kernel
+// read from kernelFile (see readKernel), choosing the direct or FFT path by cost (see
+// convolveAuto), where the kernel may be as large as src. Results are rounded and
+// clamped to the pixel range, and the border of half a kernel that the kernel does
+// not cover is copied from src.
+template<typename SrcImageT,typename TgtImageT>
+void convolveKernel(const SrcImageT& src, TgtImageT& tgt,const std::string& kernelFile,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename TgtImageT::pixel_type::value_type                       ValueT;
+   typedef float                                                            PrecisionT;
+   typedef types::Image<types::MonochromePixel<PrecisionT> >                KernelT;
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   KernelT kernel;
+   readKernel(kernelFile,kernel);
+   utility::reportIfNotLessThan("kernel.rows() < src.rows()",kernel.rows(),src.rows()+1);
+   utility::reportIfNotLessThan("kernel.cols() < src.cols()",kernel.cols(),src.cols()+1);
+
+   KernelT convolved(src.rows()-kernel.rows()+1,src.cols()-kernel.cols()+1);
+   PrecisionT maxVal;
+   convolveAuto(src,kernel,convolved,PixelT::GRAY_CHANNEL,maxVal);
+
+   const unsigned halfRows = kernel.rows() >> 1u;
+   const unsigned halfCols = kernel.cols() >> 1u;
+   for(unsigned i = 0; i < src.rows(); ++i) {
+      for(unsigned j = 0; j < src.cols(); ++j) tgt.pixel(i,j) = src.pixel(i,j);
+   }
+   for(unsigned i = 0; i < convolved.rows(); ++i) {
+      for(unsigned j = 0; j < convolved.cols(); ++j) {
+         PrecisionT value = std::floor(convolved.pixel(i,j).tuple.value0 + 0.5f);
+         tgt.pixel(i+halfRows,j+halfCols).namedColor.gray = static_cast<ValueT>(checkValue<PixelT>(value));
+      }
+   }
+}
+
 } // namespace algorithm
 } // namespace batchIP
@@ -0,0 +1,759 @@
+#pragma once
+
+#include "cppTools/Platform.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define BATCHIP_SIMD_X86
+#  include <immintrin.h>
+#endif
+
+namespace batchIP {
+namespace algorithm {
+namespace simd {
+
+///////////////////////////////////////////////////////////////////////////////
+// Vectorized row primitives for the inner loops of convolution-like
+// algorithms, with runtime instruction set dispatch.
+//
+// Notes:
+// 1) Each primitive has a portable scalar version (which is also what is used
+//    for unsupported types), plus x86 versions for the instruction sets that
+//    benefit it (e.g. SSE, AVX2 and AVX-512 for float multiply-accumulate)
+//    that are compiled via target attributes, so that a single binary runs on
+//    any x86 processor.
+// 2) The instruction set is detected once at first use, but may be lowered
+//    (e.g. to compare implementations) with setInstructionSet.
+//
+enum InstructionSet {
+   SCALAR_ISA = 0,
+   SSE_ISA,
+   AVX2_ISA,
+   AVX512_ISA,
+   NUM_ISAS
+};
+
+inline bool supports(InstructionSet isa) {
+#ifdef BATCHIP_SIMD_X86
+   switch(isa) {
+      case SCALAR_ISA: return true;
+      case SSE_ISA:    return __builtin_cpu_supports("sse2");
+      case AVX2_ISA:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+      case AVX512_ISA: return __builtin_cpu_supports("avx512f");
+      default:         return false;
+   }
+#else
+   return SCALAR_ISA == isa;
+#endif
+}
+
+inline InstructionSet detectInstructionSet() {
+   if(supports(AVX512_ISA)) return AVX512_ISA;
+   if(supports(AVX2_ISA))   return AVX2_ISA;
+   if(supports(SSE_ISA))    return SSE_ISA;
+   return SCALAR_ISA;
+}
+
+inline InstructionSet& activeInstructionSet() {
+   static InstructionSet isa = detectInstructionSet();
+   return isa;
+}
+
+inline InstructionSet instructionSet() { return activeInstructionSet(); }
+
+// Returns false (and leaves the active instruction set alone) if isa is unsupported.
+inline bool setInstructionSet(InstructionSet isa) {
+   if(!supports(isa)) return false;
+   activeInstructionSet() = isa;
+   return true;
+}
+
+
+/*-----------------------------------------------------------------------**/
+// acc[i] += weight * src[i] for i in [0,count)
+template<typename ValueT>
+inline void multiplyAccumulateScalar(ValueT* acc,const ValueT* src,ValueT weight,unsigned count) {
+   for(unsigned i = 0;i < count;++i) acc[i] += weight * src[i];
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+__attribute__((target("sse2")))
+inline void multiplyAccumulateSSE(float* acc,const float* src,float weight,unsigned count) {
+   const __m128 w = _mm_set1_ps(weight);
+   unsigned i = 0;
+   for(;i + 4 <= count;i += 4) {
+      __m128 a = _mm_loadu_ps(acc + i);
+      a = _mm_add_ps(a,_mm_mul_ps(w,_mm_loadu_ps(src + i)));
+      _mm_storeu_ps(acc + i,a);
+   }
+   multiplyAccumulateScalar(acc + i,src + i,weight,count - i);
+}
+
+__attribute__((target("avx2,fma")))
+inline void multiplyAccumulateAVX2(float* acc,const float* src,float weight,unsigned count) {
+   const __m256 w = _mm256_set1_ps(weight);
+   unsigned i = 0;
+   for(;i + 8 <= count;i += 8) {
+      __m256 a = _mm256_loadu_ps(acc + i);
+      a = _mm256_fmadd_ps(w,_mm256_loadu_ps(src + i),a);
+      _mm256_storeu_ps(acc + i,a);
+   }
+   multiplyAccumulateScalar(acc + i,src + i,weight,count - i);
+}
+
+__attribute__((target("avx512f")))
+inline void multiplyAccumulateAVX512(float* acc,const float* src,float weight,unsigned count) {
+   const __m512 w = _mm512_set1_ps(weight);
+   unsigned i = 0;
+   for(;i + 16 <= count;i += 16) {
+      __m512 a = _mm512_loadu_ps(acc + i);
+      a = _mm512_fmadd_ps(w,_mm512_loadu_ps(src + i),a);
+      _mm512_storeu_ps(acc + i,a);
+   }
+   // Finish the remainder with a masked operation
+   if(i < count) {
+      __mmask16 mask = static_cast<__mmask16>((1u << (count - i)) - 1u);
+      __m512 a = _mm512_maskz_loadu_ps(mask,acc + i);
+      a = _mm512_fmadd_ps(w,_mm512_maskz_loadu_ps(mask,src + i),a);
+      _mm512_mask_storeu_ps(acc + i,mask,a);
+   }
+}
+
+#endif // BATCHIP_SIMD_X86
+
+template<typename ValueT>
+inline void multiplyAccumulate(ValueT* acc,const ValueT* src,ValueT weight,unsigned count) {
+   multiplyAccumulateScalar(acc,src,weight,count);
+}
+
+inline void multiplyAccumulate(float* acc,const float* src,float weight,unsigned count) {
+#ifdef BATCHIP_SIMD_X86
+   switch(instructionSet()) {
+      case AVX512_ISA: multiplyAccumulateAVX512(acc,src,weight,count); return;
+      case AVX2_ISA:   multiplyAccumulateAVX2(acc,src,weight,count); return;
+      case SSE_ISA:    multiplyAccumulateSSE(acc,src,weight,count); return;
+      default: break;
+   }
+#endif
+   multiplyAccumulateScalar(acc,src,weight,count);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// acc[i] += weights[i] * src[indices[i]] for i in [0,count)
+inline void multiplyAccumulateGatherScalar(float* acc,const float* src,const int* indices,const float* weights,unsigned count) {
+   for(unsigned i = 0;i < count;++i) acc[i] += weights[i] * src[indices[i]];
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+__attribute__((target("avx2,fma")))
+inline void multiplyAccumulateGatherAVX2(float* acc,const float* src,const int* indices,const float* weights,unsigned count) {
+   unsigned i = 0;
+   for(;i + 8 <= count;i += 8) {
+      const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+      __m256 a = _mm256_loadu_ps(acc + i);
+      a = _mm256_fmadd_ps(_mm256_loadu_ps(weights + i),_mm256_i32gather_ps(src,index,4),a);
+      _mm256_storeu_ps(acc + i,a);
+   }
+   multiplyAccumulateGatherScalar(acc + i,src,indices + i,weights + i,count - i);
+}
+
+__attribute__((target("avx512f")))
+inline void multiplyAccumulateGatherAVX512(float* acc,const float* src,const int* indices,const float* weights,unsigned count) {
+   for(unsigned i = 0;i < count;i += 16) {
+      const unsigned remaining = count - i;
+      const __mmask16 mask = remaining >= 16 ? __mmask16(0xFFFF) : static_cast<__mmask16>((1u << remaining) - 1u);
+      const __m512i index = _mm512_maskz_loadu_epi32(mask,indices + i);
+      const __m512 values = _mm512_mask_i32gather_ps(_mm512_setzero_ps(),mask,index,src,4);
+      __m512 a = _mm512_maskz_loadu_ps(mask,acc + i);
+      a = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask,weights + i),values,a);
+      _mm512_mask_storeu_ps(acc + i,mask,a);
+   }
+}
+
+#endif // BATCHIP_SIMD_X86
+
+inline void multiplyAccumulateGather(float* acc,const float* src,const int* indices,const float* weights,unsigned count) {
+#ifdef BATCHIP_SIMD_X86
+   switch(instructionSet()) {
+      case AVX512_ISA: multiplyAccumulateGatherAVX512(acc,src,indices,weights,count); return;
+      case AVX2_ISA:   multiplyAccumulateGatherAVX2(acc,src,indices,weights,count); return;
+      default: break;
+   }
+#endif
+   multiplyAccumulateGatherScalar(acc,src,indices,weights,count);
+}
+
+/*-----------------------------------------------------------------------**/
+// tgt[i] = max(a[i],b[i]) (if maximum is set) or min(a[i],b[i]) for i in
+// [0,count). tgt may alias a or b.
+template<typename ValueT>
+inline void extremumScalar(const ValueT* a,const ValueT* b,ValueT* tgt,unsigned count,bool maximum) {
+   if(maximum) for(unsigned i = 0;i < count;++i) tgt[i] = std::max(a[i],b[i]);
+   else        for(unsigned i = 0;i < count;++i) tgt[i] = std::min(a[i],b[i]);
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+__attribute__((target("avx2")))
+inline void extremumAVX2(const uint8_t* a,const uint8_t* b,uint8_t* tgt,unsigned count,bool maximum) {
+   unsigned i = 0;
+   for(;i + 32 <= count;i += 32) {
+      const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tgt + i),maximum ? _mm256_max_epu8(va,vb) : _mm256_min_epu8(va,vb));
+   }
+   extremumScalar(a + i,b + i,tgt + i,count - i,maximum);
+}
+
+__attribute__((target("avx2")))
+inline void extremumAVX2(const uint16_t* a,const uint16_t* b,uint16_t* tgt,unsigned count,bool maximum) {
+   unsigned i = 0;
+   for(;i + 16 <= count;i += 16) {
+      const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tgt + i),maximum ? _mm256_max_epu16(va,vb) : _mm256_min_epu16(va,vb));
+   }
+   extremumScalar(a + i,b + i,tgt + i,count - i,maximum);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void extremumAVX512(const uint8_t* a,const uint8_t* b,uint8_t* tgt,unsigned count,bool maximum) {
+   for(unsigned i = 0;i < count;i += 64) {
+      const unsigned remaining = count - i;
+      const __mmask64 mask = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1u;
+      const __m512i va = _mm512_maskz_loadu_epi8(mask,a + i);
+      const __m512i vb = _mm512_maskz_loadu_epi8(mask,b + i);
+      _mm512_mask_storeu_epi8(tgt + i,mask,maximum ? _mm512_max_epu8(va,vb) : _mm512_min_epu8(va,vb));
+   }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void extremumAVX512(const uint16_t* a,const uint16_t* b,uint16_t* tgt,unsigned count,bool maximum) {
+   for(unsigned i = 0;i < count;i += 32) {
+      const unsigned remaining = count - i;
+      const __mmask32 mask = remaining >= 32 ? ~__mmask32(0) : (__mmask32(1) << remaining) - 1u;
+      const __m512i va = _mm512_maskz_loadu_epi16(mask,a + i);
+      const __m512i vb = _mm512_maskz_loadu_epi16(mask,b + i);
+      _mm512_mask_storeu_epi16(tgt + i,mask,maximum ? _mm512_max_epu16(va,vb) : _mm512_min_epu16(va,vb));
+   }
+}
+
+#endif // BATCHIP_SIMD_X86
+
+template<typename ValueT>
+inline void extremum(const ValueT* a,const ValueT* b,ValueT* tgt,unsigned count,bool maximum) {
+   extremumScalar(a,b,tgt,count,maximum);
+}
+
+inline void extremum(const uint8_t* a,const uint8_t* b,uint8_t* tgt,unsigned count,bool maximum) {
+#ifdef BATCHIP_SIMD_X86
+   if(AVX512_ISA == instructionSet() && __builtin_cpu_supports("avx512bw")) {
+      extremumAVX512(a,b,tgt,count,maximum);
+      return;
+   }
+   if(instructionSet() >= AVX2_ISA) {
+      extremumAVX2(a,b,tgt,count,maximum);
+      return;
+   }
+#endif
+   extremumScalar(a,b,tgt,count,maximum);
+}
+
+inline void extremum(const uint16_t* a,const uint16_t* b,uint16_t* tgt,unsigned count,bool maximum) {
+#ifdef BATCHIP_SIMD_X86
+   if(AVX512_ISA == instructionSet() && __builtin_cpu_supports("avx512bw")) {
+      extremumAVX512(a,b,tgt,count,maximum);
+      return;
+   }
+   if(instructionSet() >= AVX2_ISA) {
+      extremumAVX2(a,b,tgt,count,maximum);
+      return;
+   }
+#endif
+   extremumScalar(a,b,tgt,count,maximum);
+}
+
+/*-----------------------------------------------------------------------**/
+// Table lookup over count interleaved channel values (period values per
+// pixel): tgt[i] = table[src[i]] where bit (i % period) of channelMask is
+// set, and tgt[i] = src[i] otherwise. src and tgt may alias.
+//
+// Note: the vector versions require period to divide the vector width, and
+// tables must be padded so their last entry can be loaded as 32 bits by the
+// gathers (three extra 8-bit entries, or one extra 16-bit entry).
+template<typename ValueT>
+inline void lookupScalar(const ValueT* src,ValueT* tgt,const ValueT* table,unsigned count,
+                         unsigned period,unsigned channelMask) {
+   if(1 == period && (channelMask & 1u)) {
+      for(unsigned i = 0;i < count;++i) tgt[i] = table[src[i]];
+      return;
+   }
+   for(unsigned i = 0;i < count;i += period) {
+      for(unsigned ch = 0;ch < period && i + ch < count;++ch) {
+         tgt[i+ch] = (channelMask >> ch) & 1u ? table[src[i+ch]] : src[i+ch];
+      }
+   }
+}
+
+inline bool supportsByteLookup() {
+#ifdef BATCHIP_SIMD_X86
+   return AVX512_ISA == instructionSet() &&
+          __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi");
+#else
+   return false;
+#endif
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+// 256 byte table held in four registers; permutex2var selects within a pair
+// of registers (7 bits of index), and the index's top bit selects the pair.
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+inline void lookupVBMI(const uint8_t* src,uint8_t* tgt,const uint8_t* table,unsigned count,
+                       unsigned period,unsigned channelMask) {
+   const __m512i t0 = _mm512_loadu_si512(table);
+   const __m512i t1 = _mm512_loadu_si512(table + 64);
+   const __m512i t2 = _mm512_loadu_si512(table + 128);
+   const __m512i t3 = _mm512_loadu_si512(table + 192);
+   uint64_t lanes = 0;
+   for(unsigned i = 0;i < 64;++i) if((channelMask >> (i % period)) & 1u) lanes |= uint64_t(1) << i;
+
+   unsigned i = 0;
+   for(;i < count;i += 64) {
+      const unsigned remaining = count - i;
+      const __mmask64 tail = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1u;
+      const __m512i index = _mm512_maskz_loadu_epi8(tail,src + i);
+      const __m512i low   = _mm512_permutex2var_epi8(t0,index,t1);
+      const __m512i high  = _mm512_permutex2var_epi8(t2,index,t3);
+      const __m512i value = _mm512_mask_blend_epi8(_mm512_movepi8_mask(index),low,high);
+      _mm512_mask_storeu_epi8(tgt + i,tail,_mm512_mask_blend_epi8(lanes,index,value));
+   }
+}
+
+// Gathers 32 bits per byte (scale 1) and keeps the low byte; the two halves of
+// eight gathered values are packed to 16 and then 8 bits, back in order.
+__attribute__((target("avx2")))
+inline void lookupAVX2(const uint8_t* src,uint8_t* tgt,const uint8_t* table,unsigned count,
+                       unsigned period,unsigned channelMask) {
+   int8_t lanes[16];
+   for(unsigned i = 0;i < 16;++i) lanes[i] = (channelMask >> (i % period)) & 1u ? -1 : 0;
+   const __m128i select = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+   const __m256i low8 = _mm256_set1_epi32(0xFF);
+   const int* words = reinterpret_cast<const int*>(table);
+
+   unsigned i = 0;
+   for(;i + 16 <= count;i += 16) {
+      const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m256i first  = _mm256_i32gather_epi32(words,_mm256_cvtepu8_epi32(values),1);
+      __m256i second = _mm256_i32gather_epi32(words,_mm256_cvtepu8_epi32(_mm_srli_si128(values,8)),1);
+      first  = _mm256_and_si256(first,low8);
+      second = _mm256_and_si256(second,low8);
+      const __m256i packed16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(first,second),0xD8);
+      const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(packed16),_mm256_extracti128_si256(packed16,1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(tgt + i),_mm_blendv_epi8(values,packed,select));
+   }
+   lookupScalar(src + i,tgt + i,table,count - i,period,channelMask);
+}
+
+__attribute__((target("avx2")))
+inline void lookupAVX2(const uint16_t* src,uint16_t* tgt,const uint16_t* table,unsigned count,
+                       unsigned period,unsigned channelMask) {
+   int16_t lanes[8];
+   for(unsigned i = 0;i < 8;++i) lanes[i] = (channelMask >> (i % period)) & 1u ? -1 : 0;
+   const __m128i select = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+   const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+
+   unsigned i = 0;
+   for(;i + 8 <= count;i += 8) {
+      const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m256i gathered = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table),_mm256_cvtepu16_epi32(values),2);
+      gathered = _mm256_and_si256(gathered,low16);
+      const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(gathered),_mm256_extracti128_si256(gathered,1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(tgt + i),_mm_blendv_epi8(values,packed,select));
+   }
+   lookupScalar(src + i,tgt + i,table,count - i,period,channelMask);
+}
+
+#endif // BATCHIP_SIMD_X86
+
+template<typename ValueT>
+inline void lookup(const ValueT* src,ValueT* tgt,const ValueT* table,unsigned count,unsigned period,unsigned channelMask) {
+   lookupScalar(src,tgt,table,count,period,channelMask);
+}
+
+inline void lookup(const uint8_t* src,uint8_t* tgt,const uint8_t* table,unsigned count,unsigned period,unsigned channelMask) {
+#ifdef BATCHIP_SIMD_X86
+   if(0 == 64 % period && supportsByteLookup()) {
+      lookupVBMI(src,tgt,table,count,period,channelMask);
+      return;
+   }
+   if(0 == 16 % period && instructionSet() >= AVX2_ISA) {
+      lookupAVX2(src,tgt,table,count,period,channelMask);
+      return;
+   }
+#endif
+   lookupScalar(src,tgt,table,count,period,channelMask);
+}
+
+inline void lookup(const uint16_t* src,uint16_t* tgt,const uint16_t* table,unsigned count,unsigned period,unsigned channelMask) {
+#ifdef BATCHIP_SIMD_X86
+   if(0 == 8 % period && instructionSet() >= AVX2_ISA) {
+      lookupAVX2(src,tgt,table,count,period,channelMask);
+      return;
+   }
+#endif
+   lookupScalar(src,tgt,table,count,period,channelMask);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Color distance binarization of count 8-bit RGBA pixels: a pixel is near when
+// its squared RGB distance to any of the numReferences colors (4 bytes each,
+// alpha ignored) is less than that color's limit, and is then written white,
+// otherwise red. Alpha of tgt is kept. src and tgt may alias.
+//
+// Note: channel differences fit in 16-bit lanes, and multiply-adds of those
+// sum the squares into 32-bit lanes, i.e. a pixel per 32-bit lane.
+inline void binarizeColorScalar(const uint8_t* src,uint8_t* tgt,unsigned count,
+                                const uint8_t* references,const int32_t* limits,unsigned numReferences) {
+   for(unsigned i = 0;i < count;++i,src += 4,tgt += 4) {
+      bool near = false;
+      for(unsigned k = 0;k < numReferences && !near;++k) {
+         const int32_t dr = static_cast<int32_t>(src[0]) - references[4*k];
+         const int32_t dg = static_cast<int32_t>(src[1]) - references[4*k+1];
+         const int32_t db = static_cast<int32_t>(src[2]) - references[4*k+2];
+         near = dr*dr + dg*dg + db*db < limits[k];
+      }
+      tgt[0] = 255u;
+      tgt[1] = near ? 255u : 0u;
+      tgt[2] = near ? 255u : 0u;
+   }
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+__attribute__((target("avx2")))
+inline void binarizeColorAVX2(const uint8_t* src,uint8_t* tgt,unsigned count,
+                              const uint8_t* references,const int32_t* limits,unsigned numReferences) {
+   const __m256i rbMask = _mm256_set1_epi32(0x00FF00FF);
+   const __m256i gMask  = _mm256_set1_epi32(0x000000FF);
+   const __m256i alpha  = _mm256_set1_epi32(static_cast<int32_t>(0xFF000000u));
+   const __m256i white  = _mm256_set1_epi32(0x00FFFFFF);
+   const __m256i red    = _mm256_set1_epi32(0x000000FF);
+
+   unsigned i = 0;
+   for(;i + 8 <= count;i += 8) {
+      const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4*i));
+      const __m256i rb = _mm256_and_si256(pixels,rbMask);
+      const __m256i g  = _mm256_and_si256(_mm256_srli_epi32(pixels,8),gMask);
+      __m256i near = _mm256_setzero_si256();
+      for(unsigned k = 0;k < numReferences;++k) {
+         const uint8_t* color = references + 4*k;
+         const __m256i drb = _mm256_sub_epi16(rb,_mm256_set1_epi32(color[0] | (color[2] << 16)));
+         const __m256i dg  = _mm256_sub_epi16(g,_mm256_set1_epi32(color[1]));
+         const __m256i distance = _mm256_add_epi32(_mm256_madd_epi16(drb,drb),_mm256_madd_epi16(dg,dg));
+         near = _mm256_or_si256(near,_mm256_cmpgt_epi32(_mm256_set1_epi32(limits[k]),distance));
+      }
+      const __m256i kept = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tgt + 4*i)),alpha);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tgt + 4*i),_mm256_or_si256(kept,_mm256_blendv_epi8(red,white,near)));
+   }
+   binarizeColorScalar(src + 4*i,tgt + 4*i,count - i,references,limits,numReferences);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void binarizeColorAVX512(const uint8_t* src,uint8_t* tgt,unsigned count,
+                                const uint8_t* references,const int32_t* limits,unsigned numReferences) {
+   const __m512i rbMask = _mm512_set1_epi32(0x00FF00FF);
+   const __m512i gMask  = _mm512_set1_epi32(0x000000FF);
+   const __m512i alpha  = _mm512_set1_epi32(static_cast<int32_t>(0xFF000000u));
+   const __m512i white  = _mm512_set1_epi32(0x00FFFFFF);
+   const __m512i red    = _mm512_set1_epi32(0x000000FF);
+
+   for(unsigned i = 0;i < count;i += 16) {
+      const unsigned remaining = count - i;
+      const __mmask16 tail = remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1u);
+      const __m512i pixels = _mm512_maskz_loadu_epi32(tail,src + 4*i);
+      const __m512i rb = _mm512_and_si512(pixels,rbMask);
+      // Note: the maskz form, as GCC warns of the undefined operand of _mm512_srli_epi32
+      const __m512i g  = _mm512_and_si512(_mm512_maskz_srli_epi32(__mmask16(0xFFFF),pixels,8),gMask);
+      __mmask16 near = 0;
+      for(unsigned k = 0;k < numReferences;++k) {
+         const uint8_t* color = references + 4*k;
+         const __m512i drb = _mm512_sub_epi16(rb,_mm512_set1_epi32(color[0] | (color[2] << 16)));
+         const __m512i dg  = _mm512_sub_epi16(g,_mm512_set1_epi32(color[1]));
+         const __m512i distance = _mm512_add_epi32(_mm512_madd_epi16(drb,drb),_mm512_madd_epi16(dg,dg));
+         near |= _mm512_cmplt_epi32_mask(distance,_mm512_set1_epi32(limits[k]));
+      }
+      const __m512i kept = _mm512_and_si512(_mm512_maskz_loadu_epi32(tail,tgt + 4*i),alpha);
+      _mm512_mask_storeu_epi32(tgt + 4*i,tail,_mm512_or_si512(kept,_mm512_mask_blend_epi32(near,red,white)));
+   }
+}
+
+#endif // BATCHIP_SIMD_X86
+
+inline void binarizeColor(const uint8_t* src,uint8_t* tgt,unsigned count,
+                          const uint8_t* references,const int32_t* limits,unsigned numReferences) {
+#ifdef BATCHIP_SIMD_X86
+   if(AVX512_ISA == instructionSet() && __builtin_cpu_supports("avx512bw")) {
+      binarizeColorAVX512(src,tgt,count,references,limits,numReferences);
+      return;
+   }
+   if(instructionSet() >= AVX2_ISA) {
+      binarizeColorAVX2(src,tgt,count,references,limits,numReferences);
+      return;
+   }
+#endif
+   binarizeColorScalar(src,tgt,count,references,limits,numReferences);
+}
+
+
+/*-----------------------------------------------------------------------**/
+// Polynomial approximations for the color space conversions below.
+//
+// acosApprox: Abramowitz & Stegun 4.4.46, acos(x) = sqrt(1-x) * P7(x) on [0,1]
+//             (reflected for negative x), |error| <= 2e-8 radians.
+// cosApprox:  Taylor series through x^14, |error| <= 7e-9 on [-2pi/3,2pi/3],
+//             which is the only range the HSI conversion needs.
+// Both are evaluated in float, so results are within a few float ulps (about
+// 5e-7) of the exact values.
+namespace approx {
+   const float ACOS0 =  1.5707963050f;
+   const float ACOS1 = -0.2145988016f;
+   const float ACOS2 =  0.0889789874f;
+   const float ACOS3 = -0.0501743046f;
+   const float ACOS4 =  0.0308918810f;
+   const float ACOS5 = -0.0170881256f;
+   const float ACOS6 =  0.0066700901f;
+   const float ACOS7 = -0.0012624911f;
+
+   const float COS2  = -1.0f/2.0f;
+   const float COS4  =  1.0f/24.0f;
+   const float COS6  = -1.0f/720.0f;
+   const float COS8  =  1.0f/40320.0f;
+   const float COS10 = -1.0f/3628800.0f;
+   const float COS12 =  1.0f/479001600.0f;
+   const float COS14 = -1.0f/87178291200.0f;
+
+   const float PI           = 3.14159265358979f;
+   const float TWO_PI       = 6.28318530717959f;
+   const float INV_TWO_PI   = 0.159154943091895f;
+   const float THIRD_PI     = 1.04719755119660f;
+   const float TWO_THIRDS_PI = 2.09439510239320f;
+   const float ONE_THIRD    = 1.0f/3.0f;
+   const float TWO_THIRDS   = 2.0f/3.0f;
+} // namespace approx
+
+inline float acosApprox(float x) {
+   using namespace approx;
+   x = std::max(-1.0f,std::min(1.0f,x));
+   float a = std::fabs(x);
+   float p = ((((((ACOS7*a + ACOS6)*a + ACOS5)*a + ACOS4)*a + ACOS3)*a + ACOS2)*a + ACOS1)*a + ACOS0;
+   float r = std::sqrt(1.0f - a)*p;
+   return x < 0.0f ? PI - r : r;
+}
+
+inline float cosApprox(float x) {
+   using namespace approx;
+   float x2 = x*x;
+   return ((((((COS14*x2 + COS12)*x2 + COS10)*x2 + COS8)*x2 + COS6)*x2 + COS4)*x2 + COS2)*x2 + 1.0f;
+}
+
+/*-----------------------------------------------------------------------**/
+// RGB to HSI over count values of separate (planar) channels: red, green and
+// blue are unnormalized channel values, and invMax3 is 1/(3*channel max).
+// Hue, saturation and intensity are normalized to [0,1], with saturation
+// compensated as described for HSIPixel (and rgba2hsi in PixelConversion.h).
+inline void rgb2hsiScalar(const float* red,const float* green,const float* blue,
+                          float* hue,float* saturation,float* intensity,unsigned count,float invMax3) {
+   using namespace approx;
+   for(unsigned k = 0;k < count;++k) {
+      const float r = red[k];
+      const float g = green[k];
+      const float b = blue[k];
+      const float sum = r + g + b;
+      // Note: the ratio below is scale invariant, so needs no normalization by sum
+      const float denominator = std::sqrt((r-g)*(r-g) + (r-b)*(g-b));
+      const float numerator = std::min(0.5f*((r-g) + (r-b)),denominator);
+      float h = denominator > 0.0f ? acosApprox(numerator/denominator)*INV_TWO_PI : 0.0f;
+      if(b > g) h = 1.0f - h;
+      float s = sum > 0.0f ? 1.0f - 3.0f*std::min(r,std::min(g,b))/sum : 0.0f;
+      const float i = sum*invMax3;
+      if(TWO_THIRDS < i && i < 1.0f) s = std::min(s*i/(2.0f - 2.0f*i),1.0f);
+      hue[k] = h;
+      saturation[k] = s;
+      intensity[k] = i;
+   }
+}
+
+// HSI (normalized as above) to RGB normalized to [0,1]
+inline void hsi2rgbScalar(const float* hue,const float* saturation,const float* intensity,
+                          float* red,float* green,float* blue,unsigned count) {
+   using namespace approx;
+   for(unsigned k = 0;k < count;++k) {
+      const float h = hue[k]*TWO_PI;
+      const float i = intensity[k];
+      float s = saturation[k];
+      if(TWO_THIRDS < i) s *= 2.0f/i - 2.0f;
+      const unsigned sector = h < TWO_THIRDS_PI ? 0u : (h < 2.0f*TWO_THIRDS_PI ? 1u : 2u);
+      const float h120 = h - sector*TWO_THIRDS_PI;
+      const float invHue = cosApprox(h120)/cosApprox(THIRD_PI - h120);
+      const float x = ONE_THIRD*(1.0f - s);
+      const float y = ONE_THIRD*(1.0f + s*invHue);
+      const float z = 1.0f - x - y;
+      const float i3 = 3.0f*i;
+      const float cx = std::max(0.0f,std::min(1.0f,i3*x));
+      const float cy = std::max(0.0f,std::min(1.0f,i3*y));
+      const float cz = std::max(0.0f,std::min(1.0f,i3*z));
+      if(0u == sector)      { red[k] = cy; green[k] = cz; blue[k] = cx; }
+      else if(1u == sector) { red[k] = cx; green[k] = cy; blue[k] = cz; }
+      else                  { red[k] = cz; green[k] = cx; blue[k] = cy; }
+   }
+}
+
+#ifdef BATCHIP_SIMD_X86
+
+__attribute__((target("avx2,fma")))
+inline __m256 acosAVX2(__m256 x) {
+   using namespace approx;
+   x = _mm256_max_ps(_mm256_set1_ps(-1.0f),_mm256_min_ps(_mm256_set1_ps(1.0f),x));
+   const __m256 a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f),x);
+   __m256 p = _mm256_set1_ps(ACOS7);
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS6));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS5));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS4));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS3));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS2));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS1));
+   p = _mm256_fmadd_ps(p,a,_mm256_set1_ps(ACOS0));
+   const __m256 r = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f),a)),p);
+   const __m256 negative = _mm256_cmp_ps(x,_mm256_setzero_ps(),_CMP_LT_OQ);
+   return _mm256_blendv_ps(r,_mm256_sub_ps(_mm256_set1_ps(PI),r),negative);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 cosAVX2(__m256 x) {
+   using namespace approx;
+   const __m256 x2 = _mm256_mul_ps(x,x);
+   __m256 p = _mm256_set1_ps(COS14);
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS12));
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS10));
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS8));
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS6));
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS4));
+   p = _mm256_fmadd_ps(p,x2,_mm256_set1_ps(COS2));
+   return _mm256_fmadd_ps(p,x2,_mm256_set1_ps(1.0f));
+}
+
+__attribute__((target("avx2,fma")))
+inline void rgb2hsiAVX2(const float* red,const float* green,const float* blue,
+                        float* hue,float* saturation,float* intensity,unsigned count,float invMax3) {
+   using namespace approx;
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one  = _mm256_set1_ps(1.0f);
+   unsigned k = 0;
+   for(;k + 8 <= count;k += 8) {
+      const __m256 r = _mm256_loadu_ps(red + k);
+      const __m256 g = _mm256_loadu_ps(green + k);
+      const __m256 b = _mm256_loadu_ps(blue + k);
+      const __m256 sum = _mm256_add_ps(r,_mm256_add_ps(g,b));
+      const __m256 rg = _mm256_sub_ps(r,g);
+      const __m256 rb = _mm256_sub_ps(r,b);
+      const __m256 gb = _mm256_sub_ps(g,b);
+      const __m256 denominator = _mm256_sqrt_ps(_mm256_fmadd_ps(rg,rg,_mm256_mul_ps(rb,gb)));
+      const __m256 numerator = _mm256_min_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f),_mm256_add_ps(rg,rb)),denominator);
+      // Note: lanes with a zero denominator divide by zero, but are then replaced
+      const __m256 chromatic = _mm256_cmp_ps(denominator,zero,_CMP_GT_OQ);
+      __m256 h = _mm256_mul_ps(acosAVX2(_mm256_div_ps(numerator,denominator)),_mm256_set1_ps(INV_TWO_PI));
+      h = _mm256_and_ps(h,chromatic);
+      h = _mm256_blendv_ps(h,_mm256_sub_ps(one,h),_mm256_cmp_ps(b,g,_CMP_GT_OQ));
+
+      const __m256 lit = _mm256_cmp_ps(sum,zero,_CMP_GT_OQ);
+      const __m256 minimum = _mm256_min_ps(r,_mm256_min_ps(g,b));
+      __m256 s = _mm256_sub_ps(one,_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f),minimum),sum));
+      s = _mm256_and_ps(s,lit);
+      const __m256 i = _mm256_mul_ps(sum,_mm256_set1_ps(invMax3));
+      const __m256 bright = _mm256_and_ps(_mm256_cmp_ps(_mm256_set1_ps(TWO_THIRDS),i,_CMP_LT_OQ),
+                                          _mm256_cmp_ps(i,one,_CMP_LT_OQ));
+      const __m256 compensated = _mm256_min_ps(_mm256_div_ps(_mm256_mul_ps(s,i),
+                                                             _mm256_fnmadd_ps(_mm256_set1_ps(2.0f),i,_mm256_set1_ps(2.0f))),one);
+      s = _mm256_blendv_ps(s,compensated,bright);
+
+      _mm256_storeu_ps(hue + k,h);
+      _mm256_storeu_ps(saturation + k,s);
+      _mm256_storeu_ps(intensity + k,i);
+   }
+   rgb2hsiScalar(red + k,green + k,blue + k,hue + k,saturation + k,intensity + k,count - k,invMax3);
+}
+
+__attribute__((target("avx2,fma")))
+inline void hsi2rgbAVX2(const float* hue,const float* saturation,const float* intensity,
+                        float* red,float* green,float* blue,unsigned count) {
+   using namespace approx;
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one  = _mm256_set1_ps(1.0f);
+   const __m256 third = _mm256_set1_ps(ONE_THIRD);
+   const __m256 sectorWidth = _mm256_set1_ps(TWO_THIRDS_PI);
+   unsigned k = 0;
+   for(;k + 8 <= count;k += 8) {
+      const __m256 h = _mm256_mul_ps(_mm256_loadu_ps(hue + k),_mm256_set1_ps(TWO_PI));
+      const __m256 i = _mm256_loadu_ps(intensity + k);
+      __m256 s = _mm256_loadu_ps(saturation + k);
+      const __m256 bright = _mm256_cmp_ps(_mm256_set1_ps(TWO_THIRDS),i,_CMP_LT_OQ);
+      s = _mm256_blendv_ps(s,_mm256_mul_ps(s,_mm256_sub_ps(_mm256_div_ps(_mm256_set1_ps(2.0f),i),_mm256_set1_ps(2.0f))),bright);
+
+      const __m256 sector1 = _mm256_cmp_ps(h,sectorWidth,_CMP_GE_OQ);
+      const __m256 sector2 = _mm256_cmp_ps(h,_mm256_set1_ps(2.0f*TWO_THIRDS_PI),_CMP_GE_OQ);
+      const __m256 h120 = _mm256_sub_ps(_mm256_sub_ps(h,_mm256_and_ps(sector1,sectorWidth)),
+                                        _mm256_and_ps(sector2,sectorWidth));
+      const __m256 invHue = _mm256_div_ps(cosAVX2(h120),cosAVX2(_mm256_sub_ps(_mm256_set1_ps(THIRD_PI),h120)));
+
+      const __m256 x = _mm256_mul_ps(third,_mm256_sub_ps(one,s));
+      const __m256 y = _mm256_mul_ps(third,_mm256_fmadd_ps(s,invHue,one));
+      const __m256 z = _mm256_sub_ps(_mm256_sub_ps(one,x),y);
+      const __m256 i3 = _mm256_mul_ps(_mm256_set1_ps(3.0f),i);
+      const __m256 cx = _mm256_max_ps(zero,_mm256_min_ps(one,_mm256_mul_ps(i3,x)));
+      const __m256 cy = _mm256_max_ps(zero,_mm256_min_ps(one,_mm256_mul_ps(i3,y)));
+      const __m256 cz = _mm256_max_ps(zero,_mm256_min_ps(one,_mm256_mul_ps(i3,z)));
+
+      // sector 0: (y,z,x), sector 1: (x,y,z), sector 2: (z,x,y)
+      __m256 r = _mm256_blendv_ps(_mm256_blendv_ps(cy,cx,sector1),cz,sector2);
+      __m256 g = _mm256_blendv_ps(_mm256_blendv_ps(cz,cy,sector1),cx,sector2);
+      __m256 b = _mm256_blendv_ps(_mm256_blendv_ps(cx,cz,sector1),cy,sector2);
+      _mm256_storeu_ps(red + k,r);
+      _mm256_storeu_ps(green + k,g);
+      _mm256_storeu_ps(blue + k,b);
+   }
+   hsi2rgbScalar(hue + k,saturation + k,intensity + k,red + k,green + k,blue + k,count - k);
+}
+
+#endif // BATCHIP_SIMD_X86
+
+inline void rgb2hsi(const float* red,const float* green,const float* blue,
+                    float* hue,float* saturation,float* intensity,unsigned count,float invMax3) {
+#ifdef BATCHIP_SIMD_X86
+   if(instructionSet() >= AVX2_ISA) {
+      rgb2hsiAVX2(red,green,blue,hue,saturation,intensity,count,invMax3);
+      return;
+   }
+#endif
+   rgb2hsiScalar(red,green,blue,hue,saturation,intensity,count,invMax3);
+}
+
+inline void hsi2rgb(const float* hue,const float* saturation,const float* intensity,
+                    float* red,float* green,float* blue,unsigned count) {
+#ifdef BATCHIP_SIMD_X86
+   if(instructionSet() >= AVX2_ISA) {
+      hsi2rgbAVX2(hue,saturation,intensity,red,green,blue,count);
+      return;
+   }
+#endif
+   hsi2rgbScalar(hue,saturation,intensity,red,green,blue,count);
+}
+
+} // namespace simd
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include <algorithm>
+#include <vector>
+
+namespace batchIP {
+namespace types {
+
+///////////////////////////////////////////////////////////////////////////////
+// ImagePyramid - a multi-resolution stack of an Image, where each level is
+//                half the rows and cols (rounded up) of the level beneath it.
+//
+// Notes:
+// 1) All levels share one Image (a single allocation). Level 0 occupies the
+//    left of the Image, and levels 1..N are stacked top to bottom in a column
+//    band to its right, so the whole pyramid needs about 1.5x the pixels of
+//    level 0.
+// 2) Levels are generated lazily (and incrementally) the first time they are
+//    requested, so a coarse preview only costs the levels down to it.
+// 3) Each level is exposed as an ordinary ImageView, so any algorithm may run
+//    directly on any level.
+// 4) Reduction is either a 2x2 box average or the separable 5-tap binomial
+//    (Burt-Adelson) Gaussian [1 4 6 4 1]/16. Borders are clamped.
+//
+template<typename PixelT>
+class ImagePyramid {
+public:
+   typedef typename std::remove_const<PixelT>::type pixel_type;
+   typedef Image<pixel_type>                        image_type;
+   typedef typename image_type::image_view          image_view;
+   typedef typename image_type::const_image_view    const_image_view;
+
+   enum ReduceMethod {
+      BOX_REDUCE = 0,
+      GAUSSIAN_REDUCE
+   };
+
+private:
+   typedef typename pixel_type::value_type                          ValueT;
+   typedef typename AccumulatorVariableSelect<pixel_type>::type     AccumulatorT;
+
+   struct LevelBounds {
+      unsigned rows;
+      unsigned cols;
+      unsigned rowBegin;
+      unsigned colBegin;
+   };
+
+   ReduceMethod             mMethod;
+   std::vector<LevelBounds> mLevels;
+   unsigned                 mBuiltLevels;
+   image_type               mImage;
+
+   static std::vector<LevelBounds> computeLevels(unsigned rows,unsigned cols,unsigned maxLevels) {
+      std::vector<LevelBounds> levels;
+      LevelBounds level0 = { rows, cols, 0u, 0u };
+      levels.push_back(level0);
+      unsigned rowBegin = 0u;
+      while((0 == maxLevels || levels.size() < maxLevels) &&
+            (levels.back().rows > 1u || levels.back().cols > 1u)) {
+         const LevelBounds& prior = levels.back();
+         LevelBounds level = { (prior.rows + 1u)/2u, (prior.cols + 1u)/2u, rowBegin, cols };
+         rowBegin += level.rows;
+         levels.push_back(level);
+      }
+      return levels;
+   }
+
+   static unsigned storeRows(const std::vector<LevelBounds>& levels) {
+      unsigned rows = levels.front().rows;
+      if(levels.size() > 1) rows = std::max(rows,levels.back().rowBegin + levels.back().rows);
+      return rows;
+   }
+
+   static unsigned storeCols(const std::vector<LevelBounds>& levels) {
+      unsigned cols = levels.front().cols;
+      if(levels.size() > 1) cols += levels[1].cols;
+      return cols;
+   }
+
+   // Rounds for integral channels, and simply scales for floating point channels.
+   static ValueT normalize(AccumulatorT sum,unsigned shift) {
+      const AccumulatorT divisor = static_cast<AccumulatorT>(1u << shift);
+      if(std::is_integral<ValueT>::value) return static_cast<ValueT>((sum + divisor/2)/divisor);
+      else return static_cast<ValueT>(sum/divisor);
+   }
+
+   // Note: the below operate on raw row pointers, since ImageStore rows are contiguous,
+   // which keeps the inner loops free of per-pixel bounds checks. The clamped border
+   // columns are handled apart from the main loops, which iterate pixels and then
+   // channels (a constant count), so the main loops need neither clamping nor division.
+   static void boxReducePixel(const pixel_type* srow0,const pixel_type* srow1,unsigned c0,unsigned c1,pixel_type& tgt) {
+      for(unsigned ch = 0;ch < pixel_type::MAX_CHANNELS;++ch) {
+         AccumulatorT sum = static_cast<AccumulatorT>(srow0[c0].indexedColor[ch]) +
+                            static_cast<AccumulatorT>(srow0[c1].indexedColor[ch]) +
+                            static_cast<AccumulatorT>(srow1[c0].indexedColor[ch]) +
+                            static_cast<AccumulatorT>(srow1[c1].indexedColor[ch]);
+         tgt.indexedColor[ch] = normalize(sum,2u);
+      }
+   }
+
+   void boxReduce(const image_view& src,image_view& tgt) {
+      const unsigned srcRows = src.rows();
+      const unsigned srcCols = src.cols();
+      // Target columns with both source columns inside src (all but the last for odd srcCols)
+      const unsigned pairCols = srcCols/2u;
+      for(unsigned r = 0;r < tgt.rows();++r) {
+         const pixel_type* srow0 = &src.pixel(2*r,0);
+         const pixel_type* srow1 = &src.pixel(std::min(2*r+1,srcRows-1),0);
+         pixel_type*       trow  = &tgt.pixel(r,0);
+         for(unsigned c = 0;c < pairCols;++c) boxReducePixel(srow0,srow1,2*c,2*c+1,trow[c]);
+         if(pairCols < tgt.cols()) boxReducePixel(srow0,srow1,srcCols-1,srcCols-1,trow[pairCols]);
+      }
+   }
+
+   static const AccumulatorT* gaussianTaps() {
+      static const AccumulatorT taps[5] = { 1, 4, 6, 4, 1 };
+      return taps;
+   }
+
+   // The horizontally filtered (unnormalized) target pixel c of srow with clamped source columns
+   static void gaussianFilterClamped(const pixel_type* srow,int srcCols,int c,AccumulatorT* fpixel) {
+      const AccumulatorT* taps = gaussianTaps();
+      for(unsigned ch = 0;ch < pixel_type::MAX_CHANNELS;++ch) fpixel[ch] = 0;
+      for(int k = -2;k <= 2;++k) {
+         const int sc = std::min(std::max(2*c + k,0),srcCols-1);
+         for(unsigned ch = 0;ch < pixel_type::MAX_CHANNELS;++ch) {
+            fpixel[ch] += taps[k+2]*static_cast<AccumulatorT>(srow[sc].indexedColor[ch]);
+         }
+      }
+   }
+
+   // Horizontally filters and decimates srow into frow (tgtCols pixels of unnormalized sums)
+   static void gaussianFilterRow(const pixel_type* srow,int srcCols,int tgtCols,AccumulatorT* frow) {
+      const unsigned channels = pixel_type::MAX_CHANNELS;
+      const AccumulatorT* taps = gaussianTaps();
+      // Target columns whose 5 source columns are all inside src
+      const int interiorEnd = std::max(1,(srcCols-1)/2);
+      gaussianFilterClamped(srow,srcCols,0,frow);
+      for(int c = 1;c < interiorEnd;++c) {
+         const pixel_type* s = srow + (2*c - 2);
+         AccumulatorT* f = frow + c*channels;
+         for(unsigned ch = 0;ch < channels;++ch) {
+            f[ch] = taps[0]*static_cast<AccumulatorT>(s[0].indexedColor[ch]) +
+                    taps[1]*static_cast<AccumulatorT>(s[1].indexedColor[ch]) +
+                    taps[2]*static_cast<AccumulatorT>(s[2].indexedColor[ch]) +
+                    taps[3]*static_cast<AccumulatorT>(s[3].indexedColor[ch]) +
+                    taps[4]*static_cast<AccumulatorT>(s[4].indexedColor[ch]);
+         }
+      }
+      for(int c = interiorEnd;c < tgtCols;++c) gaussianFilterClamped(srow,srcCols,c,frow + c*channels);
+   }
+
+   void gaussianReduce(const image_view& src,image_view& tgt) {
+      enum { TAPS = 5 };
+      const AccumulatorT* taps = gaussianTaps();
+      const int srcRows = static_cast<int>(src.rows());
+      const int srcCols = static_cast<int>(src.cols());
+      const unsigned tgtCols = tgt.cols();
+      const unsigned channels = pixel_type::MAX_CHANNELS;
+      const std::size_t rowSize = static_cast<std::size_t>(tgtCols)*channels;
+
+      // A ring of the last 5 horizontally filtered source rows (source row sr is kept
+      // in slot sr % 5), which are all each target row needs.
+      std::vector<AccumulatorT> filtered(TAPS*rowSize);
+      int nextRow = 0;
+      for(unsigned r = 0;r < tgt.rows();++r) {
+         const AccumulatorT* frows[TAPS];
+         for(int k = -2;k <= 2;++k) {
+            const int sr = std::min(std::max(2*static_cast<int>(r) + k,0),srcRows-1);
+            for(;nextRow <= sr;++nextRow) {
+               gaussianFilterRow(&src.pixel(nextRow,0),srcCols,static_cast<int>(tgtCols),&filtered[(nextRow % TAPS)*rowSize]);
+            }
+            frows[k+2] = &filtered[(sr % TAPS)*rowSize];
+         }
+
+         // Now vertically filter
+         pixel_type* trow = &tgt.pixel(r,0);
+         for(unsigned c = 0;c < tgtCols;++c) {
+            const std::size_t i = static_cast<std::size_t>(c)*channels;
+            for(unsigned ch = 0;ch < channels;++ch) {
+               AccumulatorT sum = taps[0]*frows[0][i+ch] + taps[1]*frows[1][i+ch] + taps[2]*frows[2][i+ch] +
+                                  taps[3]*frows[3][i+ch] + taps[4]*frows[4][i+ch];
+               trow[c].indexedColor[ch] = normalize(sum,8u);
+            }
+         }
+      }
+   }
+
+   void buildLevel(unsigned level) {
+      image_view src(levelView(level-1));
+      image_view tgt(levelView(level));
+      if(GAUSSIAN_REDUCE == mMethod) gaussianReduce(src,tgt);
+      else                           boxReduce(src,tgt);
+   }
+
+   image_view levelView(unsigned level) {
+      const LevelBounds& bounds = mLevels[level];
+      return mImage.view(bounds.rows,bounds.cols,bounds.rowBegin,bounds.colBegin);
+   }
+
+public:
+   // A maxLevels of 0 builds levels down to a 1x1 Image.
+   template<typename SrcImageT>
+   explicit ImagePyramid(const SrcImageT& src,unsigned maxLevels = 0,ReduceMethod method = BOX_REDUCE) :
+      mMethod(method),
+      mLevels(computeLevels(src.rows(),src.cols(),maxLevels)),
+      mBuiltLevels(1u),
+      mImage(storeRows(mLevels),storeCols(mLevels)) {
+      image_view level0(levelView(0));
+      level0 = src;
+   }
+
+   // Number of levels in the pyramid (whether or not they are built yet)
+   unsigned levels() const { return static_cast<unsigned>(mLevels.size()); }
+
+   // Number of levels generated so far
+   unsigned builtLevels() const { return mBuiltLevels; }
+
+   unsigned rows(unsigned level) const {
+      utility::reportIfNotLessThan("level",level,levels());
+      return mLevels[level].rows;
+   }
+
+   unsigned cols(unsigned level) const {
+      utility::reportIfNotLessThan("level",level,levels());
+      return mLevels[level].cols;
+   }
+
+   ReduceMethod method() const { return mMethod; }
+
+   // Returns a view of the requested level, generating it (and any finer
+   // levels preceding it) on demand.
+   image_view level(unsigned level) {
+      utility::reportIfNotLessThan("level",level,levels());
+      for(;mBuiltLevels <= level;++mBuiltLevels) buildLevel(mBuiltLevels);
+      return levelView(level);
+   }
+
+   // The Image backing all levels of the pyramid
+   const image_type& image() const { return mImage; }
+};
+
+} // namespace types
+} // namespace batchIP
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Channel.h"
+#include "utility/Error.h"
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace types {
+
+///////////////////////////////////////////////////////////////////////////////
+// IntegralImage - a summed-area table of one channel of an Image (or any view),
+//                 and optionally of its squares, so that the sum (and sum of
+//                 squares) of any rectangular window is computed in O(1).
+//
+// Notes:
+// 1) Both tables are built in a single pass over the source.
+// 2) Tables are (rows+1)x(cols+1) with a zero first row and column, so that
+//    windows on the image border need no special cases.
+// 3) Accumulators are the BigAccumulator types (64-bit for integral channels,
+//    double for floating point), so that sums of squares of 16-bit data do
+//    not overflow for any practical image size.
+//
+template<typename PixelT,
+         typename AccumulatorT = typename BigAccumulatorVariableSelect<typename std::remove_const<PixelT>::type>::type>
+class IntegralImage {
+public:
+   typedef typename std::remove_const<PixelT>::type pixel_type;
+   typedef AccumulatorT                             accumulator_type;
+
+private:
+   unsigned                  mRows;
+   unsigned                  mCols;
+   unsigned                  mStride; // mCols+1
+   std::vector<AccumulatorT> mSums;
+   std::vector<AccumulatorT> mSquares;
+
+   std::size_t index(unsigned row,unsigned col) const { return static_cast<std::size_t>(row)*mStride + col; }
+
+   AccumulatorT windowSum(const std::vector<AccumulatorT>& table,
+                          unsigned rowBegin,unsigned colBegin,unsigned rows,unsigned cols) const {
+      utility::reportIfNotLessThan("rowBegin+rows",rowBegin + rows,mRows+1);
+      utility::reportIfNotLessThan("colBegin+cols",colBegin + cols,mCols+1);
+      unsigned rowEnd = rowBegin + rows;
+      unsigned colEnd = colBegin + cols;
+      // Note: ordering the additions first avoids wrapping unsigned accumulators.
+      return (table[index(rowEnd,colEnd)] + table[index(rowBegin,colBegin)]) -
+             (table[index(rowBegin,colEnd)] + table[index(rowEnd,colBegin)]);
+   }
+
+public:
+   template<typename SrcImageT>
+   explicit IntegralImage(const SrcImageT& src,unsigned channel = 0,bool computeSquares = true) :
+      mRows(src.rows()),
+      mCols(src.cols()),
+      mStride(src.cols()+1),
+      mSums(static_cast<std::size_t>(mRows+1)*mStride,AccumulatorT(0)),
+      mSquares(computeSquares ? mSums.size() : 0u,AccumulatorT(0)) {
+
+      for(unsigned i = 0; i < mRows; ++i) {
+         // Running sums of the current row, added to the table row above
+         AccumulatorT rowSum = 0;
+         AccumulatorT rowSquares = 0;
+         const AccumulatorT* above = &mSums[index(i,0)];
+         AccumulatorT* current = &mSums[index(i+1,0)];
+         for(unsigned j = 0; j < mCols; ++j) {
+            AccumulatorT v = static_cast<AccumulatorT>(src.pixel(i,j).indexedColor[channel]);
+            rowSum += v;
+            current[j+1] = above[j+1] + rowSum;
+            if(computeSquares) {
+               rowSquares += v*v;
+               mSquares[index(i+1,j+1)] = mSquares[index(i,j+1)] + rowSquares;
+            }
+         }
+      }
+   }
+
+   unsigned rows() const { return mRows; }
+
+   unsigned cols() const { return mCols; }
+
+   bool hasSquares() const { return !mSquares.empty(); }
+
+   // Sum of the window of size rows x cols whose top-left corner is (rowBegin,colBegin)
+   AccumulatorT sum(unsigned rowBegin,unsigned colBegin,unsigned rows,unsigned cols) const {
+      return windowSum(mSums,rowBegin,colBegin,rows,cols);
+   }
+
+   AccumulatorT sumOfSquares(unsigned rowBegin,unsigned colBegin,unsigned rows,unsigned cols) const {
+      utility::reportIfEqual("sumOfSquares requires computeSquares",hasSquares(),false);
+      return windowSum(mSquares,rowBegin,colBegin,rows,cols);
+   }
+
+   double mean(unsigned rowBegin,unsigned colBegin,unsigned rows,unsigned cols) const {
+      return static_cast<double>(sum(rowBegin,colBegin,rows,cols)) / (static_cast<double>(rows)*cols);
+   }
+
+   // Population variance of the window
+   double variance(unsigned rowBegin,unsigned colBegin,unsigned rows,unsigned cols) const {
+      double n = static_cast<double>(rows)*cols;
+      double m = mean(rowBegin,colBegin,rows,cols);
+      double v = static_cast<double>(sumOfSquares(rowBegin,colBegin,rows,cols)) / n - m*m;
+      return v > 0.0 ? v : 0.0;
+   }
+};
+
+} // namespace types
+} // namespace batchIP
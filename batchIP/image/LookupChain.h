@@ -0,0 +1,134 @@
+#pragma once
+
+#include "utility/StringParse.h"
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace batchIP {
+namespace operation {
+
+///////////////////////////////////////////////////////////////////////////////
+// Chains of point operations
+//
+// Consecutive lines of an operations file that each apply a point operation
+// (add, binarize, binarizeDT, histMod) to the whole image, where each line
+// reads the file the previous line wrote, may be composed into a single
+// LookupTable and applied in one pass. The intermediate files are only
+// skipped when no other line reads them.
+//
+// Note: chains are planned from the lines alone, before any of them runs (so
+// before earlier lines may have written the files later lines read). Whether
+// a chain processes a grayscale image may depend on its input file, so it is
+// only settled (see isLookupChain) when processing reaches the chain.
+//
+
+struct OperationLine {
+   std::string line;
+   std::string inputfile;
+   std::string outputfile;
+   std::string operation;
+   bool        hasROI;
+};
+
+// Lines [first,first+count) of an operations file, whose operations (one per
+// line that isn't a comment or blank) may compose into one LookupTable.
+struct LookupChain {
+   unsigned                   first;
+   unsigned                   count;
+   std::vector<OperationLine> operations;
+};
+
+// Returns false for comments and lines that don't parse (which are then
+// left to the caller to report).
+inline bool parseOperationLine(const std::string& line,OperationLine& op) {
+   std::stringstream ss;
+   ss << line;
+   try {
+      op.line = line;
+      op.inputfile = utility::parseWord<std::string>(ss);
+      if(utility::startsWith(op.inputfile,"#")) return false;
+      op.outputfile = utility::parseWord<std::string>(ss);
+      op.operation = utility::parseWord<std::string>(ss);
+   }
+   catch(const utility::ParseError& pe) {
+      return false;
+   }
+   op.hasROI = line.find("ROI:") != std::string::npos;
+   return true;
+}
+
+inline bool isLookupOperation(const std::string& operation,bool grayscale) {
+   return (operation == "add")     ||
+          (operation == "histMod") ||
+          (grayscale && ((operation == "binarize") || (operation == "binarizeDT")));
+}
+
+// Whether all operations of chain compose for a grayscale (or color) image.
+inline bool isLookupChain(const LookupChain& chain,bool grayscale) {
+   for(const OperationLine& op : chain.operations) {
+      if(!isLookupOperation(op.operation,grayscale)) return false;
+   }
+   return true;
+}
+
+// Finds the chains of (at least two) point operations among lines, in order,
+// where isGrayscaleOperation(operation) tells which operations always process
+// grayscale images (so binarize and binarizeDT chain only if it says so).
+//
+// The lines reading each file are counted once up front, so planning is
+// linear in the number of lines.
+template<typename IsGrayscaleOperationT>
+std::vector<LookupChain> planLookupChains(const std::vector<std::string>& lines,IsGrayscaleOperationT isGrayscaleOperation) {
+
+   std::vector<OperationLine> parsed(lines.size());
+   std::vector<bool>          parses(lines.size());
+   std::map<std::string,unsigned> readers;
+   for(unsigned i = 0;i < lines.size();++i) {
+      parses[i] = parseOperationLine(lines[i],parsed[i]);
+      if(parses[i]) ++readers[parsed[i].inputfile];
+   }
+
+   auto chainable = [&](const OperationLine& op) {
+      return !op.hasROI && isLookupOperation(op.operation,isGrayscaleOperation(op.operation));
+   };
+
+   std::vector<LookupChain> chains;
+   for(unsigned first = 0;first < lines.size();) {
+      if(!parses[first] || !chainable(parsed[first])) {
+         ++first;
+         continue;
+      }
+      LookupChain chain;
+      chain.first = first;
+      chain.operations.push_back(parsed[first]);
+
+      unsigned last = first;
+      for(unsigned next = first + 1;next < lines.size();++next) {
+         if(!parses[next]) {
+            // Skip over comments and blank lines
+            if(lines[next].empty() || utility::startsWith(lines[next],"#")) continue;
+            break;
+         }
+         const OperationLine& prior = chain.operations.back();
+         const OperationLine& candidate = parsed[next];
+         if(!chainable(candidate) || candidate.inputfile != prior.outputfile || prior.inputfile == prior.outputfile ||
+            readers[prior.outputfile] != 1) break;
+         chain.operations.push_back(candidate);
+         last = next;
+      }
+
+      if(chain.operations.size() < 2) {
+         ++first;
+         continue;
+      }
+      chain.count = last - first + 1;
+      first += chain.count;
+      chains.push_back(chain);
+   }
+   return chains;
+}
+
+} // namespace operation
+} // namespace batchIP
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Image.h"
+#include "ImageAlgorithmSIMD.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+// Channel types whose every value can be enumerated in a LookupTable
+template<typename ValueT>
+struct is_lookup_channel : public std::integral_constant<bool,std::is_integral<ValueT>::value &&
+                                                              std::is_unsigned<ValueT>::value &&
+                                                              sizeof(ValueT) <= 2> {};
+
+// The channels a point operation applies to by default: gray for grayscale and
+// monochrome pixels, and red, green and blue (but not alpha) for RGBA pixels.
+template<typename PixelT>
+inline unsigned colorChannelMask() {
+   if(types::is_rgba<PixelT>::value) return 0x7u;
+   return 0x1u;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LookupTable - the output value of a point operation for every input value
+//               of an 8-bit (256 entries) or 16-bit (65536 entries) channel.
+//
+// Notes:
+// 1) A point operation is any mapping where each output channel depends only
+//    on the same input channel, so the (possibly expensive) mapping is
+//    evaluated once per value rather than once per pixel.
+// 2) Tables are applied a row at a time with simd::lookup (byte permutes
+//    on AVX-512 VBMI, gathers on AVX2).
+//
+template<typename ValueT>
+class LookupTable {
+public:
+   typedef ValueT value_type;
+
+   enum { ENTRIES = static_cast<unsigned>(std::numeric_limits<ValueT>::max()) + 1u };
+
+private:
+   // Note: vector gathers load 32 bits at a time, so the last entry is followed
+   // by padding (three 8-bit or one 16-bit entries)
+   enum { PADDING = sizeof(int32_t)/sizeof(ValueT) - 1u };
+   std::vector<ValueT> mTable;
+
+public:
+   // Identity mapping
+   LookupTable() : mTable(ENTRIES+PADDING,0) {
+      static_assert(is_lookup_channel<ValueT>::value,"LookupTable requires 8- or 16-bit unsigned channels");
+      for(unsigned v = 0;v < ENTRIES;++v) mTable[v] = static_cast<ValueT>(v);
+   }
+
+   // Tabulates func (ValueT -> ValueT) over all values
+   template<typename FuncT>
+   explicit LookupTable(FuncT func) : mTable(ENTRIES+PADDING,0) {
+      static_assert(is_lookup_channel<ValueT>::value,"LookupTable requires 8- or 16-bit unsigned channels");
+      for(unsigned v = 0;v < ENTRIES;++v) mTable[v] = func(static_cast<ValueT>(v));
+   }
+
+   unsigned size() const { return ENTRIES; }
+
+   ValueT operator[](unsigned value) const { return mTable[value]; }
+
+   ValueT& operator[](unsigned value) { return mTable[value]; }
+
+   const ValueT* data() const { return &mTable[0]; }
+};
+
+// The table of applying first and then second (i.e. second(first(value)))
+template<typename ValueT>
+LookupTable<ValueT> compose(const LookupTable<ValueT>& first,const LookupTable<ValueT>& second) {
+   LookupTable<ValueT> composed;
+   for(unsigned v = 0;v < composed.size();++v) composed[v] = second[first[v]];
+   return composed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LookupTableCache - LookupTables keyed by their parameters (e.g. each ROI's
+//                    ParameterPack), so that each is only built once.
+//
+template<typename ValueT,typename KeyT>
+class LookupTableCache {
+public:
+   typedef LookupTable<ValueT> table_type;
+
+private:
+   std::map<KeyT,table_type> mTables;
+
+public:
+   // Returns the table for key, calling make() to build it if not yet cached
+   template<typename MakeT>
+   const table_type& table(const KeyT& key,MakeT make) {
+      typename std::map<KeyT,table_type>::iterator pos = mTables.find(key);
+      if(pos == mTables.end()) pos = mTables.insert(std::make_pair(key,make())).first;
+      return pos->second;
+   }
+
+   unsigned size() const { return static_cast<unsigned>(mTables.size()); }
+};
+
+
+/*-----------------------------------------------------------------------**/
+// Maps the channels selected by channelMask through table, and copies the
+// other channels from src.
+template<typename SrcImageT,typename TgtImageT,typename ValueT>
+void applyLookupTable(const SrcImageT& src,TgtImageT& tgt,const LookupTable<ValueT>& table,unsigned channelMask) {
+   typedef typename SrcImageT::pixel_type              SrcPixelT;
+   typedef typename TgtImageT::pixel_type              TgtPixelT;
+   typedef typename std::remove_const<SrcPixelT>::type PixelT;
+
+   static_assert(std::is_same<PixelT,typename std::remove_const<TgtPixelT>::type>::value,"src and tgt must have the same pixel type");
+   static_assert(std::is_same<typename PixelT::value_type,ValueT>::value,"table must be of the channel type");
+   static_assert(sizeof(PixelT) % sizeof(ValueT) == 0,"pixels must be packed channels");
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   // Note: some pixels have unused channel slots (e.g. HSI), which are simply copied
+   const unsigned channels = sizeof(PixelT)/sizeof(ValueT);
+   for(unsigned r = 0;r < rows;++r) {
+      const auto srow = types::rowPixels(src,r);
+      const auto trow = types::rowPixels(tgt,r);
+      // Rows of Images and ImageViews are contiguous, but not those of strided views
+      if(1 == srow.step && 1 == trow.step) {
+         simd::lookup(&srow.first->indexedColor[0],&trow.first->indexedColor[0],table.data(),cols*channels,channels,channelMask);
+      }
+      else {
+         for(unsigned c = 0;c < cols;++c) {
+            const SrcPixelT& spixel = srow[c];
+            TgtPixelT&       tpixel = trow[c];
+            simd::lookupScalar(&spixel.indexedColor[0],&tpixel.indexedColor[0],table.data(),channels,channels,channelMask);
+         }
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------**/
+// Applies the point operation func (ValueT -> ValueT) to the channels selected
+// by channelMask, and copies the other channels from src. For 8- and 16-bit
+// channels func is tabulated first.
+template<typename SrcImageT,typename TgtImageT,typename FuncT>
+void pointOperation(const SrcImageT& src,TgtImageT& tgt,FuncT func,unsigned channelMask,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<is_lookup_channel<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+   applyLookupTable(src,tgt,LookupTable<typename SrcImageT::pixel_type::value_type>(func),channelMask);
+}
+
+template<typename SrcImageT,typename TgtImageT,typename FuncT>
+void pointOperation(const SrcImageT& src,TgtImageT& tgt,FuncT func,unsigned channelMask,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<!is_lookup_channel<typename SrcImageT::pixel_type::value_type>::value,int>::type* = 0) {
+
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   typename SrcImageT::const_iterator spos(src.begin());
+   typename SrcImageT::const_iterator send(src.end());
+   typename TgtImageT::iterator       tpos(tgt.begin());
+   for(;spos != send;++spos,++tpos) {
+      *tpos = *spos;
+      for(unsigned ch = 0;ch < SrcImageT::pixel_type::MAX_CHANNELS;++ch) {
+         if((channelMask >> ch) & 1u) tpos->indexedColor[ch] = func(spos->indexedColor[ch]);
+      }
+   }
+}
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Image.h"
+#include "ImageAlgorithmSIMD.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Transpose.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+enum MorphologyOperation {
+   MORPHOLOGY_ERODE = 0, // minimum over the structuring element
+   MORPHOLOGY_DILATE,    // maximum over the structuring element
+   MORPHOLOGY_OPEN,      // erode then dilate
+   MORPHOLOGY_CLOSE,     // dilate then erode
+   MORPHOLOGY_TOP_HAT,   // src minus its opening
+   NUM_MORPHOLOGY_OPERATIONS
+};
+
+namespace detail {
+
+   // van Herk/Gil-Werman running minimum (or maximum) over windowSize rows of
+   // the rows x cols plane, computed for all columns at once (each step is a
+   // simd::extremum of whole rows). The plane is split into blocks of
+   // windowSize rows, within which prefix and suffix extrema are accumulated,
+   // so that each window is the extremum of one suffix and one prefix: 3
+   // operations per pixel for any windowSize.
+   //
+   // Note: windows are clipped at the borders (i.e. the plane is padded with
+   // the neutral value of the operation).
+   template<typename ValueT>
+   void extremumColumns(std::vector<ValueT>& plane,unsigned rows,unsigned cols,unsigned windowSize,bool maximum) {
+      if(windowSize < 2 || 0 == rows || 0 == cols) return;
+
+      const unsigned half = windowSize >> 1u;
+      const ValueT neutral = maximum ? std::numeric_limits<ValueT>::lowest() : std::numeric_limits<ValueT>::max();
+      const std::vector<ValueT> neutralRow(cols,neutral);
+      // Rows of the padded plane: half a window before and after, rounded up to whole blocks
+      const unsigned padded = ((rows + 2*half + windowSize - 1)/windowSize)*windowSize;
+      std::vector<ValueT> prefix(static_cast<std::size_t>(padded)*cols);
+      std::vector<ValueT> suffix(static_cast<std::size_t>(padded)*cols);
+      auto paddedRow = [&](unsigned p) -> const ValueT* {
+         return p >= half && p - half < rows ? &plane[static_cast<std::size_t>(p - half)*cols] : &neutralRow[0];
+      };
+      auto row = [&](std::vector<ValueT>& buffer,unsigned p) -> ValueT* { return &buffer[static_cast<std::size_t>(p)*cols]; };
+
+      for(unsigned block = 0;block < padded;block += windowSize) {
+         const unsigned last = block + windowSize - 1;
+         std::copy(paddedRow(block),paddedRow(block) + cols,row(prefix,block));
+         for(unsigned p = block + 1;p <= last;++p) simd::extremum(row(prefix,p-1),paddedRow(p),row(prefix,p),cols,maximum);
+         std::copy(paddedRow(last),paddedRow(last) + cols,row(suffix,last));
+         for(unsigned p = last;p-- > block;) simd::extremum(row(suffix,p+1),paddedRow(p),row(suffix,p),cols,maximum);
+      }
+      // The window of row r is padded rows [r,r+2*half]
+      for(unsigned r = 0;r < rows;++r) {
+         simd::extremum(row(suffix,r),row(prefix,r + 2*half),&plane[static_cast<std::size_t>(r)*cols],cols,maximum);
+      }
+   }
+
+   // Erodes (or dilates) the plane by a seRows x seCols rectangle, which is
+   // separable: columns are done in place, and rows as the columns of the
+   // transposed plane.
+   template<typename ValueT>
+   void extremumPlane(std::vector<ValueT>& plane,unsigned rows,unsigned cols,unsigned seRows,unsigned seCols,bool maximum) {
+      extremumColumns(plane,rows,cols,seRows,maximum);
+      if(seCols > 1) {
+         std::vector<ValueT> transposed(plane.size());
+         utility::transposePlane(&plane[0],&transposed[0],rows,cols);
+         extremumColumns(transposed,cols,rows,seCols,maximum);
+         utility::transposePlane(&transposed[0],&plane[0],cols,rows);
+      }
+   }
+
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Grayscale morphology of src by a seRows x seCols rectangular structuring
+// element (centered on each pixel, and clipped at the borders). The cost per
+// pixel does not depend on the size of the structuring element (see
+// detail::extremumColumns).
+template<typename SrcImageT,typename TgtImageT>
+void morphology(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols,MorphologyOperation operation,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                 types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename PixelT::value_type                                      ValueT;
+
+   utility::reportIfNotLessThan("seRows",0u,seRows);
+   utility::reportIfNotLessThan("seCols",0u,seCols);
+   utility::reportIfNotEqual("seRows (which should be odd)",seRows-1,((seRows >> 1u) << 1u));
+   utility::reportIfNotEqual("seCols (which should be odd)",seCols-1,((seCols >> 1u) << 1u));
+   utility::reportIfNotLessThan("operation",(unsigned)operation,(unsigned)NUM_MORPHOLOGY_OPERATIONS);
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   if(0 == rows || 0 == cols) return;
+   std::vector<ValueT> plane(static_cast<std::size_t>(rows)*cols);
+   for(unsigned r = 0;r < rows;++r) {
+      const auto srow = types::rowPixels(src,r);
+      ValueT* prow = &plane[static_cast<std::size_t>(r)*cols];
+      for(unsigned c = 0;c < cols;++c) prow[c] = srow[c].tuple.value0;
+   }
+
+   switch(operation) {
+      case MORPHOLOGY_ERODE:
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,false);
+         break;
+      case MORPHOLOGY_DILATE:
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,true);
+         break;
+      case MORPHOLOGY_CLOSE:
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,true);
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,false);
+         break;
+      default: // MORPHOLOGY_OPEN and MORPHOLOGY_TOP_HAT
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,false);
+         detail::extremumPlane(plane,rows,cols,seRows,seCols,true);
+         break;
+   }
+
+   // Note: the opening is never larger than src, so the top hat is not negative
+   for(unsigned r = 0;r < rows;++r) {
+      const auto srow = types::rowPixels(src,r);
+      const auto trow = types::rowPixels(tgt,r);
+      const ValueT* prow = &plane[static_cast<std::size_t>(r)*cols];
+      for(unsigned c = 0;c < cols;++c) {
+         if(MORPHOLOGY_TOP_HAT == operation) trow[c].tuple.value0 = static_cast<ValueT>(srow[c].tuple.value0 - prow[c]);
+         else                                trow[c].tuple.value0 = prow[c];
+      }
+   }
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void erode(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols) {
+   morphology(src,tgt,seRows,seCols,MORPHOLOGY_ERODE);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void dilate(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols) {
+   morphology(src,tgt,seRows,seCols,MORPHOLOGY_DILATE);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void opening(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols) {
+   morphology(src,tgt,seRows,seCols,MORPHOLOGY_OPEN);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void closing(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols) {
+   morphology(src,tgt,seRows,seCols,MORPHOLOGY_CLOSE);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void topHat(const SrcImageT& src, TgtImageT& tgt,unsigned seRows,unsigned seCols) {
+   morphology(src,tgt,seRows,seCols,MORPHOLOGY_TOP_HAT);
+}
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "Image.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+///////////////////////////////////////////////////////////////////////////////
+// RankHistogram - a sliding histogram of 8-bit values from which order
+//                 statistics (e.g. the median) are read.
+//
+// Notes:
+// 1) Values are added and removed one at a time as a window slides (Huang),
+//    or whole histograms at a time (Perreault's column histograms).
+// 2) A coarse level of 16 bins (of 16 values each) is kept alongside the 256
+//    fine bins, so that rank finds any order statistic in at most 32 steps.
+// 3) Counts are 16-bit, so at most 65535 values (i.e. windows up to 255x255)
+//    may be counted.
+//
+class RankHistogram {
+public:
+   enum { BINS = 256 };
+   enum { COARSE_BINS = 16 };
+   enum { COARSE_SHIFT = 4 };
+
+private:
+   uint16_t mCoarse[COARSE_BINS];
+   uint16_t mFine[BINS];
+   unsigned mTotal;
+
+public:
+   RankHistogram() : mTotal(0) {
+      std::fill(mCoarse,mCoarse + COARSE_BINS,0u);
+      std::fill(mFine,mFine + BINS,0u);
+   }
+
+   void add(uint8_t value) {
+      ++mCoarse[value >> COARSE_SHIFT];
+      ++mFine[value];
+      ++mTotal;
+   }
+
+   void remove(uint8_t value) {
+      --mCoarse[value >> COARSE_SHIFT];
+      --mFine[value];
+      --mTotal;
+   }
+
+   void add(const RankHistogram& that) {
+      for(unsigned i = 0;i < COARSE_BINS;++i) mCoarse[i] += that.mCoarse[i];
+      for(unsigned i = 0;i < BINS;++i) mFine[i] += that.mFine[i];
+      mTotal += that.mTotal;
+   }
+
+   void subtract(const RankHistogram& that) {
+      for(unsigned i = 0;i < COARSE_BINS;++i) mCoarse[i] -= that.mCoarse[i];
+      for(unsigned i = 0;i < BINS;++i) mFine[i] -= that.mFine[i];
+      mTotal -= that.mTotal;
+   }
+
+   unsigned total() const { return mTotal; }
+
+   // The k-th smallest (from 0) value counted
+   uint8_t rank(unsigned k) const {
+      utility::reportIfNotLessThan("rank",k,mTotal);
+      unsigned coarse = 0;
+      for(;k >= mCoarse[coarse];++coarse) k -= mCoarse[coarse];
+      unsigned value = coarse << COARSE_SHIFT;
+      for(;k >= mFine[value];++value) k -= mFine[value];
+      return static_cast<uint8_t>(value);
+   }
+};
+
+// Listeners (see ElasticImageView::moveRight and moveDown) that keep a
+// RankHistogram of the pixels of an elastic window.
+template<typename PixelT>
+struct HistogramAdder {
+   RankHistogram& mHistogram;
+   explicit HistogramAdder(RankHistogram& histogram) : mHistogram(histogram) {}
+   void operator()(const PixelT& pixel) { mHistogram.add(pixel.tuple.value0); }
+};
+
+template<typename PixelT>
+struct HistogramRemover {
+   RankHistogram& mHistogram;
+   explicit HistogramRemover(RankHistogram& histogram) : mHistogram(histogram) {}
+   void operator()(const PixelT& pixel) { mHistogram.remove(pixel.tuple.value0); }
+};
+
+
+/*-----------------------------------------------------------------------**/
+// Replaces each pixel by the value at percentile (0 is the minimum, 50 the
+// median and 100 the maximum) of its windowSize x windowSize neighbourhood,
+// which shrinks symmetrically near the borders (as the ElasticImageView).
+//
+// The cost per pixel is independent of windowSize (Perreault & Hebert): each
+// column keeps a histogram of its elastic window of rows, which its
+// ElasticImageView updates with the departed and entered pixels as it moves
+// down, and the window's histogram adds and subtracts whole column histograms
+// as it moves right.
+template<typename SrcImageT,typename TgtImageT>
+void rankFilter(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double percentile,
+         // This ugly bit is an unnamed argument with a default which means it neither
+         // contributes to the mangled declaration name nor requires an argument. So what is the
+         // point? It still participates in SFINAE to help select that this is an appropriate
+         // matching function given its arguments. Note, SFINAE techniques are incompatible with
+         // deduction so can't be applied to in parameter directly.
+         typename std::enable_if<types::is_grayscale<typename SrcImageT::pixel_type>::value ||
+                                 types::is_monochrome<typename SrcImageT::pixel_type>::value,int>::type* = 0) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef types::ElasticImageView<const PixelT>                            ElasticViewT;
+
+   static_assert(std::is_same<typename PixelT::value_type,uint8_t>::value,"rank filters require 8-bit channels");
+
+   utility::reportIfNotLessThan("windowSize",0u,windowSize);
+   utility::reportIfNotLessThan("windowSize",windowSize,256u);
+   utility::reportIfNotEqual("windowSize (which should be odd)",windowSize-1,((windowSize >> 1u) << 1u));
+   utility::reportIfNotLessThan("percentile",-1e-9,percentile);
+   utility::reportIfNotLessThan("percentile",percentile,100.0+1e-9);
+   utility::reportIfNotEqual("src.rows() != tgt.rows()",src.rows(),tgt.rows());
+   utility::reportIfNotEqual("src.cols() != tgt.cols()",src.cols(),tgt.cols());
+
+   const unsigned rows = src.rows();
+   const unsigned cols = src.cols();
+   const unsigned halfWindow = windowSize >> 1u;
+
+   // A single column elastic view (and histogram) per column
+   std::vector<ElasticViewT>  columnViews;
+   std::vector<RankHistogram> columns(cols);
+   columnViews.reserve(cols);
+   for(unsigned j = 0;j < cols;++j) {
+      columnViews.push_back(src.view(rows,1,0,j).elastic_view(windowSize,1));
+      columns[j].add(columnViews[j].pixel(0,0).tuple.value0);
+   }
+
+   for(unsigned i = 0;i < rows;++i) {
+      if(i > 0) {
+         for(unsigned j = 0;j < cols;++j) {
+            HistogramRemover<PixelT> remover(columns[j]);
+            HistogramAdder<PixelT>   adder(columns[j]);
+            columnViews[j].moveDown(remover,adder);
+         }
+      }
+
+      RankHistogram window(columns[0]);
+      unsigned halfCols = 0;
+      for(unsigned j = 0;j < cols;++j) {
+         if(j > 0) {
+            const unsigned newHalfCols = std::min(halfWindow,std::min(j,cols-1-j));
+            // Columns [j-1-halfCols,j-newHalfCols) departed, and (j-1+halfCols,j+newHalfCols] entered
+            for(unsigned c = j-1-halfCols;c < j-newHalfCols;++c) window.subtract(columns[c]);
+            for(unsigned c = j+halfCols;c <= j+newHalfCols;++c) window.add(columns[c]);
+            halfCols = newHalfCols;
+         }
+         const unsigned k = static_cast<unsigned>(std::lround(percentile/100.0*(window.total()-1)));
+         tgt.pixel(i,j).tuple.value0 = window.rank(k);
+      }
+   }
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void medianFilter(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize) {
+   rankFilter(src,tgt,windowSize,50.0);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void minFilter(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize) {
+   rankFilter(src,tgt,windowSize,0.0);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void maxFilter(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize) {
+   rankFilter(src,tgt,windowSize,100.0);
+}
+
+template<typename SrcImageT,typename TgtImageT>
+void percentileFilter(const SrcImageT& src, TgtImageT& tgt,unsigned windowSize,double percentile) {
+   rankFilter(src,tgt,windowSize,percentile);
+}
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "Image.h"
+#include "ImageAlgorithmSIMD.h"
+#include "Pixel.h"
+#include "utility/Error.h"
+#include "utility/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace batchIP {
+namespace algorithm {
+
+enum ResampleMethod {
+   RESAMPLE_AREA = 0,    // average of the covered source area (best for reduction)
+   RESAMPLE_BILINEAR,    // 2x2 taps
+   RESAMPLE_BICUBIC,     // 4x4 taps (Keys, a = -0.5)
+   RESAMPLE_NEAREST,     // pixel replication
+   NUM_RESAMPLE_METHODS
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ResampleAxis - the source indices and weights of every target index along
+//                one axis (rows or columns) of a resampling.
+//
+// Notes:
+// 1) Each target index has the same number of taps, and the tables are stored
+//    tap-major (i.e. [tap*size + index]), so that a pass over a whole row (or
+//    column) for one tap reads consecutive indices and weights.
+// 2) Pixel centers are aligned (i.e. source x = (target x + 0.5)/scale - 0.5),
+//    and taps beyond the border are clamped to the edge.
+// 3) Weights of each target index sum to 1.
+//
+class ResampleAxis {
+   unsigned           mSize;
+   unsigned           mTaps;
+   std::vector<int>   mIndices;
+   std::vector<float> mWeights;
+
+   static double cubic(double x) {
+      // Keys' cubic convolution kernel with a = -0.5
+      const double a = -0.5;
+      x = std::fabs(x);
+      if(x < 1.0) return ((a + 2.0)*x - (a + 3.0))*x*x + 1.0;
+      if(x < 2.0) return ((a*x - 5.0*a)*x + 8.0*a)*x - 4.0*a;
+      return 0.0;
+   }
+
+public:
+   ResampleAxis(unsigned srcSize,unsigned dstSize,ResampleMethod method) :
+      mSize(dstSize),
+      mTaps(0) {
+
+      utility::reportIfEqual("srcSize",srcSize,0u);
+      utility::reportIfEqual("dstSize",dstSize,0u);
+      utility::reportIfNotLessThan("method",(unsigned)method,(unsigned)NUM_RESAMPLE_METHODS);
+
+      const double scale = static_cast<double>(dstSize)/srcSize;
+      switch(method) {
+         case RESAMPLE_AREA:     mTaps = static_cast<unsigned>(std::ceil(1.0/scale)) + 1u; break;
+         case RESAMPLE_BILINEAR: mTaps = 2u; break;
+         case RESAMPLE_BICUBIC:  mTaps = 4u; break;
+         default:                mTaps = 1u; break;
+      }
+      mIndices.assign(static_cast<std::size_t>(mTaps)*dstSize,0);
+      mWeights.assign(static_cast<std::size_t>(mTaps)*dstSize,0.0f);
+
+      std::vector<double> weights(mTaps);
+      for(unsigned i = 0;i < dstSize;++i) {
+         int first = 0;
+         if(RESAMPLE_AREA == method) {
+            // Coverage of each source pixel by the target pixel's footprint
+            const double begin = i/scale;
+            const double end = (i + 1)/scale;
+            first = static_cast<int>(std::floor(begin));
+            for(unsigned t = 0;t < mTaps;++t) {
+               weights[t] = std::max(0.0,std::min(end,first + t + 1.0) - std::max(begin,first + t + 0.0));
+            }
+         }
+         else {
+            const double center = (i + 0.5)/scale - 0.5;
+            if(RESAMPLE_NEAREST == method) {
+               first = static_cast<int>(std::floor(center + 0.5));
+               weights[0] = 1.0;
+            }
+            else if(RESAMPLE_BILINEAR == method) {
+               first = static_cast<int>(std::floor(center));
+               weights[1] = center - first;
+               weights[0] = 1.0 - weights[1];
+            }
+            else {
+               first = static_cast<int>(std::floor(center)) - 1;
+               for(unsigned t = 0;t < mTaps;++t) weights[t] = cubic(center - (first + (int)t));
+            }
+         }
+         double sum = 0.0;
+         for(unsigned t = 0;t < mTaps;++t) sum += weights[t];
+         for(unsigned t = 0;t < mTaps;++t) {
+            const int index = std::max(0,std::min(static_cast<int>(srcSize) - 1,first + (int)t));
+            mIndices[static_cast<std::size_t>(t)*dstSize + i] = index;
+            mWeights[static_cast<std::size_t>(t)*dstSize + i] = static_cast<float>(weights[t]/sum);
+         }
+      }
+   }
+
+   unsigned size() const { return mSize; }
+
+   unsigned taps() const { return mTaps; }
+
+   // The dstSize source indices and weights of tap
+   const int* indices(unsigned tap) const { return &mIndices[static_cast<std::size_t>(tap)*mSize]; }
+
+   const float* weights(unsigned tap) const { return &mWeights[static_cast<std::size_t>(tap)*mSize]; }
+};
+
+
+namespace detail {
+   template<typename ValueT>
+   inline ValueT resampledValue(float value,typename std::enable_if<std::is_integral<ValueT>::value,int>::type* = 0) {
+      const float max = static_cast<float>(std::numeric_limits<ValueT>::max());
+      return static_cast<ValueT>(std::max(0.0f,std::min(max,std::floor(value + 0.5f))));
+   }
+
+   template<typename ValueT>
+   inline ValueT resampledValue(float value,typename std::enable_if<!std::is_integral<ValueT>::value,int>::type* = 0) {
+      return static_cast<ValueT>(value);
+   }
+} // namespace detail
+
+
+/*-----------------------------------------------------------------------**/
+// Resamples src into tgt (which is resized to ratio times the size of src,
+// rounded) with a separable filter: for each target row, the vertical pass
+// accumulates the tapped source rows (simd::multiplyAccumulate), and the
+// horizontal pass gathers the tapped columns of that (simd::multiplyAccumulateGather).
+// All channels (including alpha) are resampled, and bands of target rows are
+// resampled concurrently.
+template<typename SrcImageT,typename TgtImageT>
+void resample(const SrcImageT& src,TgtImageT& tgt,float ratio,ResampleMethod method) {
+
+   typedef typename std::remove_const<typename SrcImageT::pixel_type>::type PixelT;
+   typedef typename PixelT::value_type                                      ValueT;
+   typedef typename TgtImageT::pixel_type                                   TgtPixelT;
+
+   static_assert(std::is_same<PixelT,TgtPixelT>::value,"src and tgt must have the same pixel type");
+   static_assert(sizeof(PixelT) % sizeof(ValueT) == 0,"pixels must be packed channels");
+
+   utility::reportIfNotLessThan("0<ratio",0.0f,ratio);
+   const unsigned srcRows = src.rows();
+   const unsigned srcCols = src.cols();
+   utility::reportIfEqual("src.rows()",srcRows,0u);
+   utility::reportIfEqual("src.cols()",srcCols,0u);
+   const unsigned dstRows = std::max(1u,static_cast<unsigned>(std::lround(srcRows*(double)ratio)));
+   const unsigned dstCols = std::max(1u,static_cast<unsigned>(std::lround(srcCols*(double)ratio)));
+   tgt.resize(dstRows,dstCols);
+
+   const ResampleAxis rowAxis(srcRows,dstRows,method);
+   const ResampleAxis colAxis(srcCols,dstCols,method);
+
+   // Note: the horizontal pass gathers from interleaved channels
+   const unsigned channels = sizeof(PixelT)/sizeof(ValueT);
+   std::vector<int> colIndices(static_cast<std::size_t>(colAxis.taps())*dstCols);
+   for(unsigned t = 0;t < colAxis.taps();++t) {
+      for(unsigned j = 0;j < dstCols;++j) colIndices[static_cast<std::size_t>(t)*dstCols + j] = colAxis.indices(t)[j]*(int)channels;
+   }
+
+   const unsigned minRows = std::max(1u,(1u << 14)/dstCols);
+   utility::parallelFor(0,dstRows,[&](unsigned rowBegin,unsigned rowEnd,unsigned) {
+      std::vector<float> srcRow(static_cast<std::size_t>(srcCols)*channels);
+      std::vector<float> accRow(static_cast<std::size_t>(srcCols)*channels);
+      std::vector<float> dstPlane(dstCols);
+      for(unsigned i = rowBegin;i < rowEnd;++i) {
+         // Vertical pass
+         std::fill(accRow.begin(),accRow.end(),0.0f);
+         for(unsigned t = 0;t < rowAxis.taps();++t) {
+            const float weight = rowAxis.weights(t)[i];
+            if(0.0f == weight) continue;
+            const unsigned r = static_cast<unsigned>(rowAxis.indices(t)[i]);
+            const auto row = types::rowPixels(src,r);
+            for(unsigned c = 0;c < srcCols;++c) {
+               for(unsigned ch = 0;ch < channels;++ch) srcRow[c*channels + ch] = static_cast<float>(row[c].indexedColor[ch]);
+            }
+            simd::multiplyAccumulate(&accRow[0],&srcRow[0],weight,srcCols*channels);
+         }
+         // Horizontal pass (a channel at a time)
+         const auto trow = types::rowPixels(tgt,i);
+         for(unsigned ch = 0;ch < channels;++ch) {
+            std::fill(dstPlane.begin(),dstPlane.end(),0.0f);
+            for(unsigned t = 0;t < colAxis.taps();++t) {
+               simd::multiplyAccumulateGather(&dstPlane[0],&accRow[ch],&colIndices[static_cast<std::size_t>(t)*dstCols],
+                                              colAxis.weights(t),dstCols);
+            }
+            for(unsigned j = 0;j < dstCols;++j) trow[j].indexedColor[ch] = detail::resampledValue<ValueT>(dstPlane[j]);
+         }
+      }
+   },minRows);
+}
+
+} // namespace algorithm
+} // namespace batchIP
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace batchIP {
+namespace utility {
+
+///////////////////////////////////////////////////////////////////////////////
+// Simple fork-join helpers for algorithms that split an Image into bands of
+// rows (or any other contiguous index range).
+//
+// Notes:
+// 1) Each block is run on its own std::thread, and the calling thread runs
+//    the last block itself, so a single block never creates a thread.
+// 2) The number of threads defaults to std::thread::hardware_concurrency(),
+//    but may be overridden (e.g. set to 1 to debug or to compare results).
+//
+
+inline unsigned& activeThreadCount() {
+   static unsigned threads = std::max(1u,std::thread::hardware_concurrency());
+   return threads;
+}
+
+inline unsigned threadCount() { return activeThreadCount(); }
+
+// A count of 0 restores the hardware default.
+inline void setThreadCount(unsigned threads) {
+   activeThreadCount() = threads > 0 ? threads : std::max(1u,std::thread::hardware_concurrency());
+}
+
+// Number of blocks parallelFor splits [begin,end) into, such that each block
+// holds at least minPerBlock indices.
+inline unsigned parallelBlocks(unsigned begin,unsigned end,unsigned minPerBlock = 1) {
+   if(end <= begin) return 0;
+   unsigned count = end - begin;
+   unsigned blocks = std::max(1u,count/std::max(1u,minPerBlock));
+   return std::min(blocks,threadCount());
+}
+
+// Calls func(blockBegin,blockEnd,blockIndex) for each of parallelBlocks() contiguous
+// blocks of [begin,end) concurrently, and returns once all have completed.
+template<typename FuncT>
+unsigned parallelFor(unsigned begin,unsigned end,FuncT func,unsigned minPerBlock = 1) {
+   unsigned blocks = parallelBlocks(begin,end,minPerBlock);
+   if(0 == blocks) return 0;
+   unsigned count = end - begin;
+   std::vector<std::thread> workers;
+   workers.reserve(blocks-1);
+   for(unsigned b = 0;b < blocks;++b) {
+      unsigned blockBegin = begin + static_cast<unsigned>(static_cast<unsigned long long>(count)*b/blocks);
+      unsigned blockEnd   = begin + static_cast<unsigned>(static_cast<unsigned long long>(count)*(b+1)/blocks);
+      if(b + 1 < blocks) workers.emplace_back(func,blockBegin,blockEnd,b);
+      else               func(blockBegin,blockEnd,b);
+   }
+   for(std::thread& worker : workers) worker.join();
+   return blocks;
+}
+
+} // namespace utility
+} // namespace batchIP
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace batchIP {
+namespace utility {
+
+///////////////////////////////////////////////////////////////////////////////
+// A stable least significant digit radix sort of 64-bit keys.
+//
+// Notes:
+// 1) Keys are sorted a byte at a time, from byte firstByte up, so bytes below
+//    firstByte are carried along but keep their original order among equal
+//    keys (e.g. an index packed into the low bytes of each key needs no
+//    sorting when keys start in index order).
+// 2) Each pass counts the digits of contiguous blocks of keys concurrently
+//    (see parallelFor), offsets each block's digits after the same digits of
+//    the blocks before it, and then scatters the blocks concurrently, which
+//    keeps the sort stable.
+// 3) Passes whose digit is the same for all keys are skipped.
+//
+inline void radixSort(std::vector<uint64_t>& keys,unsigned firstByte = 0) {
+   enum { DIGITS = 256 };
+   // Fewest keys worth handing to a thread
+   enum { MIN_KEYS_PER_BLOCK = 1u << 16 };
+
+   const unsigned count = static_cast<unsigned>(keys.size());
+   if(count < 2u) return;
+   std::vector<uint64_t> sorted(count);
+   const unsigned blocks = parallelBlocks(0,count,MIN_KEYS_PER_BLOCK);
+   std::vector<uint32_t> offsets(static_cast<std::size_t>(blocks)*DIGITS);
+
+   for(unsigned byte = firstByte;byte < 8u;++byte) {
+      const unsigned shift = byte*8u;
+      std::fill(offsets.begin(),offsets.end(),0u);
+      parallelFor(0,count,[&](unsigned begin,unsigned end,unsigned block) {
+         uint32_t* counts = &offsets[static_cast<std::size_t>(block)*DIGITS];
+         for(unsigned i = begin;i < end;++i) ++counts[(keys[i] >> shift) & 0xFFu];
+      },MIN_KEYS_PER_BLOCK);
+
+      // Skip the pass if all keys share the digit
+      const unsigned digit = static_cast<unsigned>((keys[0] >> shift) & 0xFFu);
+      uint64_t same = 0;
+      for(unsigned b = 0;b < blocks;++b) same += offsets[static_cast<std::size_t>(b)*DIGITS + digit];
+      if(same == count) continue;
+
+      // Turn the counts into where each block's digits start (digit major)
+      uint32_t start = 0;
+      for(unsigned d = 0;d < DIGITS;++d) {
+         for(unsigned b = 0;b < blocks;++b) {
+            uint32_t& offset = offsets[static_cast<std::size_t>(b)*DIGITS + d];
+            const uint32_t digitCount = offset;
+            offset = start;
+            start += digitCount;
+         }
+      }
+
+      parallelFor(0,count,[&](unsigned begin,unsigned end,unsigned block) {
+         uint32_t* next = &offsets[static_cast<std::size_t>(block)*DIGITS];
+         for(unsigned i = begin;i < end;++i) sorted[next[(keys[i] >> shift) & 0xFFu]++] = keys[i];
+      },MIN_KEYS_PER_BLOCK);
+      keys.swap(sorted);
+   }
+}
+
+} // namespace utility
+} // namespace batchIP
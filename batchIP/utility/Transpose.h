@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace batchIP {
+namespace utility {
+
+///////////////////////////////////////////////////////////////////////////////
+// Transposes the rows x cols plane src into the cols x rows plane tgt.
+//
+// Note: the planes are visited a 32 x 32 tile at a time, so that the rows
+// read from src and the columns written to tgt both stay in cache (which
+// makes separable passes over the columns of a plane as cheap as over its
+// rows).
+//
+template<typename ValueT>
+void transposePlane(const ValueT* src,ValueT* tgt,unsigned rows,unsigned cols) {
+   const unsigned TILE = 32;
+   for(unsigned r0 = 0;r0 < rows;r0 += TILE) {
+      const unsigned rEnd = std::min(rows,r0 + TILE);
+      for(unsigned c0 = 0;c0 < cols;c0 += TILE) {
+         const unsigned cEnd = std::min(cols,c0 + TILE);
+         for(unsigned r = r0;r < rEnd;++r) {
+            for(unsigned c = c0;c < cEnd;++c) tgt[static_cast<std::size_t>(c)*rows + r] = src[static_cast<std::size_t>(r)*cols + c];
+         }
+      }
+   }
+}
+
+} // namespace utility
+} // namespace batchIP
@@ -9,12 +9,15 @@
 #include "image/GILImageIO.h"
 #include "image/ImageOperation.h"
 #include "image/ImageActions.h"
+#include "image/LookupChain.h"
 #include "image/RegionOfInterest.h"
 #include "utility/StringParse.h"
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 
 namespace batchIP {
@@ -130,6 +133,9 @@ void process(const std::string& inputfile,
 bool isGrayscaleOperation(const std::string& operation) {
    return(
            (operation == "hist")                || 
+           (operation == "histEQ")              || 
+           (operation == "adaptiveEQ")          || 
+           (operation == "histUnify")           || 
            (operation == "histEQCV")            || 
            (operation == "thresholdEQCV")       || 
            (operation == "scale")               || 
@@ -138,10 +144,30 @@ bool isGrayscaleOperation(const std::string& operation) {
            (operation == "otsuBinarize")        || 
            (operation == "otsuBinarizeCV")      || 
            (operation == "binarizeDT")          || 
+           (operation == "niblack")             || 
+           (operation == "sauvola")             || 
+           (operation == "bradley")             || 
+           (operation == "components")          || 
+           (operation == "distance")            || 
            (operation == "uniformSmooth")       || 
+           (operation == "gaussianSmooth")      || 
+           (operation == "convolve")            || 
+           (operation == "median")              || 
+           (operation == "min")                 || 
+           (operation == "max")                 || 
+           (operation == "percentile")          || 
+           (operation == "erode")               || 
+           (operation == "dilate")              || 
+           (operation == "open")                || 
+           (operation == "close")               || 
+           (operation == "topHat")              || 
            (operation == "edgeGradient")        || 
            (operation == "edgeGradientClipped") || 
            (operation == "edgeDetect")          || 
+           (operation == "edgeGradientSmoothed")|| 
+           (operation == "edgeDetectSmoothed")  || 
+           (operation == "houghLines")          || 
+           (operation == "houghCircles")        || 
            (operation == "orientedEdgeGradient")||
            (operation == "orientedEdgeDetect")  || 
            (operation == "edgeSobelCV")         || 
@@ -193,18 +219,42 @@ void parseAndRunOperation(const std::string& line) {
          else if(operation == "crop")          process(inputfile,outputfile,operation,line,ss,Crop<ImageT>::make(ss));
          else if(operation == "hist")          process(inputfile,outputfile,operation,line,ss,Histogram<ImageT>::make(ss));
          else if(operation == "histMod")       process(inputfile,outputfile,operation,line,ss,HistogramModify<ImageT>::make(ss));
+         else if(operation == "histEQ")        process(inputfile,outputfile,operation,line,ss,HistogramEqualize<ImageT>::make(ss));
+         else if(operation == "adaptiveEQ")    process(inputfile,outputfile,operation,line,ss,AdaptiveEqualize<ImageT>::make(ss));
+         else if(operation == "histUnify")     process(inputfile,outputfile,operation,line,ss,HistogramUnify<ImageT>::make(ss));
          else if(operation == "histEQCV")      process(inputfile,outputfile,operation,line,ss,HistogramEqualizeOCV<ImageT>::make(ss));
          else if(operation == "thresholdEQCV") process(inputfile,outputfile,operation,line,ss,ThresholdEqualizeOCV<ImageT>::make(ss));
          else if(operation == "scale")         process(inputfile,outputfile,operation,line,ss,Scale<ImageT>::make(ss));
+         else if(operation == "resize")        process(inputfile,outputfile,operation,line,ss,Resample<ImageT>::make(ss));
          else if(operation == "binarize")      process(inputfile,outputfile,operation,line,ss,Binarize<ImageT>::make(ss));
          else if(operation == "optBinarize")   process(inputfile,outputfile,operation,line,ss,OptimalBinarize<ImageT>::make(ss));
          else if(operation == "otsuBinarize")  process(inputfile,outputfile,operation,line,ss,OtsuBinarize<ImageT>::make(ss));
          else if(operation == "otsuBinarizeCV") process(inputfile,outputfile,operation,line,ss,OtsuBinarizeOCV<ImageT>::make(ss));
          else if(operation == "binarizeDT")    process(inputfile,outputfile,operation,line,ss,BinarizeDT<ImageT>::make(ss));
+         else if(operation == "niblack")       process(inputfile,outputfile,operation,line,ss,NiblackBinarize<ImageT>::make(ss));
+         else if(operation == "sauvola")       process(inputfile,outputfile,operation,line,ss,SauvolaBinarize<ImageT>::make(ss));
+         else if(operation == "bradley")       process(inputfile,outputfile,operation,line,ss,BradleyBinarize<ImageT>::make(ss));
+         else if(operation == "components")    process(inputfile,outputfile,operation,line,ss,ConnectedComponents<ImageT>::make(ss));
+         else if(operation == "distance")      process(inputfile,outputfile,operation,line,ss,DistanceTransform<ImageT>::make(ss));
          else if(operation == "uniformSmooth") process(inputfile,outputfile,operation,line,ss,UniformSmooth<ImageT>::make(ss));
+         else if(operation == "gaussianSmooth") process(inputfile,outputfile,operation,line,ss,GaussianSmooth<ImageT>::make(ss));
+         else if(operation == "convolve")      process(inputfile,outputfile,operation,line,ss,Convolve<ImageT>::make(ss));
+         else if(operation == "median")        process(inputfile,outputfile,operation,line,ss,MedianFilter<ImageT>::make(ss));
+         else if(operation == "min")           process(inputfile,outputfile,operation,line,ss,MinFilter<ImageT>::make(ss));
+         else if(operation == "max")           process(inputfile,outputfile,operation,line,ss,MaxFilter<ImageT>::make(ss));
+         else if(operation == "percentile")    process(inputfile,outputfile,operation,line,ss,PercentileFilter<ImageT>::make(ss));
+         else if(operation == "erode")         process(inputfile,outputfile,operation,line,ss,Erode<ImageT>::make(ss));
+         else if(operation == "dilate")        process(inputfile,outputfile,operation,line,ss,Dilate<ImageT>::make(ss));
+         else if(operation == "open")          process(inputfile,outputfile,operation,line,ss,Opening<ImageT>::make(ss));
+         else if(operation == "close")         process(inputfile,outputfile,operation,line,ss,Closing<ImageT>::make(ss));
+         else if(operation == "topHat")        process(inputfile,outputfile,operation,line,ss,TopHat<ImageT>::make(ss));
          else if(operation == "edgeGradient")  process(inputfile,outputfile,operation,line,ss,EdgeGradient<ImageT>::make(ss));
          else if(operation == "edgeGradientClipped")  process(inputfile,outputfile,operation,line,ss,EdgeGradientClipped<ImageT>::make(ss));
          else if(operation == "edgeDetect")    process(inputfile,outputfile,operation,line,ss,EdgeDetect<ImageT>::make(ss));
+         else if(operation == "edgeGradientSmoothed")  process(inputfile,outputfile,operation,line,ss,EdgeGradientSmoothed<ImageT>::make(ss));
+         else if(operation == "edgeDetectSmoothed")  process(inputfile,outputfile,operation,line,ss,EdgeDetectSmoothed<ImageT>::make(ss));
+         else if(operation == "houghLines")    process(inputfile,outputfile,operation,line,ss,HoughLines<ImageT>::make(ss));
+         else if(operation == "houghCircles")  process(inputfile,outputfile,operation,line,ss,HoughCircles<ImageT>::make(ss));
          else if(operation == "orientedEdgeGradient")  process(inputfile,outputfile,operation,line,ss,OrientedEdgeGradient<ImageT>::make(ss));
          else if(operation == "orientedEdgeDetect")  process(inputfile,outputfile,operation,line,ss,OrientedEdgeDetect<ImageT>::make(ss));
          else if(operation == "edgeSobelCV")   process(inputfile,outputfile,operation,line,ss,EdgeSobelOCV<ImageT>::make(ss));
@@ -242,10 +292,14 @@ void parseAndRunOperation(const std::string& line) {
       try {
          if     (operation == "add")           process(inputfile,outputfile,operation,line,ss,Intensity<ImageT>::make(ss));
          else if(operation == "crop")          process(inputfile,outputfile,operation,line,ss,Crop<ImageT>::make(ss));
+         else if(operation == "resize")        process(inputfile,outputfile,operation,line,ss,Resample<ImageT>::make(ss));
          else if(operation == "binarizeColor") process(inputfile,outputfile,operation,line,ss,BinarizeColor<ImageT>::make(ss));
+         else if(operation == "binarizeColors") process(inputfile,outputfile,operation,line,ss,BinarizeColors<ImageT>::make(ss));
          else if(operation == "histChan")      process(inputfile,outputfile,operation,line,ss,HistogramChannel<ImageT>::make(ss));
          else if(operation == "histMod")       process(inputfile,outputfile,operation,line,ss,HistogramModifyRGB<ImageT>::make(ss));
          else if(operation == "histModI")      process(inputfile,outputfile,operation,line,ss,HistogramModifyIntensity<ImageT>::make(ss));
+         else if(operation == "histEQI")       process(inputfile,outputfile,operation,line,ss,HistogramEqualize<ImageT>::make(ss));
+         else if(operation == "adaptiveEQI")   process(inputfile,outputfile,operation,line,ss,AdaptiveEqualize<ImageT>::make(ss));
          else if(operation == "histModAnyRGB") process(inputfile,outputfile,operation,line,ss,HistogramModifyAnyRGB<ImageT>::make(ss));
          else if(operation == "histModAnyHSI") process(inputfile,outputfile,operation,line,ss,HistogramModifyAnyHSI<ImageT>::make(ss));
          else if(operation == "selectColor")   process(inputfile,outputfile,operation,line,ss,SelectColor<ImageT>::make(ss));
@@ -275,6 +329,57 @@ void parseAndRunOperation(const std::string& line) {
    }
 }
 
+
+///////////////////////////////////////////////////////////////////////////////
+// Chains of point operations (planned by operation::planLookupChains)
+//
+
+template<typename ImageT>
+operation::LookupTableAction<ImageT>* makeLookupAction(const std::string& operation,std::istream& ins) {
+   using namespace ::batchIP::operation;
+   if     (operation == "add")        return Intensity<ImageT>::make(ins);
+   else if(operation == "binarize")   return Binarize<ImageT>::make(ins);
+   else if(operation == "binarizeDT") return BinarizeDT<ImageT>::make(ins);
+   else if(operation == "histMod") {
+      if(types::is_rgba<typename ImageT::pixel_type>::value) return HistogramModifyRGB<ImageT>::make(ins);
+      else                                                   return HistogramModify<ImageT>::make(ins);
+   }
+   throw std::invalid_argument("not a point operation: " + operation);
+}
+
+template<typename ImageT>
+void runLookupChain(const std::vector<operation::OperationLine>& chain) {
+
+   typedef typename ImageT::pixel_type                 PixelT;
+   typedef algorithm::LookupTable<typename PixelT::value_type> TableT;
+
+   try {
+      // Compose the tables of all operations
+      TableT composed;
+      for(const operation::OperationLine& op : chain) {
+         std::cout << "Processing: " << (op.line.size() > 80 ? op.line.substr(0,80) + "..." : op.line) << std::endl;
+         std::stringstream ss;
+         ss << op.line;
+         for(unsigned i = 0;i < 3;++i) utility::parseWord<std::string>(ss); // skip files and operation
+         std::unique_ptr<operation::LookupTableAction<ImageT> > action(makeLookupAction<ImageT>(op.operation,ss));
+         composed = algorithm::compose(composed,action->table());
+      }
+      std::cout << "  (composed " << chain.size() << " point operations into one pass)" << std::endl;
+
+      ImageT src = readImage<ImageT>(chain.front().inputfile,chain.front().line);
+      ImageT tgt(src);
+      algorithm::applyLookupTable(src,tgt,composed,algorithm::colorChannelMask<PixelT>());
+      saveImage(tgt,chain.back().outputfile,chain.back().line);
+   }
+   catch(const utility::ParseError& pe) {
+      std::cerr << "ERROR: parsing operation on line: " << chain.front().line << "\n"
+                << "ERROR: " << pe.what() << std::endl; 
+   }
+   catch(const std::exception& e) {
+      std::cerr << "ERROR: processing operation: " << e.what() << std::endl;
+   }
+}
+
 } // unnamed namespace
 } // namespace batchIP
 
@@ -289,8 +394,40 @@ int main (int argc, char** argv) {
    std::fstream opsFile;
    opsFile.open(argv[1], std::ios_base::in);
    if(opsFile.is_open()) {
-      for(std::string line; std::getline(opsFile, line);) {
-         if(line.size() > 0) parseAndRunOperation(line);
+      std::vector<std::string> lines;
+      for(std::string line; std::getline(opsFile, line);) lines.push_back(line);
+
+      const std::vector<operation::LookupChain> chains = operation::planLookupChains(lines,isGrayscaleOperation);
+
+      std::size_t nextChain = 0;
+      for(unsigned i = 0;i < lines.size();) {
+         if(nextChain < chains.size() && chains[nextChain].first == i) {
+            const operation::LookupChain& chain = chains[nextChain++];
+            // The input (which an earlier line may have just written) settles the pixel type,
+            // and if it can't be read, the lines are left to report their own errors.
+            const operation::OperationLine& first = chain.operations.front();
+            bool grayscale = false;
+            bool composable = false;
+            try {
+               grayscale = isGrayscaleOperation(first.operation) || io::isImageGrayscale(first.inputfile);
+               composable = operation::isLookupChain(chain,grayscale);
+            }
+            catch(...) {}
+            if(composable) {
+               if(grayscale) runLookupChain<types::Image<types::GrayAlphaPixel<uint8_t> > >(chain.operations);
+               else          runLookupChain<types::Image<types::RGBAPixel<uint8_t> > >(chain.operations);
+            }
+            else {
+               for(unsigned line = i;line < i + chain.count;++line) {
+                  if(lines[line].size() > 0) parseAndRunOperation(lines[line]);
+               }
+            }
+            i += chain.count;
+         }
+         else {
+            if(lines[i].size() > 0) parseAndRunOperation(lines[i]);
+            ++i;
+         }
       }
    }
    else {
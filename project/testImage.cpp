@@ -4,12 +4,25 @@
  *
  ************************************************************/
 
+#include "image/ColorConversion.h"
+#include "image/Histogram.h"
 #include "image/Image.h"
 #include "image/NetpbmImage.h"
 #include "image/Pixel.h"
 #include "image/ImageAlgorithm.h"
+#include "image/ImageAlgorithmExperimental.h"
+#include "image/ImagePyramid.h"
+#include "image/IntegralImage.h"
+#include "image/LookupChain.h"
+#include "image/LookupTable.h"
 #include "utility/Error.h"
+#include "utility/Parallel.h"
+#include "utility/RadixSort.h"
+#if __has_include(<opencv2/opencv.hpp>)
+#include "image/ImageAlgorithmOpenCV.h"
+#endif
 #include <exception>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
@@ -208,6 +221,1624 @@ void testViewIteratorGrayscale() {
    writePGMFile<PixelT::GRAY_CHANNEL>("UnitTestGrayscale1.pgm",image);
 }
 
+void testStridedViewGrayscale() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef ImageT::image_view ViewT;
+   typedef ImageT::strided_image_view StridedViewT;
+
+   ImageT image(101u,120u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r + c) % 256);
+      }
+   }
+
+   StridedViewT strided = image.strided_view(2u,3u);
+   reportIfNotEqual("strided.rows()",strided.rows(),51u);
+   reportIfNotEqual("strided.cols()",strided.cols(),40u);
+   reportIfNotEqual("strided.pixel",strided.pixel(50,39),image.pixel(100,117));
+
+   // Strides of strided views compose, and subviews are in decimated coordinates
+   StridedViewT strided2 = strided.strided_view(2u,2u);
+   reportIfNotEqual("strided2.pixel",strided2.pixel(3,5),image.pixel(12,30));
+   StridedViewT subview = strided.view(10u,10u,5u,5u);
+   reportIfNotEqual("subview.pixel",subview.pixel(1,2),image.pixel(12,21));
+
+   // Strided views of subviews are relative to the subview
+   ViewT view = image.view(50u,50u,10u,20u);
+   reportIfNotEqual("view.strided_view.pixel",view.strided_view(4u,4u).pixel(2,3),image.pixel(18,32));
+
+   unsigned iterations = 0;
+   StridedViewT::iterator pos = strided.begin();
+   StridedViewT::iterator end = strided.end();
+   for(;pos != end;++pos,++iterations) {}
+   reportIfNotEqual("strided.size() == iterations",iterations,strided.size());
+
+   // A strided view is a zero-copy nearest neighbour downsample
+   ImageT decimated(strided);
+   reportIfNotEqual("decimated.pixel",decimated.pixel(20,20),image.pixel(40,60));
+   ImageT target(51u,40u);
+   ViewT tview = target.view(51u,40u);
+   tview = strided;
+   reportIfNotEqual("target.pixel",target.pixel(7,9),image.pixel(14,27));
+
+   try {
+      strided.view(10u,10u,45u,0u);
+      throw ExpectedError("Expected strided.view to be out of range");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testStridedOtsuThreshold() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   // Bimodal image: left half dark, right half bright
+   ImageT image(200u,200u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)(c < 100 ? 40 + (r+c)%20 : 180 + (r+c)%20);
+      }
+   }
+   unsigned full = otsuThreshold(image);
+   unsigned decimated = otsuThreshold(image.strided_view(4u,4u));
+   reportIfNotLessThan("full threshold in gap",59u,full);
+   reportIfNotLessThan("full threshold in gap",full,181u);
+   reportIfNotLessThan("decimated threshold in gap",56u,decimated);
+   reportIfNotLessThan("decimated threshold in gap",decimated,181u);
+}
+
+void testImagePyramid() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef ImagePyramid<PixelT> PyramidT;
+   typedef PyramidT::image_view ViewT;
+
+   ImageT image(37u,64u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)(4*c);
+      }
+   }
+
+   PyramidT boxPyramid(image);
+   reportIfNotEqual("levels",boxPyramid.levels(),7u);
+   reportIfNotEqual("builtLevels",boxPyramid.builtLevels(),1u);
+   reportIfNotEqual("rows(1)",boxPyramid.rows(1),19u);
+   reportIfNotEqual("cols(6)",boxPyramid.cols(6),1u);
+   reportIfNotEqual("level0",boxPyramid.level(0).pixel(20,10),image.pixel(20,10));
+   reportIfNotEqual("builtLevels",boxPyramid.builtLevels(),1u);
+
+   // Levels are generated lazily, up to the requested level
+   ViewT level2 = boxPyramid.level(2);
+   reportIfNotEqual("builtLevels",boxPyramid.builtLevels(),3u);
+   reportIfNotEqual("level2.rows()",level2.rows(),10u);
+   reportIfNotEqual("level2.cols()",level2.cols(),16u);
+   // Average of columns 4c..4c+3 is 4*(4c+1.5) = 16c+6
+   reportIfNotEqual("level2.pixel",(unsigned)level2.pixel(3,5).namedColor.gray,86u);
+
+   // A constant image remains constant through a Gaussian pyramid
+   ImageT flat(33u,20u);
+   for(ImageT::iterator pos = flat.begin();pos != flat.end();++pos) pos->namedColor.gray = 99;
+   PyramidT gaussPyramid(flat,4,PyramidT::GAUSSIAN_REDUCE);
+   reportIfNotEqual("levels",gaussPyramid.levels(),4u);
+   ViewT level3 = gaussPyramid.level(3);
+   reportIfNotEqual("level3.rows()",level3.rows(),5u);
+   reportIfNotEqual("level3.cols()",level3.cols(),3u);
+   for(ViewT::iterator pos = level3.begin();pos != level3.end();++pos) {
+      reportIfNotEqual("gaussian level3",(unsigned)pos->namedColor.gray,99u);
+   }
+
+   // Reductions of odd and even sized images match clamped reference filters
+   const unsigned sizes[][2] = { { 23u, 17u }, { 12u, 30u }, { 3u, 2u } };
+   for(unsigned s = 0;s < 3u;++s) {
+      ImageT noisy(sizes[s][0],sizes[s][1]);
+      for(unsigned r = 0;r < noisy.rows();++r) {
+         for(unsigned c = 0;c < noisy.cols();++c) noisy.pixel(r,c).namedColor.gray = (uint8_t)((r*37 + c*101 + r*c) % 256);
+      }
+      const int rows = (int)noisy.rows();
+      const int cols = (int)noisy.cols();
+      const unsigned taps[5] = { 1u, 4u, 6u, 4u, 1u };
+      PyramidT gaussReduced(noisy,2,PyramidT::GAUSSIAN_REDUCE);
+      PyramidT boxReduced(noisy,2);
+      ViewT gaussLevel = gaussReduced.level(1);
+      ViewT boxLevel = boxReduced.level(1);
+      for(int r = 0;r < (int)gaussLevel.rows();++r) {
+         for(int c = 0;c < (int)gaussLevel.cols();++c) {
+            unsigned gaussSum = 0;
+            for(int m = -2;m <= 2;++m) {
+               for(int n = -2;n <= 2;++n) {
+                  const int sr = std::min(std::max(2*r + m,0),rows-1);
+                  const int sc = std::min(std::max(2*c + n,0),cols-1);
+                  gaussSum += taps[m+2]*taps[n+2]*noisy.pixel(sr,sc).namedColor.gray;
+               }
+            }
+            reportIfNotEqual("gaussian reduce",(unsigned)gaussLevel.pixel(r,c).namedColor.gray,(gaussSum + 128u)/256u);
+            unsigned boxSum = 0;
+            for(int m = 0;m <= 1;++m) {
+               for(int n = 0;n <= 1;++n) boxSum += noisy.pixel(std::min(2*r + m,rows-1),std::min(2*c + n,cols-1)).namedColor.gray;
+            }
+            reportIfNotEqual("box reduce",(unsigned)boxLevel.pixel(r,c).namedColor.gray,(boxSum + 2u)/4u);
+         }
+      }
+   }
+
+   try {
+      gaussPyramid.level(4);
+      throw ExpectedError("Expected pyramid level to be out of range");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testIntegralImage() {
+   typedef GrayAlphaPixel<uint16_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef IntegralImage<PixelT> IntegralT;
+
+   // Near full-scale 16-bit data, so that sums of squares need 64-bit accumulators
+   ImageT image(61u,47u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint16_t)(65535u - (r*131u + c*17u)%1000u);
+      }
+   }
+   IntegralT integral(image);
+   const unsigned windows[][4] = { {0,0,61,47}, {5,7,1,1}, {10,3,20,30}, {60,0,1,47}, {0,46,61,1} };
+   for(unsigned w = 0;w < sizeof(windows)/sizeof(windows[0]);++w) {
+      uint64_t sum = 0;
+      uint64_t squares = 0;
+      for(unsigned r = windows[w][0];r < windows[w][0]+windows[w][2];++r) {
+         for(unsigned c = windows[w][1];c < windows[w][1]+windows[w][3];++c) {
+            uint64_t v = image.pixel(r,c).namedColor.gray;
+            sum += v;
+            squares += v*v;
+         }
+      }
+      reportIfNotEqual("integral sum",integral.sum(windows[w][0],windows[w][1],windows[w][2],windows[w][3]),sum);
+      reportIfNotEqual("integral sumOfSquares",integral.sumOfSquares(windows[w][0],windows[w][1],windows[w][2],windows[w][3]),squares);
+   }
+
+   try {
+      integral.sum(1,0,61,47);
+      throw ExpectedError("Expected integral window to be out of range");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testUniformSmooth() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   ImageT image(90u,120u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*r + 7*c*r + 3*c)%256u);
+      }
+   }
+
+   // Compare against a direct average of the (symmetrically shrunk) window at each pixel
+   const unsigned windowSizes[] = { 3, 7, 51, 81 };
+   for(unsigned w = 0;w < sizeof(windowSizes)/sizeof(windowSizes[0]);++w) {
+      unsigned half = windowSizes[w] >> 1u;
+      ImageT smoothed(image.rows(),image.cols());
+      uniformSmooth(image,smoothed,windowSizes[w]);
+      for(unsigned r = 0;r < image.rows();++r) {
+         unsigned halfRows = std::min(half,std::min(r,image.rows()-1-r));
+         for(unsigned c = 0;c < image.cols();++c) {
+            unsigned halfCols = std::min(half,std::min(c,image.cols()-1-c));
+            unsigned sum = 0;
+            for(unsigned i = r-halfRows;i <= r+halfRows;++i) {
+               for(unsigned j = c-halfCols;j <= c+halfCols;++j) sum += image.pixel(i,j).namedColor.gray;
+            }
+            unsigned expected = sum / ((2*halfRows+1)*(2*halfCols+1));
+            reportIfNotEqual("uniformSmooth",(unsigned)smoothed.pixel(r,c).namedColor.gray,expected);
+         }
+      }
+   }
+}
+
+void testGaussianSmooth() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef Image<MonochromePixel<float> > FloatImageT;
+
+   // An impulse spreads into a unit mass with variance sigma^2 along each axis
+   const float sigmas[] = { 0.8f, 2.0f, 5.0f, 12.0f };
+   for(unsigned s = 0;s < sizeof(sigmas)/sizeof(sigmas[0]);++s) {
+      FloatImageT impulse(161u,161u);
+      for(unsigned r = 0;r < impulse.rows();++r) {
+         for(unsigned c = 0;c < impulse.cols();++c) impulse.pixel(r,c).tuple.value0 = 0.0f;
+      }
+      impulse.pixel(80,80).tuple.value0 = 1.0f;
+      FloatImageT smoothed(impulse.rows(),impulse.cols());
+      gaussianSmooth(impulse,smoothed,sigmas[s]);
+      double mass = 0.0;
+      double variance = 0.0;
+      for(unsigned r = 0;r < smoothed.rows();++r) {
+         for(unsigned c = 0;c < smoothed.cols();++c) {
+            const double value = smoothed.pixel(r,c).tuple.value0;
+            mass += value;
+            variance += value*(c - 80.0)*(c - 80.0);
+            // Symmetric about the impulse
+            reportIfNotLessThan("symmetry",std::fabs(value - smoothed.pixel(r,160u-c).tuple.value0),1e-5);
+            reportIfNotLessThan("symmetry",std::fabs(value - smoothed.pixel(c,r).tuple.value0),1e-5);
+         }
+      }
+      reportIfNotLessThan("mass",std::fabs(mass - 1.0),1e-3);
+      reportIfNotLessThan("sigma",std::fabs(std::sqrt(variance) - sigmas[s]),0.05*sigmas[s]);
+   }
+
+   ImageT image(70u,93u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*r + 7*c*r + 3*c)%256u);
+      }
+   }
+
+   // A constant image is unchanged (the borders start in their steady state)
+   ImageT constant(image.rows(),image.cols());
+   for(unsigned r = 0;r < constant.rows();++r) {
+      for(unsigned c = 0;c < constant.cols();++c) constant.pixel(r,c).namedColor.gray = 117u;
+   }
+   ImageT smoothed(image.rows(),image.cols());
+   gaussianSmooth(constant,smoothed,4.0f);
+   for(unsigned r = 0;r < smoothed.rows();++r) {
+      for(unsigned c = 0;c < smoothed.cols();++c) reportIfNotEqual("constant",(unsigned)smoothed.pixel(r,c).namedColor.gray,117u);
+   }
+
+   // Sigmas below 0.5 copy
+   gaussianSmooth(image,smoothed,0.0f);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) reportIfNotEqual("copy",(unsigned)smoothed.pixel(r,c).namedColor.gray,(unsigned)image.pixel(r,c).namedColor.gray);
+   }
+
+   // The same result for any number of threads, and within a view
+   ImageT expected(image.rows(),image.cols());
+   setThreadCount(1);
+   gaussianSmooth(image,expected,3.0f);
+   const unsigned threads[] = { 2, 3, 8 };
+   for(unsigned t = 0;t < sizeof(threads)/sizeof(threads[0]);++t) {
+      setThreadCount(threads[t]);
+      gaussianSmooth(image,smoothed,3.0f);
+      for(unsigned r = 0;r < image.rows();++r) {
+         for(unsigned c = 0;c < image.cols();++c) reportIfNotEqual("threads",(unsigned)smoothed.pixel(r,c).namedColor.gray,(unsigned)expected.pixel(r,c).namedColor.gray);
+      }
+   }
+   setThreadCount(0);
+   ImageT cropped(30u,40u);
+   for(unsigned r = 0;r < cropped.rows();++r) {
+      for(unsigned c = 0;c < cropped.cols();++c) cropped.pixel(r,c).namedColor.gray = image.pixel(r+11u,c+17u).namedColor.gray;
+   }
+   ImageT croppedSmoothed(cropped.rows(),cropped.cols());
+   gaussianSmooth(cropped,croppedSmoothed,1.5f);
+   ImageT viewed(image);
+   ImageT::image_view view = viewed.view(30u,40u,11u,17u);
+   gaussianSmooth(image.view(30u,40u,11u,17u),view,1.5f);
+   for(unsigned r = 0;r < cropped.rows();++r) {
+      for(unsigned c = 0;c < cropped.cols();++c) reportIfNotEqual("view",(unsigned)viewed.pixel(r+11u,c+17u).namedColor.gray,(unsigned)croppedSmoothed.pixel(r,c).namedColor.gray);
+   }
+
+   // Pre-smoothed edges with no smoothing are the plain edges
+   ImageT edges(image.rows(),image.cols());
+   ImageT smoothedEdges(image.rows(),image.cols());
+   edgeGradient(image,edges,3u);
+   edgeGradient(image,smoothedEdges,3u,0.0f);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) reportIfNotEqual("edgeGradient",(unsigned)smoothedEdges.pixel(r,c).namedColor.gray,(unsigned)edges.pixel(r,c).namedColor.gray);
+   }
+
+   try {
+      gaussianSmooth(image,smoothed,-1.0f);
+      throw ExpectedError("Expected negative sigma to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testRankFilter() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   ImageT image(45u,61u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*r + 7*c*r + 3*c)%256u);
+      }
+   }
+
+   // Compare against sorting the (symmetrically shrunk) window at each pixel
+   const unsigned windowSizes[] = { 1, 3, 7, 31, 101 };
+   const double percentiles[] = { 0.0, 25.0, 50.0, 90.0, 100.0 };
+   for(unsigned w = 0;w < sizeof(windowSizes)/sizeof(windowSizes[0]);++w) {
+      unsigned half = windowSizes[w] >> 1u;
+      for(unsigned p = 0;p < sizeof(percentiles)/sizeof(percentiles[0]);++p) {
+         ImageT filtered(image);
+         percentileFilter(image,filtered,windowSizes[w],percentiles[p]);
+         for(unsigned r = 0;r < image.rows();++r) {
+            unsigned halfRows = std::min(half,std::min(r,image.rows()-1-r));
+            for(unsigned c = 0;c < image.cols();++c) {
+               unsigned halfCols = std::min(half,std::min(c,image.cols()-1-c));
+               std::vector<uint8_t> window;
+               for(unsigned i = r-halfRows;i <= r+halfRows;++i) {
+                  for(unsigned j = c-halfCols;j <= c+halfCols;++j) window.push_back(image.pixel(i,j).namedColor.gray);
+               }
+               std::sort(window.begin(),window.end());
+               unsigned k = (unsigned)std::lround(percentiles[p]/100.0*(window.size()-1));
+               reportIfNotEqual("percentileFilter",(unsigned)filtered.pixel(r,c).namedColor.gray,(unsigned)window[k]);
+            }
+         }
+      }
+   }
+
+   // The named filters, within a view
+   ImageT median(image);
+   ImageT::image_view view = median.view(20u,30u,10u,15u);
+   medianFilter(image.view(20u,30u,10u,15u),view,5u);
+   ImageT expected(image.view(20u,30u,10u,15u));
+   ImageT expectedMedian(expected);
+   percentileFilter(expected,expectedMedian,5u,50.0);
+   for(unsigned r = 0;r < 20u;++r) {
+      for(unsigned c = 0;c < 30u;++c) reportIfNotEqual("median",median.pixel(r+10u,c+15u),expectedMedian.pixel(r,c));
+   }
+   reportIfNotEqual("outside view",median.pixel(0,0),image.pixel(0,0));
+   ImageT minimum(image);
+   ImageT maximum(image);
+   minFilter(image,minimum,3u);
+   maxFilter(image,maximum,3u);
+   reportIfNotEqual("min",(unsigned)minimum.pixel(5,5).namedColor.gray,
+                    (unsigned)std::min({image.pixel(4,4).namedColor.gray,image.pixel(4,5).namedColor.gray,image.pixel(4,6).namedColor.gray,
+                                        image.pixel(5,4).namedColor.gray,image.pixel(5,5).namedColor.gray,image.pixel(5,6).namedColor.gray,
+                                        image.pixel(6,4).namedColor.gray,image.pixel(6,5).namedColor.gray,image.pixel(6,6).namedColor.gray}));
+   reportIfNotEqual("max",(unsigned)maximum.pixel(5,5).namedColor.gray,
+                    (unsigned)std::max({image.pixel(4,4).namedColor.gray,image.pixel(4,5).namedColor.gray,image.pixel(4,6).namedColor.gray,
+                                        image.pixel(5,4).namedColor.gray,image.pixel(5,5).namedColor.gray,image.pixel(5,6).namedColor.gray,
+                                        image.pixel(6,4).namedColor.gray,image.pixel(6,5).namedColor.gray,image.pixel(6,6).namedColor.gray}));
+   try {
+      medianFilter(image,median,4u);
+      throw ExpectedError("Expected even windowSize to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+template<typename PixelT>
+void testMorphology() {
+   typedef Image<PixelT> ImageT;
+   typedef typename PixelT::value_type ValueT;
+
+   ImageT image(37u,70u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (ValueT)((r*r*131u + 7*c*r + 3*c) % 1000u);
+      }
+   }
+
+   // Brute force extremum of the (clipped) rectangle about each pixel
+   auto extremum = [](const ImageT& src,ImageT& tgt,unsigned seRows,unsigned seCols,bool maximum) {
+      for(unsigned r = 0;r < src.rows();++r) {
+         for(unsigned c = 0;c < src.cols();++c) {
+            ValueT value = src.pixel(r,c).namedColor.gray;
+            for(unsigned i = (r > seRows/2 ? r - seRows/2 : 0);i <= std::min(src.rows()-1,r + seRows/2);++i) {
+               for(unsigned j = (c > seCols/2 ? c - seCols/2 : 0);j <= std::min(src.cols()-1,c + seCols/2);++j) {
+                  ValueT v = src.pixel(i,j).namedColor.gray;
+                  value = maximum ? std::max(value,v) : std::min(value,v);
+               }
+            }
+            tgt.pixel(r,c).namedColor.gray = value;
+         }
+      }
+   };
+
+   auto same = [](const ImageT& a,const ImageT& b) {
+      for(unsigned r = 0;r < a.rows();++r) {
+         for(unsigned c = 0;c < a.cols();++c) {
+            if(a.pixel(r,c).namedColor.gray != b.pixel(r,c).namedColor.gray) return false;
+            if(a.pixel(r,c).namedColor.alpha != b.pixel(r,c).namedColor.alpha) return false;
+         }
+      }
+      return true;
+   };
+
+   simd::InstructionSet active = simd::instructionSet();
+   const unsigned seSizes[][2] = { { 1, 1 }, { 3, 1 }, { 1, 5 }, { 3, 7 }, { 9, 9 }, { 41, 101 } };
+   for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+      if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+      for(unsigned s = 0;s < sizeof(seSizes)/sizeof(seSizes[0]);++s) {
+         const unsigned seRows = seSizes[s][0];
+         const unsigned seCols = seSizes[s][1];
+         ImageT eroded(image), dilated(image), opened(image), closed(image), expected(image), temp(image);
+         erode(image,eroded,seRows,seCols);
+         dilate(image,dilated,seRows,seCols);
+         opening(image,opened,seRows,seCols);
+         closing(image,closed,seRows,seCols);
+         ImageT hat(image);
+         topHat(image,hat,seRows,seCols);
+
+         extremum(image,expected,seRows,seCols,false);
+         reportIfNotEqual("erode",same(eroded,expected),true);
+         extremum(image,expected,seRows,seCols,true);
+         reportIfNotEqual("dilate",same(dilated,expected),true);
+         extremum(image,temp,seRows,seCols,false);
+         extremum(temp,expected,seRows,seCols,true);
+         reportIfNotEqual("open",same(opened,expected),true);
+         for(unsigned r = 0;r < image.rows();++r) {
+            for(unsigned c = 0;c < image.cols();++c) {
+               reportIfNotEqual("topHat",hat.pixel(r,c).namedColor.gray,
+                                (ValueT)(image.pixel(r,c).namedColor.gray - expected.pixel(r,c).namedColor.gray));
+            }
+         }
+         extremum(image,temp,seRows,seCols,true);
+         extremum(temp,expected,seRows,seCols,false);
+         reportIfNotEqual("close",same(closed,expected),true);
+      }
+   }
+   simd::setInstructionSet(active);
+
+   // Within a view (e.g. a ROI), pixels outside the view are left alone
+   ImageT roi(image);
+   typename ImageT::image_view view = roi.view(10u,20u,5u,30u);
+   dilate(image.view(10u,20u,5u,30u),view,3u,3u);
+   ImageT sub(image.view(10u,20u,5u,30u));
+   ImageT expected(sub);
+   extremum(sub,expected,3u,3u,true);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         bool inside = r >= 5u && r < 15u && c >= 30u && c < 50u;
+         reportIfNotEqual("roi dilate",roi.pixel(r,c),inside ? expected.pixel(r-5u,c-30u) : image.pixel(r,c));
+      }
+   }
+}
+
+void testConnectedComponents() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef Image<MonochromePixel<uint32_t> > LabelImageT;
+
+   // Blobs of random pixels (and tall components that span bands of rows)
+   ImageT image(1100u,64u);
+   uint32_t seed = 12345u;
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         seed = seed*1664525u + 1013904223u;
+         image.pixel(r,c).namedColor.gray = ((seed >> 24) < 100u || c == 3u || c == 40u) ? 255u : 0u;
+      }
+   }
+
+   const unsigned connectivities[] = { 4, 8 };
+   for(unsigned n = 0;n < 2;++n) {
+      // Brute force flood fills, in raster order
+      std::vector<uint32_t> expected(image.rows()*image.cols(),0u);
+      std::vector<ComponentStats> expectedStats;
+      for(unsigned r0 = 0;r0 < image.rows();++r0) {
+         for(unsigned c0 = 0;c0 < image.cols();++c0) {
+            if(0u == image.pixel(r0,c0).namedColor.gray || 0u != expected[r0*image.cols() + c0]) continue;
+            const uint32_t label = (uint32_t)expectedStats.size() + 1u;
+            ComponentStats stats = { 0u, r0, c0, r0 + 1u, c0 + 1u, 0.0, 0.0 };
+            std::vector<std::pair<unsigned,unsigned> > stack(1,std::make_pair(r0,c0));
+            expected[r0*image.cols() + c0] = label;
+            while(!stack.empty()) {
+               const unsigned r = stack.back().first;
+               const unsigned c = stack.back().second;
+               stack.pop_back();
+               ++stats.area;
+               stats.rowCentroid += r;
+               stats.colCentroid += c;
+               stats.rowBegin = std::min(stats.rowBegin,r);
+               stats.colBegin = std::min(stats.colBegin,c);
+               stats.rowEnd = std::max(stats.rowEnd,r + 1u);
+               stats.colEnd = std::max(stats.colEnd,c + 1u);
+               for(int dr = -1;dr <= 1;++dr) {
+                  for(int dc = -1;dc <= 1;++dc) {
+                     if((0 == dr && 0 == dc) || (4u == connectivities[n] && 0 != dr && 0 != dc)) continue;
+                     const int i = (int)r + dr;
+                     const int j = (int)c + dc;
+                     if(i < 0 || j < 0 || i >= (int)image.rows() || j >= (int)image.cols()) continue;
+                     if(0u == image.pixel(i,j).namedColor.gray || 0u != expected[i*image.cols() + j]) continue;
+                     expected[i*image.cols() + j] = label;
+                     stack.push_back(std::make_pair((unsigned)i,(unsigned)j));
+                  }
+               }
+            }
+            stats.rowCentroid /= stats.area;
+            stats.colCentroid /= stats.area;
+            expectedStats.push_back(stats);
+         }
+      }
+
+      for(unsigned threads = 1;threads <= 4;++threads) {
+         setThreadCount(threads);
+         LabelImageT labels;
+         std::vector<ComponentStats> stats = connectedComponents(image,labels,connectivities[n]);
+         reportIfNotEqual("components",(unsigned)stats.size(),(unsigned)expectedStats.size());
+         for(unsigned r = 0;r < image.rows();++r) {
+            for(unsigned c = 0;c < image.cols();++c) reportIfNotEqual("label",(unsigned)labels.pixel(r,c).tuple.value0,(unsigned)expected[r*image.cols() + c]);
+         }
+         for(unsigned l = 0;l < stats.size();++l) {
+            reportIfNotEqual("area",(unsigned)stats[l].area,(unsigned)expectedStats[l].area);
+            reportIfNotEqual("rowBegin",stats[l].rowBegin,expectedStats[l].rowBegin);
+            reportIfNotEqual("colBegin",stats[l].colBegin,expectedStats[l].colBegin);
+            reportIfNotEqual("rowEnd",stats[l].rowEnd,expectedStats[l].rowEnd);
+            reportIfNotEqual("colEnd",stats[l].colEnd,expectedStats[l].colEnd);
+            reportIfNotLessThan("rowCentroid",std::fabs(stats[l].rowCentroid - expectedStats[l].rowCentroid),1e-9);
+            reportIfNotLessThan("colCentroid",std::fabs(stats[l].colCentroid - expectedStats[l].colCentroid),1e-9);
+         }
+      }
+      setThreadCount(0);
+   }
+
+   try {
+      LabelImageT labels;
+      connectedComponents(image,labels,6u);
+      throw ExpectedError("Expected connectivity 6 to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testDistanceTransform() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef Image<MonochromePixel<float> > DistanceImageT;
+
+   // A mask of blobs, with a few background pixels
+   ImageT mask(67u,83u);
+   std::vector<std::pair<int,int> > background;
+   uint32_t seed = 777u;
+   for(unsigned r = 0;r < mask.rows();++r) {
+      for(unsigned c = 0;c < mask.cols();++c) {
+         seed = seed*1664525u + 1013904223u;
+         const bool isBackground = (seed >> 24) < 4u;
+         mask.pixel(r,c).namedColor.gray = isBackground ? 0u : 255u;
+         if(isBackground) background.push_back(std::make_pair((int)r,(int)c));
+      }
+   }
+
+   DistanceImageT expected(mask.rows(),mask.cols());
+   float largest = 0.0f;
+   for(unsigned r = 0;r < mask.rows();++r) {
+      for(unsigned c = 0;c < mask.cols();++c) {
+         int nearest = std::numeric_limits<int>::max();
+         for(const std::pair<int,int>& b : background) {
+            nearest = std::min(nearest,(b.first - (int)r)*(b.first - (int)r) + (b.second - (int)c)*(b.second - (int)c));
+         }
+         expected.pixel(r,c).tuple.value0 = std::sqrt((float)nearest);
+         largest = std::max(largest,expected.pixel(r,c).tuple.value0);
+      }
+   }
+
+   for(unsigned threads = 1;threads <= 3;++threads) {
+      setThreadCount(threads);
+      DistanceImageT distances(mask.rows(),mask.cols());
+      distanceTransform(mask,distances);
+      for(unsigned r = 0;r < mask.rows();++r) {
+         for(unsigned c = 0;c < mask.cols();++c) {
+            reportIfNotLessThan("distance",std::fabs(distances.pixel(r,c).tuple.value0 - expected.pixel(r,c).tuple.value0),1e-4f);
+         }
+      }
+   }
+   setThreadCount(0);
+
+   // Normalized (by the largest distance, or saturated beyond maxDistance)
+   ImageT normalized(mask.rows(),mask.cols());
+   ImageT saturated(mask.rows(),mask.cols());
+   distanceTransform(mask,normalized);
+   distanceTransform(mask,saturated,2.0f);
+   for(unsigned r = 0;r < mask.rows();++r) {
+      for(unsigned c = 0;c < mask.cols();++c) {
+         const float distance = expected.pixel(r,c).tuple.value0;
+         reportIfNotEqual("normalized",(unsigned)normalized.pixel(r,c).namedColor.gray,(unsigned)std::floor(distance*255.0f/largest + 0.5f));
+         reportIfNotEqual("saturated",(unsigned)saturated.pixel(r,c).namedColor.gray,(unsigned)std::min(255.0f,std::floor(distance*127.5f + 0.5f)));
+      }
+   }
+
+   // Squared distances beyond 2^24 (more than 4096 pixels) are still exact
+   ImageT wide(2u,20001u);
+   for(unsigned r = 0;r < wide.rows();++r) {
+      for(unsigned c = 0;c < wide.cols();++c) wide.pixel(r,c).namedColor.gray = (0 == r && 0 == c) ? 0u : 1u;
+   }
+   Image<MonochromePixel<double> > wideDistances(wide.rows(),wide.cols());
+   distanceTransform(wide,wideDistances);
+   for(unsigned c = 4095u;c < wide.cols();c += 1999u) {
+      reportIfNotEqual("wide distance",wideDistances.pixel(0,c).tuple.value0,(double)c);
+      reportIfNotEqual("wide distance",wideDistances.pixel(1,c).tuple.value0,std::sqrt(1.0 + (double)c*c));
+   }
+
+   // Without background, distances are infinite
+   ImageT foreground(5u,7u);
+   for(unsigned r = 0;r < foreground.rows();++r) {
+      for(unsigned c = 0;c < foreground.cols();++c) foreground.pixel(r,c).namedColor.gray = 1u;
+   }
+   DistanceImageT infinite(foreground.rows(),foreground.cols());
+   distanceTransform(foreground,infinite);
+   reportIfNotEqual("infinite",std::isinf(infinite.pixel(2,3).tuple.value0),true);
+   ImageT::image_view view = normalized.view(5u,7u,10u,20u);
+   distanceTransform(foreground,view);
+   reportIfNotEqual("saturated",(unsigned)normalized.pixel(12,23).namedColor.gray,255u);
+}
+
+void testAdaptiveBinarize() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   // Dark strokes on an unevenly lit page
+   ImageT image(90u,130u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         const unsigned lighting = 60u + c + r/2u;
+         const bool stroke = (r % 15u) < 2u || (c % 23u) < 2u;
+         image.pixel(r,c).namedColor.gray = (uint8_t)(stroke ? lighting/3u : std::min(255u,lighting));
+      }
+   }
+
+   // Compare against direct window statistics at each pixel
+   const AdaptiveThreshold methods[] = { ADAPTIVE_NIBLACK, ADAPTIVE_SAUVOLA, ADAPTIVE_BRADLEY };
+   const double ks[] = { -0.2, 0.34, 0.15 };
+   const unsigned windowSizes[] = { 3, 15, 255 };
+   for(unsigned m = 0;m < 3;++m) {
+      for(unsigned w = 0;w < 3;++w) {
+         const int half = windowSizes[w] >> 1u;
+         ImageT binary(image.rows(),image.cols());
+         setThreadCount(1u + w);
+         adaptiveBinarize(image,binary,windowSizes[w],ks[m],methods[m]);
+         for(int r = 0;r < (int)image.rows();++r) {
+            for(int c = 0;c < (int)image.cols();++c) {
+               double sum = 0.0, squares = 0.0, n = 0.0;
+               for(int i = std::max(0,r-half);i <= std::min((int)image.rows()-1,r+half);++i) {
+                  for(int j = std::max(0,c-half);j <= std::min((int)image.cols()-1,c+half);++j) {
+                     const double v = image.pixel(i,j).namedColor.gray;
+                     sum += v;
+                     squares += v*v;
+                     n += 1.0;
+                  }
+               }
+               const double mean = sum/n;
+               const double deviation = std::sqrt(std::max(0.0,squares/n - mean*mean));
+               double threshold = mean*(1.0 - ks[m]);
+               if(ADAPTIVE_NIBLACK == methods[m]) threshold = mean + ks[m]*deviation;
+               if(ADAPTIVE_SAUVOLA == methods[m]) threshold = mean*(1.0 + ks[m]*(deviation/127.5 - 1.0));
+               const double value = image.pixel(r,c).namedColor.gray;
+               // Note: skip values within rounding of the threshold
+               if(std::fabs(value - threshold) < 1e-6) continue;
+               reportIfNotEqual("adaptiveBinarize",(unsigned)binary.pixel(r,c).namedColor.gray,value < threshold ? 0u : 255u);
+            }
+         }
+      }
+   }
+   setThreadCount(0);
+
+   // Sauvola finds the strokes everywhere, which no global threshold does
+   ImageT binary(image.rows(),image.cols());
+   sauvolaBinarize(image,binary,15u,0.34);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         const bool stroke = (r % 15u) < 2u || (c % 23u) < 2u;
+         reportIfNotEqual("sauvola",(unsigned)binary.pixel(r,c).namedColor.gray,stroke ? 0u : 255u);
+      }
+   }
+
+   try {
+      niblackBinarize(image,binary,14u,-0.2);
+      throw ExpectedError("Expected even windowSize to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+void testHough() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef Image<MonochromePixel<float> > DirectionImageT;
+   const double degrees = 180.0/3.141592653589793;
+
+   // A horizontal line (row 30), a vertical line (col 70) and a few stray points
+   ImageT edges(100u,120u);
+   for(unsigned c = 0;c < edges.cols();++c) edges.pixel(30,c).namedColor.gray = 255u;
+   for(unsigned r = 0;r < edges.rows();++r) edges.pixel(r,70).namedColor.gray = 255u;
+   edges.pixel(5,5).namedColor.gray = 255u;
+   edges.pixel(90,17).namedColor.gray = 255u;
+   std::vector<HoughLine> expected;
+   for(unsigned threads = 1;threads <= 3;++threads) {
+      setThreadCount(threads);
+      std::vector<HoughLine> lines = houghLines(edges,HOUGH_DEFAULT_THETA_BINS,50u,10u);
+      reportIfNotEqual("lines",(unsigned)lines.size(),2u);
+      reportIfNotEqual("first line votes",lines[0].votes,120u);
+      reportIfNotEqual("first line theta",(unsigned)std::lround(lines[0].theta*degrees),90u);
+      reportIfNotEqual("first line rho",(int)lines[0].rho,30);
+      reportIfNotEqual("second line votes",lines[1].votes,100u);
+      reportIfNotEqual("second line theta",(unsigned)std::lround(lines[1].theta*degrees),0u);
+      reportIfNotEqual("second line rho",(int)lines[1].rho,70);
+   }
+   setThreadCount(0);
+
+   // The diagonal edge of a half plane (col > row + 10), whose normal is 135 degrees:
+   // voting only near the gradient normals finds the same line
+   ImageT halfPlane(80u,90u);
+   ImageT diagonal(halfPlane.rows(),halfPlane.cols());
+   for(unsigned r = 0;r < halfPlane.rows();++r) {
+      for(unsigned c = 0;c < halfPlane.cols();++c) {
+         halfPlane.pixel(r,c).namedColor.gray = c > r + 10u ? 200u : 20u;
+         diagonal.pixel(r,c).namedColor.gray = (c == r + 10u) ? 255u : 0u;
+      }
+   }
+   DirectionImageT directions;
+   houghDirections(halfPlane,directions,3u);
+   std::vector<HoughLine> undirected = houghLines(diagonal,HOUGH_DEFAULT_THETA_BINS,30u,1u);
+   std::vector<HoughLine> directed = houghLines(diagonal,&directions,HOUGH_DEFAULT_THETA_BINS,0.05f,30u,1u);
+   reportIfNotEqual("directed lines",(unsigned)directed.size(),1u);
+   reportIfNotEqual("diagonal theta",(unsigned)std::lround(undirected[0].theta*degrees),135u);
+   reportIfNotEqual("directed theta",(unsigned)std::lround(directed[0].theta*degrees),135u);
+   reportIfNotEqual("directed rho",directed[0].rho,undirected[0].rho);
+   reportIfNotEqual("directed votes",directed[0].votes,undirected[0].votes);
+
+   // The boundary of a disk (center 50,60 with radius 20)
+   ImageT disk(120u,140u);
+   for(unsigned r = 0;r < disk.rows();++r) {
+      for(unsigned c = 0;c < disk.cols();++c) {
+         disk.pixel(r,c).namedColor.gray = std::hypot(r - 50.0,c - 60.0) <= 20.0 ? 220u : 30u;
+      }
+   }
+   ImageT boundary(disk.rows(),disk.cols());
+   for(unsigned r = 1;r + 1 < disk.rows();++r) {
+      for(unsigned c = 1;c + 1 < disk.cols();++c) {
+         bool inside = disk.pixel(r,c).namedColor.gray > 100u;
+         bool edge = inside && (disk.pixel(r-1,c).namedColor.gray < 100u || disk.pixel(r+1,c).namedColor.gray < 100u ||
+                                disk.pixel(r,c-1).namedColor.gray < 100u || disk.pixel(r,c+1).namedColor.gray < 100u);
+         boundary.pixel(r,c).namedColor.gray = edge ? 255u : 0u;
+      }
+   }
+   houghDirections(disk,directions,3u);
+   std::vector<HoughCircle> circles = houghCircles(boundary,directions,10u,30u,20u,3u);
+   reportIfNotEqual("circles",(unsigned)circles.size(),1u);
+   reportIfNotLessThan("circle row",std::fabs(circles[0].row - 50.0f),1.01f);
+   reportIfNotLessThan("circle col",std::fabs(circles[0].col - 60.0f),1.01f);
+   reportIfNotLessThan("circle radius",std::fabs(circles[0].radius - 20.0f),1.01f);
+
+   // End to end, from the gray images (edges and directions both come from their gradients)
+   ImageT drawn(halfPlane);
+   std::vector<HoughLine> detected = detectHoughLines(halfPlane,drawn,3u,3.0f,30u,1u);
+   reportIfNotEqual("detected lines",(unsigned)detected.size(),1u);
+   reportIfNotEqual("detected theta",(unsigned)std::lround(detected[0].theta*degrees),135u);
+   reportIfNotLessThan("detected rho",std::fabs(detected[0].rho - undirected[0].rho),1.01f);
+   reportIfNotEqual("drawn line",(unsigned)drawn.pixel(40,50).namedColor.gray,127u);
+
+   // The disk's edge is thinned to a ring about a pixel wide (about 2*pi*20 pixels)
+   ImageT thinEdges;
+   houghEdges(disk,thinEdges,directions,3u);
+   unsigned ringPixels = 0;
+   for(unsigned r = 0;r < disk.rows();++r) {
+      for(unsigned c = 0;c < disk.cols();++c) {
+         if(0 == thinEdges.pixel(r,c).namedColor.gray) continue;
+         ++ringPixels;
+         reportIfNotLessThan("ring radius",std::fabs(std::hypot(r - 50.0,c - 60.0) - 20.0),1.6);
+      }
+   }
+   reportIfNotLessThan("ring pixels",ringPixels,170u);
+   reportIfNotLessThan("ring pixels",100u,ringPixels);
+   reportIfNotEqual("known directions",std::isnan(directions.pixel(30,60).tuple.value0),false);
+
+   for(unsigned threads = 1;threads <= 3;++threads) {
+      setThreadCount(threads);
+      drawn = disk;
+      std::vector<HoughCircle> detectedCircles = detectHoughCircles(disk,drawn,3u,10u,30u,20u,3u);
+      reportIfNotEqual("detected circles",(unsigned)detectedCircles.size(),1u);
+      reportIfNotLessThan("detected circle row",std::fabs(detectedCircles[0].row - 50.0f),1.01f);
+      reportIfNotLessThan("detected circle col",std::fabs(detectedCircles[0].col - 60.0f),1.01f);
+      reportIfNotLessThan("detected circle radius",std::fabs(detectedCircles[0].radius - 20.0f),1.01f);
+   }
+
+   // Several disks of different radii, each refined from just the edge points near it
+   ImageT disks(200u,220u);
+   const float centers[4][3] = { { 50.0f, 50.0f, 15.0f }, { 50.0f, 160.0f, 18.0f }, { 150.0f, 50.0f, 21.0f }, { 145.0f, 160.0f, 24.0f } };
+   for(unsigned r = 0;r < disks.rows();++r) {
+      for(unsigned c = 0;c < disks.cols();++c) {
+         bool inside = false;
+         for(unsigned d = 0;d < 4;++d) inside = inside || std::hypot(r - centers[d][0],c - centers[d][1]) <= centers[d][2];
+         disks.pixel(r,c).namedColor.gray = inside ? 220u : 30u;
+      }
+   }
+   for(unsigned threads = 1;threads <= 4;threads += 3) {
+      setThreadCount(threads);
+      drawn = disks;
+      std::vector<HoughCircle> detectedCircles = detectHoughCircles(disks,drawn,3u,10u,30u,20u,8u);
+      reportIfNotEqual("detected disks",(unsigned)detectedCircles.size(),4u);
+      for(unsigned d = 0;d < 4;++d) {
+         unsigned matches = 0;
+         for(const HoughCircle& circle : detectedCircles) {
+            matches += std::fabs(circle.row - centers[d][0]) < 1.01f && std::fabs(circle.col - centers[d][1]) < 1.01f &&
+                       std::fabs(circle.radius - centers[d][2]) < 1.01f;
+         }
+         reportIfNotEqual("detected disk",matches,1u);
+      }
+   }
+   setThreadCount(0);
+}
+
+void testChannelHistogram() {
+   typedef RGBAPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef ChannelHistogram<PixelT> HistogramT;
+
+   // Large enough to be split into several bands
+   ImageT image(300u,701u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         for(unsigned ch = 0;ch < PixelT::MAX_CHANNELS;++ch) {
+            image.pixel(r,c).indexedColor[ch] = (uint8_t)((r*(ch+1) + c/(ch+1) + (c%7 == 0 ? 3 : 0))%256u);
+         }
+      }
+   }
+   std::vector<uint64_t> expected(PixelT::MAX_CHANNELS*256u,0u);
+   for(ImageT::iterator pos = image.begin();pos != image.end();++pos) {
+      for(unsigned ch = 0;ch < PixelT::MAX_CHANNELS;++ch) ++expected[ch*256u + pos->indexedColor[ch]];
+   }
+
+   const unsigned threads[] = { 1, 3 };
+   for(unsigned t = 0;t < 2;++t) {
+      setThreadCount(threads[t]);
+      HistogramT all(image);
+      HistogramT green(image,PixelT::GREEN_CHANNEL);
+      reportIfNotEqual("total",all.total(),(uint64_t)image.size());
+      for(unsigned ch = 0;ch < PixelT::MAX_CHANNELS;++ch) {
+         for(unsigned b = 0;b < 256u;++b) reportIfNotEqual("count",all.count(ch,b),expected[ch*256u + b]);
+      }
+      for(unsigned b = 0;b < 256u;++b) reportIfNotEqual("green count",green.count(PixelT::GREEN_CHANNEL,b),expected[256u + b]);
+      try {
+         green.count(PixelT::RED_CHANNEL,0);
+         throw ExpectedError("Expected uncounted channel to be reported");
+      } catch(const std::out_of_range& oor) {}
+   }
+   setThreadCount(0);
+
+   // A decimated 16-bit view
+   typedef GrayAlphaPixel<uint16_t> Pixel16T;
+   Image<Pixel16T> image16(90u,80u);
+   for(unsigned r = 0;r < image16.rows();++r) {
+      for(unsigned c = 0;c < image16.cols();++c) image16.pixel(r,c).namedColor.gray = (uint16_t)(r*c*37u);
+   }
+   ChannelHistogram<Pixel16T> decimated(image16.strided_view(3u,2u),Pixel16T::GRAY_CHANNEL);
+   reportIfNotEqual("decimated total",decimated.total(),(uint64_t)(30u*40u));
+   reportIfNotEqual("decimated zeros",decimated.count(Pixel16T::GRAY_CHANNEL,0),(uint64_t)(30u + 40u - 1u));
+}
+
+void testQuantileHistogram() {
+   typedef MonochromePixel<float> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef QuantileHistogram<float> QuantileT;
+
+   // Large enough to be split into several bands, with repeated values and
+   // values beyond the counted range
+   ImageT image(300u,701u);
+   std::vector<float> sorted;
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         float value = (float)((r*7919u + c*104729u) % 10007u)/1000.0f - 0.5f;
+         if(c%5 == 0) value = 1.25f;
+         image.pixel(r,c).tuple.value0 = value;
+         sorted.push_back(value);
+      }
+   }
+   std::sort(sorted.begin(),sorted.end());
+
+   const unsigned threads[] = { 1, 3 };
+   const unsigned bins[] = { 1u, 16u, QuantileT::DEFAULT_BINS };
+   for(unsigned t = 0;t < 2;++t) {
+      setThreadCount(threads[t]);
+      for(unsigned b = 0;b < 3;++b) {
+         QuantileT quantiles(image,0u,0.0f,9.0f,bins[b]);
+         reportIfNotEqual("total",quantiles.total(),(uint64_t)sorted.size());
+         const uint64_t ranks[] = { 0u, 1u, 5000u, sorted.size()/2u, sorted.size() - 2u, sorted.size() - 1u };
+         for(unsigned k = 0;k < 6;++k) reportIfNotEqual("rank",quantiles.rank(image,ranks[k]),sorted[ranks[k]]);
+         reportIfNotEqual("median",quantiles.quantile(image,0.5),sorted[(sorted.size() - 1u)/2u]);
+         reportIfNotEqual("max",quantiles.quantile(image,1.0),sorted.back());
+      }
+   }
+   setThreadCount(0);
+
+   // Clipping normalizes by the order statistic
+   ImageT clipped(image);
+   clippedNormalize(clipped,0.05);
+   const float clip = sorted[sorted.size() - (unsigned)(0.05*sorted.size()) + 1u];
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         float value = image.pixel(r,c).tuple.value0;
+         reportIfNotEqual("clipped",clipped.pixel(r,c).tuple.value0,value > clip ? 1.0f : value/clip);
+      }
+   }
+
+   // And 8-bit channels of a strided view
+   typedef GrayAlphaPixel<uint8_t> Pixel8T;
+   Image<Pixel8T> image8(90u,80u);
+   for(unsigned r = 0;r < image8.rows();++r) {
+      for(unsigned c = 0;c < image8.cols();++c) image8.pixel(r,c).namedColor.gray = (uint8_t)((r*c*37u) % 256u);
+   }
+   std::vector<uint8_t> sorted8;
+   for(unsigned r = 0;r < image8.rows();r += 3u) {
+      for(unsigned c = 0;c < image8.cols();c += 2u) sorted8.push_back(image8.pixel(r,c).namedColor.gray);
+   }
+   std::sort(sorted8.begin(),sorted8.end());
+   QuantileHistogram<uint8_t> decimated(image8.strided_view(3u,2u),Pixel8T::GRAY_CHANNEL,0u,255u,64u);
+   reportIfNotEqual("decimated total",decimated.total(),(uint64_t)(30u*40u));
+   for(unsigned k = 0;k < sorted8.size();k += 97u) {
+      reportIfNotEqual("decimated rank",decimated.rank(image8.strided_view(3u,2u),k),sorted8[k]);
+   }
+}
+
+void testHistogramEqualize() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   // Values crowded into [100,116)
+   ImageT image(64u,64u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) image.pixel(r,c).namedColor.gray = (uint8_t)(100u + (r*64u + c)/256u);
+   }
+   ImageT equalized(image.rows(),image.cols());
+   histogramEqualize(image,equalized);
+   // 16 equally occupied values are spread evenly over [0,255]
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         unsigned v = image.pixel(r,c).namedColor.gray - 100u;
+         unsigned expected = (unsigned)std::floor(255.0*v/15.0 + 0.5);
+         reportIfNotEqual("equalized",(unsigned)equalized.pixel(r,c).namedColor.gray,expected);
+      }
+   }
+}
+
+void testHistogramUnify() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+
+   // The radix sort matches a comparison sort, across several blocks
+   std::vector<uint64_t> keys(300000u);
+   uint64_t state = 88172645463325252ull;
+   for(uint64_t& key : keys) {
+      state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+      key = state & 0xFFFFFF00FF00FFFFull; // some constant bytes
+   }
+   std::vector<uint64_t> expectedKeys(keys);
+   std::sort(expectedKeys.begin(),expectedKeys.end());
+   setThreadCount(3u);
+   radixSort(keys);
+   setThreadCount(0);
+   reportIfEqual("radixSort",keys == expectedKeys,false);
+
+   // Few values, in textured regions
+   ImageT image(400u,400u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)(40u*((r/50u + c/80u) % 4u) + (r*c) % 3u);
+      }
+   }
+
+   const unsigned windowSizes[] = { 3, 15 };
+   for(unsigned w = 0;w < 2;++w) {
+      // Rank directly by value, mean of squares (over the symmetric window) and index
+      const int half = windowSizes[w] >> 1u;
+      const int rows = image.rows(), cols = image.cols();
+      std::vector<std::pair<std::pair<unsigned,unsigned>,unsigned> > ranked;
+      for(int r = 0;r < rows;++r) {
+         const int halfRows = std::min(half,std::min(r,rows-1-r));
+         for(int c = 0;c < cols;++c) {
+            const int halfCols = std::min(half,std::min(c,cols-1-c));
+            double squares = 0.0;
+            for(int i = r-halfRows;i <= r+halfRows;++i) {
+               for(int j = c-halfCols;j <= c+halfCols;++j) {
+                  const double v = image.pixel(i,j).namedColor.gray;
+                  squares += v*v;
+               }
+            }
+            squares /= (2*halfRows + 1)*(2*halfCols + 1);
+            ranked.push_back(std::make_pair(std::make_pair((unsigned)image.pixel(r,c).namedColor.gray,
+                                                           (unsigned)(squares*65535.0/(255.0*255.0) + 0.5)),(unsigned)(r*cols + c)));
+         }
+      }
+      std::sort(ranked.begin(),ranked.end());
+
+      ImageT unified(image.rows(),image.cols());
+      setThreadCount(1u + w);
+      histogramUnify(image,unified,windowSizes[w]);
+      std::vector<unsigned> counts(256u,0u);
+      for(unsigned k = 0;k < ranked.size();++k) {
+         const unsigned index = ranked[k].second;
+         const unsigned value = unified.pixel(index/cols,index%cols).namedColor.gray;
+         reportIfNotEqual("histogramUnify",value,(unsigned)((uint64_t)k*256u/ranked.size()));
+         ++counts[value];
+      }
+      // 160000 pixels are exactly 625 of each value
+      for(unsigned v = 0;v < counts.size();++v) reportIfNotEqual("histogramUnify (histogram)",counts[v],625u);
+   }
+   setThreadCount(0);
+
+   try {
+      ImageT unified(image.rows(),image.cols());
+      histogramUnify(image,unified,4u);
+      throw ExpectedError("Expected even windowSize to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+// A direct (double precision) CLAHE, as a reference
+template<typename ImageT>
+std::vector<double> referenceAdaptiveEqualize(const ImageT& image,unsigned tiles,double clipLimit) {
+   const unsigned rows = image.rows(), cols = image.cols();
+   const unsigned bins = (unsigned)ImageT::pixel_type::traits::max() + 1u;
+   const double maxValue = bins - 1u;
+   std::vector<double> rowCenters(tiles), colCenters(tiles);
+   std::vector<std::vector<double> > luts(tiles*tiles,std::vector<double>(bins));
+   for(unsigned ty = 0;ty < tiles;++ty) {
+      const unsigned r0 = ty*rows/tiles, r1 = (ty + 1u)*rows/tiles;
+      rowCenters[ty] = (r0 + r1)/2.0;
+      for(unsigned tx = 0;tx < tiles;++tx) {
+         const unsigned c0 = tx*cols/tiles, c1 = (tx + 1u)*cols/tiles;
+         colCenters[tx] = (c0 + c1)/2.0;
+         std::vector<unsigned> histogram(bins,0u);
+         for(unsigned r = r0;r < r1;++r) {
+            for(unsigned c = c0;c < c1;++c) ++histogram[image.pixel(r,c).tuple.value0];
+         }
+         const unsigned total = (r1 - r0)*(c1 - c0);
+         const unsigned limit = clipLimit > 0.0 ? std::max(1u,(unsigned)(clipLimit*total/bins)) : total;
+         unsigned excess = 0;
+         for(unsigned b = 0;b < bins;++b) if(histogram[b] > limit) excess += histogram[b] - limit, histogram[b] = limit;
+         for(unsigned b = 0;b < bins;++b) histogram[b] += excess/bins;
+         for(unsigned b = 0,left = excess % bins;left > 0;b += std::max(1u,bins/(excess % bins)),--left) ++histogram[b];
+         double cumulative = 0.0;
+         for(unsigned b = 0;b < bins;++b) luts[ty*tiles + tx][b] = (cumulative += histogram[b])*maxValue/total;
+      }
+   }
+   // Interpolation between the surrounding tile centers
+   auto surrounding = [&](const std::vector<double>& centers,double x,unsigned& t0,unsigned& t1,double& weight) {
+      t0 = 0;
+      while(t0 + 1u < tiles && centers[t0 + 1u] <= x) ++t0;
+      t1 = std::min(t0 + 1u,tiles - 1u);
+      weight = t1 != t0 && x > centers[t0] ? (x - centers[t0])/(centers[t1] - centers[t0]) : 0.0;
+   };
+   std::vector<double> equalized(rows*cols);
+   for(unsigned r = 0;r < rows;++r) {
+      unsigned ty0, ty1; double wy;
+      surrounding(rowCenters,r + 0.5,ty0,ty1,wy);
+      for(unsigned c = 0;c < cols;++c) {
+         unsigned tx0, tx1; double wx;
+         surrounding(colCenters,c + 0.5,tx0,tx1,wx);
+         const unsigned v = image.pixel(r,c).tuple.value0;
+         equalized[r*cols + c] = (1.0 - wy)*((1.0 - wx)*luts[ty0*tiles + tx0][v] + wx*luts[ty0*tiles + tx1][v]) +
+                                 wy*((1.0 - wx)*luts[ty1*tiles + tx0][v] + wx*luts[ty1*tiles + tx1][v]);
+      }
+   }
+   return equalized;
+}
+
+void testAdaptiveEqualize() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef GrayAlphaPixel<uint16_t> Pixel16T;
+   typedef Image<Pixel16T> Image16T;
+
+   // Dark on the left, crowded bright on the right (uneven tiles)
+   ImageT image(70u,93u);
+   Image16T image16(70u,93u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         const unsigned v = c < 40u ? 10u + (r*3u + c*5u) % 40u : 180u + (r*c) % 20u;
+         image.pixel(r,c).namedColor.gray = (uint8_t)v;
+         image16.pixel(r,c).namedColor.gray = (uint16_t)(v*257u + (r + c) % 7u);
+      }
+   }
+
+   const unsigned tiles[] = { 1, 4, 8 };
+   const double clipLimits[] = { 0.0, 2.0, 40.0 };
+   for(unsigned t = 0;t < 3;++t) {
+      for(unsigned l = 0;l < 3;++l) {
+         const std::vector<double> expected = referenceAdaptiveEqualize(image,tiles[t],clipLimits[l]);
+         ImageT equalized(image.rows(),image.cols());
+         setThreadCount(1u + l);
+         adaptiveEqualize(image,equalized,tiles[t],clipLimits[l]);
+         for(unsigned r = 0;r < image.rows();++r) {
+            for(unsigned c = 0;c < image.cols();++c) {
+               const double difference = std::fabs(equalized.pixel(r,c).namedColor.gray - expected[r*image.cols() + c]);
+               reportIfNotLessThan("adaptiveEqualize",difference,0.5 + 1e-3);
+            }
+         }
+      }
+   }
+   setThreadCount(0);
+
+   const std::vector<double> expected16 = referenceAdaptiveEqualize(image16,4u,3.0);
+   Image16T equalized16(image16.rows(),image16.cols());
+   adaptiveEqualize(image16,equalized16,4u,3.0);
+   for(unsigned r = 0;r < image16.rows();++r) {
+      for(unsigned c = 0;c < image16.cols();++c) {
+         const double difference = std::fabs(equalized16.pixel(r,c).namedColor.gray - expected16[r*image16.cols() + c]);
+         reportIfNotLessThan("adaptiveEqualize (16-bit)",difference,0.5 + 0.02);
+      }
+   }
+
+   // Gray color pixels keep no hue or saturation, so their intensity equalizes as gray
+   Image<RGBAPixel<uint8_t> > color(image.rows(),image.cols());
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         const uint8_t v = image.pixel(r,c).namedColor.gray;
+         color.pixel(r,c).namedColor.red = color.pixel(r,c).namedColor.green = color.pixel(r,c).namedColor.blue = v;
+      }
+   }
+   Image<RGBAPixel<uint8_t> > colorEqualized(color.rows(),color.cols());
+   adaptiveEqualize(color,colorEqualized,4u,2.0);
+   ImageT equalized(image.rows(),image.cols());
+   adaptiveEqualize(image,equalized,4u,2.0);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         const int gray = equalized.pixel(r,c).namedColor.gray;
+         reportIfNotLessThan("adaptiveEqualize (color)",std::abs(colorEqualized.pixel(r,c).namedColor.red - gray),2);
+         reportIfNotLessThan("adaptiveEqualize (color)",std::abs(colorEqualized.pixel(r,c).namedColor.blue - gray),2);
+      }
+   }
+
+   try {
+      adaptiveEqualize(image,equalized,0u,2.0);
+      throw ExpectedError("Expected 0 tiles to be reported");
+   } catch(const std::out_of_range& oor) {}
+}
+
+// The original pixel-domain isodata iteration, as a reference
+template<typename ImageT>
+unsigned referenceOptimalThreshold(const ImageT& image,unsigned tolerance) {
+   uint64_t sum = 0;
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) sum += image.pixel(r,c).tuple.value0;
+   }
+   unsigned threshold = (unsigned)((double)sum/image.size());
+   unsigned thresholdLast = 0;
+   while((thresholdLast > threshold ? thresholdLast - threshold : threshold - thresholdLast) > tolerance) {
+      thresholdLast = threshold;
+      uint64_t sumBG = 0, sumFG = 0, numberBG = 0, numberFG = 0;
+      for(unsigned r = 0;r < image.rows();++r) {
+         for(unsigned c = 0;c < image.cols();++c) {
+            unsigned v = image.pixel(r,c).tuple.value0;
+            if(v < threshold) sumBG += v, ++numberBG;
+            else sumFG += v, ++numberFG;
+         }
+      }
+      threshold = (unsigned)(((double)sumFG/numberFG + (double)sumBG/numberBG)/2);
+   }
+   return threshold;
+}
+
+void testOptimalThreshold() {
+   typedef GrayAlphaPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef GrayAlphaPixel<uint16_t> Pixel16T;
+   typedef Image<Pixel16T> Image16T;
+
+   ImageT image(120u,150u);
+   Image16T image16(120u,150u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         unsigned v = (c < 50 ? 30u : 170u) + (r*7u + c*13u)%60u;
+         image.pixel(r,c).namedColor.gray = (uint8_t)v;
+         image16.pixel(r,c).namedColor.gray = (uint16_t)(v*257u + (r*c)%200u);
+      }
+   }
+   reportIfNotEqual("optimalThreshold",(unsigned)optimalThreshold(image),referenceOptimalThreshold(image,1u));
+   reportIfNotEqual("optimalThreshold 16-bit",(unsigned)optimalThreshold(image16),referenceOptimalThreshold(image16,257u));
+
+   // The same solver on an ROI
+   const ImageT& cimage = image;
+   ImageT::const_image_view roi = cimage.view(60u,80u,30u,20u);
+   ImageT roiImage(roi);
+   reportIfNotEqual("optimalThreshold roi",(unsigned)optimalThreshold(roi),referenceOptimalThreshold(roiImage,1u));
+
+   ImageT binary(image.rows(),image.cols());
+   optimalBinarize(image,binary);
+   unsigned threshold = optimalThreshold(image);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         unsigned expected = image.pixel(r,c).namedColor.gray < threshold ? 0u : 255u;
+         reportIfNotEqual("optimalBinarize",(unsigned)binary.pixel(r,c).namedColor.gray,expected);
+      }
+   }
+}
+
+template<typename ImageT,typename FuncT>
+void checkPointOperation(const char* name,const ImageT& src,FuncT func,unsigned channelMask) {
+   typedef typename ImageT::pixel_type PixelT;
+   ImageT tgt(src.rows(),src.cols());
+   pointOperation(src,tgt,func,channelMask);
+   for(unsigned r = 0;r < src.rows();++r) {
+      for(unsigned c = 0;c < src.cols();++c) {
+         for(unsigned ch = 0;ch < PixelT::MAX_CHANNELS;++ch) {
+            unsigned expected = (channelMask >> ch) & 1u ? (unsigned)func(src.pixel(r,c).indexedColor[ch]) :
+                                                           (unsigned)src.pixel(r,c).indexedColor[ch];
+            reportIfNotEqual(name,(unsigned)tgt.pixel(r,c).indexedColor[ch],expected);
+         }
+      }
+   }
+}
+
+void testLookupTable() {
+   typedef GrayAlphaPixel<uint8_t> GrayT;
+   typedef RGBAPixel<uint8_t> RGBAT;
+   typedef GrayAlphaPixel<uint16_t> Gray16T;
+
+   // Odd sizes, so that rows end in partial vectors
+   Image<GrayT> gray(37u,101u);
+   Image<RGBAT> color(29u,83u);
+   Image<Gray16T> gray16(31u,67u);
+   for(unsigned r = 0;r < gray.rows();++r) {
+      for(unsigned c = 0;c < gray.cols();++c) {
+         gray.pixel(r,c).namedColor.gray = (uint8_t)(r*11u + c*3u);
+         gray.pixel(r,c).namedColor.alpha = (uint8_t)(r + c);
+      }
+   }
+   for(unsigned r = 0;r < color.rows();++r) {
+      for(unsigned c = 0;c < color.cols();++c) {
+         for(unsigned ch = 0;ch < RGBAT::MAX_CHANNELS;++ch) color.pixel(r,c).indexedColor[ch] = (uint8_t)(r*7u + c*(ch+1u));
+      }
+   }
+   for(unsigned r = 0;r < gray16.rows();++r) {
+      for(unsigned c = 0;c < gray16.cols();++c) {
+         gray16.pixel(r,c).namedColor.gray = (uint16_t)(r*2111u + c*977u);
+         gray16.pixel(r,c).namedColor.alpha = (uint16_t)(r*c);
+      }
+   }
+
+   simd::InstructionSet active = simd::instructionSet();
+   for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+      if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+      checkPointOperation("add",gray,point::Add<GrayT>(40),colorChannelMask<GrayT>());
+      checkPointOperation("binarize",gray,point::Threshold<GrayT>(100u),colorChannelMask<GrayT>());
+      checkPointOperation("binarizeDT",gray,point::DoubleThreshold<GrayT>(50u,150u),colorChannelMask<GrayT>());
+      checkPointOperation("histMod",gray,point::HistogramStretch<GrayT>(20u,200u),colorChannelMask<GrayT>());
+      checkPointOperation("add rgb",color,point::Add<RGBAT>(-60),colorChannelMask<RGBAT>());
+      checkPointOperation("histMod rgb",color,point::LinearStretch<RGBAT>(30u,180u),colorChannelMask<RGBAT>());
+      checkPointOperation("histMod green",color,point::LinearStretch<RGBAT>(30u,180u),1u << RGBAT::GREEN_CHANNEL);
+      checkPointOperation("add 16-bit",gray16,point::Add<Gray16T>(30000),colorChannelMask<Gray16T>());
+      checkPointOperation("histMod 16-bit",gray16,point::HistogramStretch<Gray16T>(1000u,60000u),colorChannelMask<Gray16T>());
+   }
+   simd::setInstructionSet(active);
+
+   // Tables also apply to (non-contiguous) strided views
+   Image<GrayT> decimated(gray.strided_view(2u,3u));
+   Image<GrayT> binary(decimated.rows(),decimated.cols());
+   applyLookupTable(gray.strided_view(2u,3u),binary,LookupTable<uint8_t>(point::Threshold<GrayT>(128u)),colorChannelMask<GrayT>());
+   for(unsigned r = 0;r < binary.rows();++r) {
+      for(unsigned c = 0;c < binary.cols();++c) {
+         unsigned expected = decimated.pixel(r,c).namedColor.gray < 128u ? 0u : 255u;
+         reportIfNotEqual("strided lookup",(unsigned)binary.pixel(r,c).namedColor.gray,expected);
+      }
+   }
+
+   // Tables are cached per parameters
+   LookupTableCache<uint8_t,std::string> cache;
+   unsigned made = 0;
+   cache.table("40",[&]() { ++made; return LookupTable<uint8_t>(point::Add<GrayT>(40)); });
+   const LookupTable<uint8_t>& table = cache.table("40",[&]() { ++made; return LookupTable<uint8_t>(point::Add<GrayT>(40)); });
+   cache.table("-5",[&]() { ++made; return LookupTable<uint8_t>(point::Add<GrayT>(-5)); });
+   reportIfNotEqual("cached tables",cache.size(),2u);
+   reportIfNotEqual("made tables",made,2u);
+   reportIfNotEqual("cached table",(unsigned)table[250],255u);
+
+   // A chain of point operations composes into a single table
+   LookupTable<uint8_t> chained;
+   chained = compose(chained,LookupTable<uint8_t>(point::Add<GrayT>(-30)));
+   chained = compose(chained,LookupTable<uint8_t>(point::HistogramStretch<GrayT>(10u,180u)));
+   chained = compose(chained,LookupTable<uint8_t>(point::Threshold<GrayT>(120u)));
+   Image<GrayT> first(gray);
+   Image<GrayT> second(gray);
+   Image<GrayT> third(gray);
+   pointOperation(gray,first,point::Add<GrayT>(-30),colorChannelMask<GrayT>());
+   pointOperation(first,second,point::HistogramStretch<GrayT>(10u,180u),colorChannelMask<GrayT>());
+   pointOperation(second,third,point::Threshold<GrayT>(120u),colorChannelMask<GrayT>());
+   Image<GrayT> composed(gray);
+   applyLookupTable(gray,composed,chained,colorChannelMask<GrayT>());
+   for(unsigned r = 0;r < gray.rows();++r) {
+      for(unsigned c = 0;c < gray.cols();++c) {
+         reportIfNotEqual("composed lookup",(unsigned)composed.pixel(r,c).namedColor.gray,
+                                            (unsigned)third.pixel(r,c).namedColor.gray);
+      }
+   }
+}
+
+void testLookupChain() {
+   using namespace batchIP::operation;
+   // As batchIP's isGrayscaleOperation, for the operations below
+   const auto grayscale = [](const std::string& operation) { return operation == "binarize" || operation == "median"; };
+   const auto color = [](const std::string&) { return false; };
+
+   // A chain whose intermediate files nobody else reads, across a comment and a blank line
+   std::vector<std::string> lines;
+   lines.push_back("a.pgm b.pgm add 10");
+   lines.push_back("# comment");
+   lines.push_back("b.pgm c.pgm histMod 10 200");
+   lines.push_back("");
+   lines.push_back("c.pgm d.pgm binarize 100");
+   lines.push_back("d.pgm e.pgm uniformSmooth 3");
+   std::vector<LookupChain> chains = planLookupChains(lines,grayscale);
+   reportIfNotEqual("chains",chains.size(),(std::size_t)1u);
+   reportIfNotEqual("chain first",chains[0].first,0u);
+   reportIfNotEqual("chain count",chains[0].count,5u);
+   reportIfNotEqual("chain operations",chains[0].operations.size(),(std::size_t)3u);
+   // Whether it composes is settled by the pixel type at processing time
+   reportIfNotEqual("grayscale chain",isLookupChain(chains[0],true),true);
+   reportIfNotEqual("color chain",isLookupChain(chains[0],false),false);
+   reportIfNotEqual("chain output",chains[0].operations.back().outputfile,std::string("d.pgm"));
+
+   // binarize only chains as a grayscale operation
+   chains = planLookupChains(lines,color);
+   reportIfNotEqual("color chains",chains.size(),(std::size_t)1u);
+   reportIfNotEqual("color chain count",chains[0].count,3u);
+
+   // An outside reader of b.pgm keeps it (so the chain starts after it)
+   lines.push_back("b.pgm f.pgm median 3");
+   chains = planLookupChains(lines,grayscale);
+   reportIfNotEqual("read chains",chains.size(),(std::size_t)1u);
+   reportIfNotEqual("read chain first",chains[0].first,2u);
+   reportIfNotEqual("read chain count",chains[0].count,3u);
+
+   // An outside reader of each intermediate file leaves no chain
+   lines.push_back("c.pgm g.pgm median 3");
+   reportIfNotEqual("no chains",planLookupChains(lines,grayscale).size(),(std::size_t)0u);
+
+   // Nor do lines with ROIs, in place lines, or lines that don't read the prior output
+   std::vector<std::string> unchained;
+   unchained.push_back("a.pgm b.pgm add 10 ROI: 0 0 10 10 5");
+   unchained.push_back("b.pgm c.pgm add 10");
+   unchained.push_back("c.pgm c.pgm add 10");
+   unchained.push_back("c.pgm d.pgm add 10");
+   unchained.push_back("x.pgm y.pgm add 10");
+   reportIfNotEqual("unchained",planLookupChains(unchained,grayscale).size(),(std::size_t)0u);
+   unchained.push_back("y.pgm z.pgm add 10");
+   chains = planLookupChains(unchained,grayscale);
+   reportIfNotEqual("last chain",chains.size(),(std::size_t)1u);
+   reportIfNotEqual("last chain first",chains[0].first,4u);
+}
+
+void testColorConversion() {
+   typedef RGBAPixel<uint8_t> RGBAT;
+   typedef HSIPixel<double> HSIT;
+
+   // A sampling of the RGB cube (including black, white and grays)
+   const unsigned step = 5u;
+   const unsigned levels = 255u/step + 1u;
+   Image<RGBAT> rgba(levels*levels,levels);
+   for(unsigned r = 0;r < levels;++r) {
+      for(unsigned g = 0;g < levels;++g) {
+         for(unsigned b = 0;b < levels;++b) {
+            RGBAT& pixel = rgba.pixel(r*levels + g,b);
+            pixel.namedColor.red = (uint8_t)(r*step);
+            pixel.namedColor.green = (uint8_t)(g*step);
+            pixel.namedColor.blue = (uint8_t)(b*step);
+         }
+      }
+   }
+   Image<HSIT> exact(rgba);
+   Image<RGBAT> exactRGBA(rgba);
+   exactRGBA = exact;
+
+   simd::InstructionSet active = simd::instructionSet();
+   for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+      if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+      Image<HSIT> batch(rgba.rows(),rgba.cols());
+      convertRGBAToHSI(rgba,batch);
+      Image<RGBAT> batchRGBA(rgba);
+      convertHSIToRGBA(batch,batchRGBA);
+      for(unsigned r = 0;r < rgba.rows();++r) {
+         for(unsigned c = 0;c < rgba.cols();++c) {
+            for(unsigned ch = 0;ch < HSIT::MAX_CHANNELS;++ch) {
+               double error = std::fabs(batch.pixel(r,c).indexedColor[ch] - exact.pixel(r,c).indexedColor[ch]);
+               if(error > 2e-6) {
+                  std::stringstream ss;
+                  ss << "HSI conversion error: " << error << " at " << rgba.pixel(r,c);
+                  throw ExpectedError(ss.str());
+               }
+            }
+            for(unsigned ch = 0;ch < 3u;++ch) {
+               int error = (int)batchRGBA.pixel(r,c).indexedColor[ch] - (int)exactRGBA.pixel(r,c).indexedColor[ch];
+               reportIfNotLessThan("RGBA conversion error",(unsigned)std::abs(error),2u);
+            }
+         }
+      }
+   }
+   simd::setInstructionSet(active);
+
+   // The approximations hold their documented error
+   for(unsigned k = 0;k <= 2000u;++k) {
+      double x = -1.0 + k/1000.0;
+      reportIfNotLessThan("acosApprox",std::fabs(simd::acosApprox((float)x) - std::acos(x)),1e-6);
+      double a = (x*2.0/3.0)*3.14159265358979;
+      reportIfNotLessThan("cosApprox",std::fabs(simd::cosApprox((float)a) - std::cos(a)),1e-6);
+   }
+}
+
+void testStreamingHSI() {
+   typedef RGBAPixel<uint8_t> RGBAT;
+   typedef HSIPixel<float> HSIT;
+
+   Image<RGBAT> rgba(53u,301u); // rows span more than one block
+   for(unsigned r = 0;r < rgba.rows();++r) {
+      for(unsigned c = 0;c < rgba.cols();++c) {
+         RGBAT& pixel = rgba.pixel(r,c);
+         pixel.namedColor.red = (uint8_t)(r*4u + c);
+         pixel.namedColor.green = (uint8_t)(c*7u);
+         pixel.namedColor.blue = (uint8_t)(60u + (r*c) % 120u);
+      }
+   }
+
+   // Streaming matches converting whole images
+   Image<HSIT> hsi(rgba.rows(),rgba.cols());
+   convertRGBAToHSI(rgba,hsi);
+   linearlyStretchChannel(hsi,0u,255u,40u,200u,(unsigned)HSIT::INTENSITY_CHANNEL);
+   Image<RGBAT> expected(rgba);
+   convertHSIToRGBA(hsi,expected);
+   Image<RGBAT> streamed(rgba);
+   histogramModifyIntensity(rgba,streamed,40u,200u);
+   for(unsigned r = 0;r < rgba.rows();++r) {
+      for(unsigned c = 0;c < rgba.cols();++c) {
+         for(unsigned ch = 0;ch < 3u;++ch) {
+            reportIfNotEqual("streamed histModI",(unsigned)streamed.pixel(r,c).indexedColor[ch],
+                                                 (unsigned)expected.pixel(r,c).indexedColor[ch]);
+         }
+      }
+   }
+
+   // Afixing a channel likewise
+   convertRGBAToHSI(rgba,hsi);
+   for(Image<HSIT>::iterator pos = hsi.begin();pos != hsi.end();++pos) pos->namedColor.saturation = 128.0f/255.0f;
+   convertHSIToRGBA(hsi,expected);
+   Image<RGBAT> afixed(rgba);
+   afixAnyHSI(rgba,afixed,(uint8_t)128u,(unsigned)HSIT::SATURATION_CHANNEL);
+   for(unsigned r = 0;r < rgba.rows();++r) {
+      for(unsigned c = 0;c < rgba.cols();++c) {
+         for(unsigned ch = 0;ch < 3u;++ch) {
+            reportIfNotEqual("streamed afixAnyHSI",(unsigned)afixed.pixel(r,c).indexedColor[ch],
+                                                   (unsigned)expected.pixel(r,c).indexedColor[ch]);
+         }
+      }
+   }
+
+   // Equalized intensity spans the full range
+   Image<RGBAT> equalized(rgba);
+   histogramEqualize(rgba,equalized);
+   Image<MonochromePixel<uint8_t> > intensity(rgba.rows(),rgba.cols());
+   selectHSIChannel(equalized,intensity,(unsigned)HSIT::INTENSITY_CHANNEL);
+   unsigned low = 255u;
+   unsigned high = 0u;
+   for(Image<MonochromePixel<uint8_t> >::iterator pos = intensity.begin();pos != intensity.end();++pos) {
+      low = std::min(low,(unsigned)pos->tuple.value0);
+      high = std::max(high,(unsigned)pos->tuple.value0);
+   }
+   reportIfNotLessThan("equalized low",low,8u);
+   reportIfNotLessThan("equalized high",240u,high);
+}
+
+void testResample() {
+   typedef GrayAlphaPixel<uint8_t> GrayT;
+   typedef RGBAPixel<uint8_t> RGBAT;
+
+   Image<GrayT> gray(30u,44u);
+   for(unsigned r = 0;r < gray.rows();++r) {
+      for(unsigned c = 0;c < gray.cols();++c) {
+         gray.pixel(r,c).namedColor.gray = (uint8_t)((r*37u + c*11u) % 256u);
+         gray.pixel(r,c).namedColor.alpha = 255u;
+      }
+   }
+
+   // Halving averages 2x2 pixels, and doubling replicates them
+   Image<GrayT> half(gray);
+   scale(gray,half,0.5f);
+   reportIfNotEqual("half rows",half.rows(),15u);
+   reportIfNotEqual("half cols",half.cols(),22u);
+   for(unsigned r = 0;r < half.rows();++r) {
+      for(unsigned c = 0;c < half.cols();++c) {
+         unsigned sum = gray.pixel(2*r,2*c).namedColor.gray + gray.pixel(2*r,2*c+1).namedColor.gray +
+                        gray.pixel(2*r+1,2*c).namedColor.gray + gray.pixel(2*r+1,2*c+1).namedColor.gray;
+         reportIfNotEqual("half",(unsigned)half.pixel(r,c).namedColor.gray,(sum + 2u)/4u);
+      }
+   }
+   Image<GrayT> twice(gray);
+   scale(gray,twice,2.0f);
+   reportIfNotEqual("twice rows",twice.rows(),60u);
+   for(unsigned r = 0;r < twice.rows();++r) {
+      for(unsigned c = 0;c < twice.cols();++c) {
+         reportIfNotEqual("twice",(unsigned)twice.pixel(r,c).namedColor.gray,(unsigned)gray.pixel(r/2,c/2).namedColor.gray);
+      }
+   }
+
+   // Interpolation preserves linear ramps (away from the borders), for all
+   // channels, instruction sets and thread counts
+   Image<RGBAT> ramp(24u,40u);
+   for(unsigned r = 0;r < ramp.rows();++r) {
+      for(unsigned c = 0;c < ramp.cols();++c) {
+         ramp.pixel(r,c).namedColor.red = (uint8_t)(c*6u);
+         ramp.pixel(r,c).namedColor.green = (uint8_t)(r*10u);
+         ramp.pixel(r,c).namedColor.blue = 77u;
+         ramp.pixel(r,c).namedColor.alpha = 255u;
+      }
+   }
+   simd::InstructionSet active = simd::instructionSet();
+   unsigned threads = threadCount();
+   for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+      if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+      for(unsigned t = 1;t <= 3u;t += 2u) {
+         setThreadCount(t);
+         for(unsigned method = RESAMPLE_BILINEAR;method <= RESAMPLE_BICUBIC;++method) {
+            Image<RGBAT> enlarged(ramp);
+            resample(ramp,enlarged,2.5f,(ResampleMethod)method);
+            reportIfNotEqual("enlarged rows",enlarged.rows(),60u);
+            reportIfNotEqual("enlarged cols",enlarged.cols(),100u);
+            for(unsigned r = 5;r + 5 < enlarged.rows();++r) {
+               for(unsigned c = 5;c + 5 < enlarged.cols();++c) {
+                  const RGBAT& pixel = enlarged.pixel(r,c);
+                  double red = ((c + 0.5)/2.5 - 0.5)*6.0;
+                  double green = ((r + 0.5)/2.5 - 0.5)*10.0;
+                  reportIfNotLessThan("bilinear red",std::fabs(pixel.namedColor.red - red),1.0);
+                  reportIfNotLessThan("bilinear green",std::fabs(pixel.namedColor.green - green),1.0);
+                  reportIfNotEqual("bilinear blue",(unsigned)pixel.namedColor.blue,77u);
+                  reportIfNotEqual("bilinear alpha",(unsigned)pixel.namedColor.alpha,255u);
+               }
+            }
+         }
+         // Area reduction by a non-integral ratio keeps constant channels
+         Image<RGBAT> reduced(ramp);
+         resample(ramp,reduced,0.3f,RESAMPLE_AREA);
+         reportIfNotEqual("reduced rows",reduced.rows(),7u);
+         reportIfNotEqual("reduced cols",reduced.cols(),12u);
+         for(Image<RGBAT>::iterator pos = reduced.begin();pos != reduced.end();++pos) {
+            reportIfNotEqual("reduced blue",(unsigned)pos->namedColor.blue,77u);
+         }
+      }
+   }
+   setThreadCount(threads);
+   simd::setInstructionSet(active);
+}
+
+void testBinarizeColor() {
+   typedef RGBAPixel<uint8_t> PixelT;
+   typedef Image<PixelT> ImageT;
+   typedef ColorReference<PixelT> ReferenceT;
+
+   // Odd width so that vector loops have tails
+   ImageT image(37u,53u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         PixelT& pixel = image.pixel(r,c);
+         pixel.namedColor.red = (uint8_t)(100u + (r*7u + c*3u) % 40u);
+         pixel.namedColor.green = (uint8_t)(90u + (r*5u + c*11u) % 50u);
+         pixel.namedColor.blue = (uint8_t)((r*c*13u) % 256u);
+         pixel.namedColor.alpha = (uint8_t)(r + c);
+      }
+   }
+   std::vector<ReferenceT> references;
+   PixelT color;
+   color.namedColor.red = 120u; color.namedColor.green = 110u; color.namedColor.blue = 30u;
+   // Note: an integral squared threshold (distance 25 is not within it)
+   references.push_back(ReferenceT(5.0f,color));
+   color.namedColor.red = 135u; color.namedColor.green = 130u; color.namedColor.blue = 200u;
+   references.push_back(ReferenceT(20.5f,color));
+   color.namedColor.red = 0u; color.namedColor.green = 255u; color.namedColor.blue = 0u;
+   references.push_back(ReferenceT(1000.0f,color));
+
+   simd::InstructionSet active = simd::instructionSet();
+   for(unsigned n = 1;n <= references.size();++n) {
+      std::vector<ReferenceT> some(references.begin(),references.begin() + n);
+      for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+         if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+         ImageT tgt(image);
+         binarizeColor(image,tgt,some);
+         // A strided view takes the scalar path
+         ImageT strided(image);
+         ImageT::strided_image_view view = strided.strided_view(2u,3u);
+         binarizeColor(image.strided_view(2u,3u),view,some);
+         for(unsigned r = 0;r < image.rows();++r) {
+            for(unsigned c = 0;c < image.cols();++c) {
+               const PixelT& pixel = image.pixel(r,c);
+               bool near = false;
+               for(unsigned k = 0;k < n;++k) {
+                  int dr = (int)pixel.namedColor.red - (int)some[k].color.namedColor.red;
+                  int dg = (int)pixel.namedColor.green - (int)some[k].color.namedColor.green;
+                  int db = (int)pixel.namedColor.blue - (int)some[k].color.namedColor.blue;
+                  near = near || std::sqrt((double)(dr*dr + dg*dg + db*db)) < some[k].threshold;
+               }
+               PixelT expected(pixel);
+               expected.namedColor.red = 255u;
+               expected.namedColor.green = near ? 255u : 0u;
+               expected.namedColor.blue = near ? 255u : 0u;
+               reportIfNotEqual("binarized",tgt.pixel(r,c),expected);
+               if(r % 2u == 0 && c % 3u == 0) reportIfNotEqual("strided",strided.pixel(r,c),expected);
+               else reportIfNotEqual("not strided",strided.pixel(r,c),pixel);
+            }
+         }
+      }
+   }
+   simd::setInstructionSet(active);
+}
 
 #if 0
 void testElasticViewGrayscale() {
@@ -475,6 +2106,296 @@ void testSobel() {
 
 }
 
+void testSeparableConvolution() {
+   typedef float PrecisionT;
+   typedef Image<GrayAlphaPixel<uint8_t> > ImageT;
+   typedef Image<MonochromePixel<PrecisionT> > KernelT;
+   typedef KernelT GradientT;
+
+   ImageT image(40u,50u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*37 + c*101 + r*c) % 256);
+      }
+   }
+
+   // Edge functions are given const views of Images
+   const ImageT& cimage = image;
+   ImageT::const_image_view src = cimage.view(image.rows(),image.cols());
+
+   for(unsigned windowSize = 3;windowSize <= 11;windowSize += 2) {
+      KernelT kernelX;
+      KernelT kernelY;
+      edge::sobelX(windowSize,kernelX,kernelY);
+
+      std::vector<SeparableTerm<PrecisionT> > terms;
+      // The distance weighted Sobel kernels have rank (windowSize-1)/2
+      reportIfNotEqual("Sobel rank",separableDecompose(kernelX,terms),(windowSize-1)/2);
+
+      GradientT direct(image.rows()-windowSize+1,image.cols()-windowSize+1);
+      GradientT separable(image.rows()-windowSize+1,image.cols()-windowSize+1);
+      PrecisionT maxDirect,maxSeparable;
+      convolve(src,kernelX,direct,ImageT::pixel_type::GRAY_CHANNEL,maxDirect);
+      convolveSeparable(src,terms,separable,ImageT::pixel_type::GRAY_CHANNEL,maxSeparable);
+
+      PrecisionT tolerance = 1e-4f * maxDirect;
+      reportIfNotLessThan("maxVal difference",std::abs(maxDirect - maxSeparable),tolerance);
+      GradientT::iterator dpos = direct.begin();
+      GradientT::iterator spos = separable.begin();
+      for(;dpos != direct.end();++dpos,++spos) {
+         reportIfNotLessThan("separable difference",std::abs(dpos->tuple.value0 - spos->tuple.value0),tolerance);
+      }
+   }
+
+   // A box kernel is exactly rank 1, so convolveDirect takes the separable path
+   KernelT box(5u,5u);
+   for(KernelT::iterator pos = box.begin();pos != box.end();++pos) pos->tuple.value0 = 1.0f/25.0f;
+   std::vector<SeparableTerm<PrecisionT> > terms;
+   reportIfNotEqual("box rank",separableDecompose(box,terms),1u);
+   reportIfNotEqual("box is separable",convolution::preferSeparable(box,terms),true);
+   {
+      GradientT direct(image.rows()-4,image.cols()-4);
+      GradientT automatic(image.rows()-4,image.cols()-4);
+      PrecisionT maxDirect,maxAutomatic;
+      convolve(src,box,direct,ImageT::pixel_type::GRAY_CHANNEL,maxDirect);
+      convolveDirect(src,box,automatic,ImageT::pixel_type::GRAY_CHANNEL,maxAutomatic);
+      reportIfNotLessThan("box maxVal difference",std::abs(maxDirect - maxAutomatic),1e-4f*maxDirect);
+      GradientT::iterator dpos = direct.begin();
+      GradientT::iterator apos = automatic.begin();
+      for(;dpos != direct.end();++dpos,++apos) {
+         reportIfNotLessThan("box difference",std::abs(dpos->tuple.value0 - apos->tuple.value0),1e-4f*maxDirect);
+      }
+   }
+
+   // As are the 3x3 Sobel kernels, which fusedGradient then convolves separably
+   KernelT kernelX;
+   KernelT kernelY;
+   edge::sobelX(3u,kernelX,kernelY);
+   reportIfNotEqual("Sobel3 rank",separableDecompose(kernelX,terms),1u);
+   reportIfNotEqual("Sobel3 is separable",convolution::preferSeparable(kernelX,terms),true);
+   {
+      GradientT gradientX(image.rows()-2,image.cols()-2);
+      GradientT gradientY(image.rows()-2,image.cols()-2);
+      PrecisionT maxValX,maxValY;
+      convolve(src,kernelX,gradientX,ImageT::pixel_type::GRAY_CHANNEL,maxValX);
+      convolve(src,kernelY,gradientY,ImageT::pixel_type::GRAY_CHANNEL,maxValY);
+      GradientT magnitude;
+      PrecisionT fusedMax = fusedGradient(src,kernelX,kernelY,3u,ImageT::pixel_type::GRAY_CHANNEL,magnitude,(GradientT*)0,
+                                          (const sink::OrientationBand<PrecisionT>*)0,false);
+      PrecisionT maxVal = std::max(maxValX,maxValY);
+      reportIfNotLessThan("Sobel3 maxVal difference",std::abs(fusedMax - maxVal),1e-4f*maxVal);
+      for(unsigned r = 0;r < gradientX.rows();++r) {
+         for(unsigned c = 0;c < gradientX.cols();++c) {
+            PrecisionT x = gradientX.pixel(r,c).tuple.value0;
+            PrecisionT y = gradientY.pixel(r,c).tuple.value0;
+            reportIfNotLessThan("Sobel3 magnitude difference",
+                                std::abs(magnitude.pixel(r+1,c+1).tuple.value0 - std::sqrt(x*x + y*y)),1e-4f*maxVal);
+         }
+      }
+   }
+
+   // A kernel of full rank isn't
+   KernelT full(3u,3u);
+   for(unsigned m = 0;m < full.rows();++m) {
+      for(unsigned n = 0;n < full.cols();++n) full.pixel(m,n).tuple.value0 = (PrecisionT)((m*7 + n*3) % 11);
+   }
+   separableDecompose(full,terms);
+   reportIfNotEqual("full rank is separable",convolution::preferSeparable(full,terms),false);
+}
+
+template<typename PixelT>
+void testVectorizedConvolution(double maxValue) {
+   typedef float PrecisionT;
+   typedef Image<PixelT> ImageT;
+   typedef Image<MonochromePixel<PrecisionT> > KernelT;
+   typedef KernelT GradientT;
+
+   // Odd sized tgt columns to exercise the vector remainder loops
+   ImageT image(30u,53u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).tuple.value0 = (typename PixelT::value_type)(((r*37 + c*101 + r*c) % 256)/255.0*maxValue);
+      }
+   }
+   const ImageT& cimage = image;
+   typename ImageT::const_image_view src = cimage.view(image.rows(),image.cols());
+
+   // A non-separable kernel
+   KernelT kernel(7u,5u);
+   for(unsigned m = 0;m < kernel.rows();++m) {
+      for(unsigned n = 0;n < kernel.cols();++n) {
+         kernel.pixel(m,n).tuple.value0 = (PrecisionT)((int)((m*7 + n*3) % 11) - 5)/7.0f;
+      }
+   }
+
+   GradientT reference(image.rows()-6u,image.cols()-4u);
+   PrecisionT maxReference;
+   convolve(src,kernel,reference,0u,maxReference);
+
+   simd::InstructionSet detected = simd::instructionSet();
+   for(unsigned isa = simd::SCALAR_ISA;isa < simd::NUM_ISAS;++isa) {
+      if(!simd::setInstructionSet((simd::InstructionSet)isa)) continue;
+      GradientT vectorized(image.rows()-6u,image.cols()-4u);
+      PrecisionT maxVectorized;
+      convolveVectorized(src,kernel,vectorized,0u,maxVectorized);
+
+      PrecisionT tolerance = 1e-5f * maxReference;
+      reportIfNotLessThan("maxVal difference",std::abs(maxReference - maxVectorized),tolerance);
+      typename GradientT::iterator rpos = reference.begin();
+      typename GradientT::iterator vpos = vectorized.begin();
+      for(;rpos != reference.end();++rpos,++vpos) {
+         reportIfNotLessThan("vectorized difference",std::abs(rpos->tuple.value0 - vpos->tuple.value0),tolerance);
+      }
+   }
+   simd::setInstructionSet(detected);
+}
+
+void testFusedGradient() {
+   typedef float PrecisionT;
+   typedef Image<GrayAlphaPixel<uint8_t> > ImageT;
+   typedef Image<MonochromePixel<PrecisionT> > KernelT;
+   typedef KernelT GradientT;
+
+   ImageT image(40u,45u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*37 + c*101 + r*c) % 256);
+      }
+   }
+   const ImageT& cimage = image;
+   ImageT::const_image_view src = cimage.view(image.rows(),image.cols());
+
+   for(unsigned windowSize = 3;windowSize <= 11;windowSize += 4) {
+      KernelT kernelX;
+      KernelT kernelY;
+      edge::sobelX(windowSize,kernelX,kernelY);
+
+      // Reference: separate partial gradients, normalized, then combined
+      PrecisionT maxValX,maxValY;
+      GradientT gradientX(gradientPartial<GradientT>(src,kernelX,windowSize,0u,maxValX));
+      GradientT gradientY(gradientPartial<GradientT>(src,kernelY,windowSize,0u,maxValY));
+      PrecisionT maxVal = std::max(maxValX,maxValY);
+      for(GradientT::iterator pos = gradientX.begin();pos != gradientX.end();++pos) pos->tuple.value0 /= maxVal;
+      for(GradientT::iterator pos = gradientY.begin();pos != gradientY.end();++pos) pos->tuple.value0 /= maxVal;
+      GradientT referenceMag(gradientMagnitude(gradientX,gradientY));
+      GradientT referenceDir(gradientDirection(gradientX,gradientY));
+
+      GradientT magnitude;
+      GradientT direction;
+      PrecisionT fusedMax = fusedGradient(src,kernelX,kernelY,windowSize,0u,magnitude,&direction,
+                                          (const sink::OrientationBand<PrecisionT>*)0,true);
+      reportIfNotLessThan("fused maxVal",std::abs(fusedMax - maxVal),1e-4f*maxVal);
+
+      // Only a band of 45 to 135 degrees
+      sink::OrientationBand<PrecisionT> band;
+      band.low = (PrecisionT)(stdesque::numeric::pi()/4.0);
+      band.high = (PrecisionT)(3.0*stdesque::numeric::pi()/4.0);
+      GradientT oriented;
+      fusedGradient(src,kernelX,kernelY,windowSize,0u,oriented,(GradientT*)0,&band,true);
+
+      for(unsigned r = 0;r < image.rows();++r) {
+         for(unsigned c = 0;c < image.cols();++c) {
+            PrecisionT mag = referenceMag.pixel(r,c).tuple.value0;
+            PrecisionT dir = referenceDir.pixel(r,c).tuple.value0;
+            reportIfNotLessThan("fused magnitude",std::abs(magnitude.pixel(r,c).tuple.value0 - mag),1e-4f);
+            // Directions of (near) zero gradients are ill-conditioned
+            if(mag > 1e-3f) {
+               reportIfNotLessThan("fused direction",std::abs(direction.pixel(r,c).tuple.value0 - dir),1e-3f);
+               // Avoid testing the mask right at its boundaries
+               if(std::abs(dir - band.low) > 1e-3f && std::abs(dir - band.high) > 1e-3f) {
+                  PrecisionT expected = band.includes(dir) ? mag : 0.0f;
+                  reportIfNotLessThan("fused oriented",std::abs(oriented.pixel(r,c).tuple.value0 - expected),1e-4f);
+               }
+            }
+         }
+      }
+   }
+}
+
+#if __has_include(<opencv2/opencv.hpp>)
+void testFFTConvolution() {
+   typedef float PrecisionT;
+   typedef Image<GrayAlphaPixel<uint8_t> > ImageT;
+   typedef Image<MonochromePixel<PrecisionT> > KernelT;
+
+   // Blocks are split evenly rather than a full tile and a sliver
+   reportIfNotEqual("blockSize",convolution::blockSize(1000u,31u),500u);
+   reportIfNotEqual("blockSize (fits)",convolution::blockSize(900u,31u),900u);
+   reportIfNotEqual("blockSize (tiled)",convolution::blockSize(100u,9u,32u),20u);
+
+   ImageT image(100u,90u);
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         image.pixel(r,c).namedColor.gray = (uint8_t)((r*37 + c*101 + r*c) % 256);
+      }
+   }
+   const ImageT& cimage = image;
+   ImageT::const_image_view src = cimage.view(image.rows(),image.cols());
+
+   // Non-separable kernels: one small (tiled below) and one large enough for convolveAuto to choose the FFT
+   const unsigned kernelSizes[][2] = { { 9u, 7u }, { 31u, 31u } };
+   for(unsigned k = 0;k < 2u;++k) {
+      KernelT kernel(kernelSizes[k][0],kernelSizes[k][1]);
+      for(unsigned m = 0;m < kernel.rows();++m) {
+         for(unsigned n = 0;n < kernel.cols();++n) {
+            kernel.pixel(m,n).tuple.value0 = (PrecisionT)((int)((m*7 + n*3) % 11) - 5)/(7.0f*kernel.rows());
+         }
+      }
+      const unsigned rows = image.rows() - kernel.rows() + 1u;
+      const unsigned cols = image.cols() - kernel.cols() + 1u;
+      KernelT reference(rows,cols);
+      PrecisionT maxReference;
+      convolve(src,kernel,reference,0u,maxReference);
+
+      KernelT whole(rows,cols),tiled(rows,cols),automatic(rows,cols);
+      PrecisionT maxWhole,maxTiled,maxAutomatic;
+      convolveFFT(src,kernel,whole,0u,maxWhole);
+      convolveFFT(src,kernel,tiled,0u,maxTiled,32u + kernel.rows());
+      convolveAuto(src,kernel,automatic,0u,maxAutomatic);
+
+      const PrecisionT tolerance = 1e-4f * maxReference;
+      reportIfNotLessThan("FFT maxVal",std::abs(maxReference - maxWhole),tolerance);
+      reportIfNotLessThan("tiled FFT maxVal",std::abs(maxReference - maxTiled),tolerance);
+      reportIfNotLessThan("auto maxVal",std::abs(maxReference - maxAutomatic),tolerance);
+      for(unsigned r = 0;r < rows;++r) {
+         for(unsigned c = 0;c < cols;++c) {
+            const PrecisionT expected = reference.pixel(r,c).tuple.value0;
+            reportIfNotLessThan("FFT difference",std::abs(whole.pixel(r,c).tuple.value0 - expected),tolerance);
+            reportIfNotLessThan("tiled FFT difference",std::abs(tiled.pixel(r,c).tuple.value0 - expected),tolerance);
+            reportIfNotLessThan("auto difference",std::abs(automatic.pixel(r,c).tuple.value0 - expected),tolerance);
+         }
+      }
+   }
+
+   // The convolve operation: a 3x3 box smooths the interior, and copies the border
+   {
+      std::ofstream kernelFile("UnitTestKernel.txt");
+      kernelFile << "3 3\n";
+      for(unsigned k = 0;k < 9u;++k) kernelFile << 1.0/9.0 << (k % 3u == 2u ? "\n" : " ");
+   }
+   ImageT tgt(image.rows(),image.cols());
+   ImageT::image_view tgtview = tgt.view(tgt.rows(),tgt.cols());
+   convolveKernel(src,tgtview,"UnitTestKernel.txt");
+   for(unsigned r = 0;r < image.rows();++r) {
+      for(unsigned c = 0;c < image.cols();++c) {
+         unsigned expected = image.pixel(r,c).namedColor.gray;
+         if(r > 0 && c > 0 && r + 1u < image.rows() && c + 1u < image.cols()) {
+            unsigned sum = 0;
+            for(unsigned m = r-1;m <= r+1;++m) for(unsigned n = c-1;n <= c+1;++n) sum += image.pixel(m,n).namedColor.gray;
+            expected = (unsigned)std::floor(sum/9.0 + 0.5);
+         }
+         reportIfNotLessThan("convolveKernel",std::abs((int)tgt.pixel(r,c).namedColor.gray - (int)expected),2);
+      }
+   }
+
+   try {
+      convolveKernel(src,tgtview,"UnitTestMissingKernel.txt");
+      throw ExpectedError("convolveKernel should fail on a missing kernel file");
+   }
+   catch(const std::invalid_argument&) {}
+}
+#endif
+
 int main() {
 
    try {
@@ -488,6 +2409,31 @@ int main() {
       makeImproperGrayscaleSubview();
       moveGrayscaleSubview();
       testViewIteratorGrayscale();
+      testStridedViewGrayscale();
+      testStridedOtsuThreshold();
+      testImagePyramid();
+      testIntegralImage();
+      testUniformSmooth();
+      testGaussianSmooth();
+      testRankFilter();
+      testMorphology<GrayAlphaPixel<uint8_t> >();
+      testMorphology<GrayAlphaPixel<uint16_t> >();
+      testHough();
+      testConnectedComponents();
+      testDistanceTransform();
+      testAdaptiveBinarize();
+      testChannelHistogram();
+      testQuantileHistogram();
+      testHistogramEqualize();
+      testAdaptiveEqualize();
+      testHistogramUnify();
+      testOptimalThreshold();
+      testLookupTable();
+      testLookupChain();
+      testColorConversion();
+      testStreamingHSI();
+      testResample();
+      testBinarizeColor();
 
       createColorImage();
       copyConstructColorImages();
@@ -515,6 +2461,14 @@ int main() {
       testRGBA2HSI(128,100,50);
 
       testSobel();
+      testSeparableConvolution();
+      testVectorizedConvolution<GrayAlphaPixel<uint8_t> >(255.0);
+      testVectorizedConvolution<GrayAlphaPixel<uint16_t> >(65535.0);
+      testVectorizedConvolution<MonochromePixel<float> >(1.0);
+      testFusedGradient();
+#if __has_include(<opencv2/opencv.hpp>)
+      testFFTConvolution();
+#endif
    }
    catch(const std::exception& e) {
       std::cerr << "ERROR: " << e.what() << std::endl;